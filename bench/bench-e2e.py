@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# Замеры command-not-found целиком: запуск программы на синтетическом репозитории
+# с заменами pkglist-query и rpm, без обращения к данным системы
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+# Путь программы: (название, команда, ожидаемая строка вывода)
+SCENARIOS = [
+    ('hit', 'bench-target', "apt-get install bench-target"),
+    ('layout', 'иутср-ефкпуе', "apt-get install bench-target"),
+    ('installed', 'bench-installed', 'already installed'),
+    ('miss', 'no-such-command', 'Perhaps you were looking for'),
+]
+
+
+def run(binary, args, env, stdin=None):
+    """Запускает программу и возвращает время в миллисекундах, код, вывод и пиковый RSS в КБ"""
+    # Ввод идет из файла, а процесс собирается через wait4, чтобы получить его ru_maxrss
+    with tempfile.TemporaryFile() as input_file:
+        if stdin is not None:
+            input_file.write(stdin)
+            input_file.seek(0)
+        start = time.perf_counter()
+        proc = subprocess.Popen([binary] + args, env=env,
+                                stdin=input_file if stdin is not None else subprocess.DEVNULL,
+                                stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        output = proc.stdout.read()
+        proc.stdout.close()
+        _, status, usage = os.wait4(proc.pid, 0)
+        elapsed = (time.perf_counter() - start) * 1000.0
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    return elapsed, proc.returncode, output.decode('utf-8', 'replace'), usage.ru_maxrss
+
+
+def search_copies(binary, args, env):
+    """Количество строк, скопированных при поиске, по журналу CNF_STATS"""
+    log = os.path.join(env['HOME'], 'stats.jsonl')
+    if os.path.exists(log):
+        os.unlink(log)
+    run(binary, args, dict(env, CNF_STATS=log))
+    with open(log) as log_file:
+        record = json.loads(log_file.readlines()[-1])
+    return sum(phase.get('copies', 0) for phase in record['phases'].values())
+
+
+def start_daemon(binary, env, timeout=30.0):
+    """Запускает command-not-found --daemon и ждет появления сокета"""
+    socket_path = os.path.join(env['XDG_RUNTIME_DIR'], 'command-not-found.socket')
+    proc = subprocess.Popen([binary, '--daemon'], env=env, stdin=subprocess.DEVNULL)
+    deadline = time.monotonic() + timeout
+    while not os.path.exists(socket_path):
+        if proc.poll() is not None or time.monotonic() > deadline:
+            proc.kill()
+            proc.wait()
+            return None
+        time.sleep(0.05)
+    return proc
+
+
+def batch_names(rpmdb, count):
+    """Имена для пакетного режима: установленные, устанавливаемый пакет и промахи"""
+    with open(os.path.join(rpmdb, 'names')) as names_file:
+        installed = [line.strip() for line in names_file if line.strip()]
+    names = ['bench-target']
+    names += installed[:count // 2]
+    names += ['no-such-command-%d' % i for i in range(count - len(names))]
+    return names
+
+
+def measure_batch(binary, env, names):
+    """Сравнивает запуск на каждое имя с одним запуском --batch"""
+    per_name = 0.0
+    for name in names:
+        elapsed = run(binary, [name], env)[0]
+        per_name += elapsed
+    elapsed, code, output, _ = run(binary, ['--batch'], env, stdin=''.join(n + '\n' for n in names).encode())
+    ok = code == 0 and '# install: bench-target' in output
+    return per_name, elapsed, ok
+
+
+def percentile(values, share):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * share))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='End-to-end command-not-found benchmark')
+    parser.add_argument('--binary', required=True, help='command-not-found executable')
+    parser.add_argument('--repo', required=True, help='directory made by gen-pkglist.py')
+    parser.add_argument('--rpmdb', help='installed package list directory (default: REPO/rpmdb)')
+    parser.add_argument('--stand-in', required=True, help='directory with pkglist-query and rpm stand-ins')
+    parser.add_argument('--client', help='command-not-found-client executable: also measure the daemon')
+    parser.add_argument('--iterations', type=int, default=10)
+    parser.add_argument('--batch', type=int, default=200, help='command names for the --batch comparison (0 - skip)')
+    parser.add_argument('--json', help='append results to this file as JSON lines')
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp(prefix='cnf-bench-')
+    env = {
+        'PATH': os.pathsep.join([os.path.abspath(args.stand_in), '/usr/bin', '/bin']),
+        'LANG': 'C',
+        'LC_ALL': 'C.UTF-8',
+        'HOME': work,
+        'XDG_CACHE_HOME': os.path.join(work, 'cache'),
+        'XDG_RUNTIME_DIR': os.path.join(work, 'run'),
+        'CNF_PKGLIST_DIR': os.path.abspath(args.repo),
+        'CNF_INDEX_PATH': os.path.join(work, 'index'),
+        'CNF_TYPO_PATH': os.path.join(work, 'typo'),
+        'CNF_RPMDB_DIR': os.path.abspath(args.rpmdb or os.path.join(args.repo, 'rpmdb')),
+        # Повторы одной команды иначе отвечали бы из кеша ответов, а не поиском
+        'CNF_NO_ANSWER_CACHE': '1',
+    }
+
+    os.mkdir(env['XDG_RUNTIME_DIR'], 0o700)
+
+    failed = False
+    results = []
+    daemon = None
+    try:
+        # Сначала без индекса (прямое чтение pkglist), затем с индексом,
+        # затем повторы из кеша ответов и через клиент резидентной программы
+        modes = ['scan', 'index', 'cached'] + (['daemon'] if args.client else [])
+        for mode in modes:
+            binary = args.binary
+            mode_env = env
+            if mode == 'index':
+                elapsed, code, output, _ = run(args.binary, ['--rebuild-index'], env)
+                if code != 0:
+                    sys.stderr.write('--rebuild-index failed:\n' + output)
+                    return 1
+                print('%-10s %-6s %8.2f ms' % ('rebuild', mode, elapsed))
+            elif mode == 'cached':
+                mode_env = {name: value for name, value in env.items() if name != 'CNF_NO_ANSWER_CACHE'}
+            elif mode == 'daemon':
+                daemon = start_daemon(args.binary, env)
+                if daemon is None:
+                    sys.stderr.write('command-not-found --daemon did not start\n')
+                    return 1
+                binary = args.client
+
+            for name, command, expected in SCENARIOS:
+                # Первый запуск заполняет кеши пользователя и не учитывается
+                run(binary, [command], mode_env)
+                times = []
+                peak_rss = 0
+                ok = True
+                for _ in range(args.iterations):
+                    elapsed, code, output, rss = run(binary, [command], mode_env)
+                    times.append(elapsed)
+                    peak_rss = max(peak_rss, rss)
+                    ok = ok and code == 127 and expected in output
+                failed |= not ok
+
+                # Память и копии строк видны только у самой программы, не у клиента
+                p50 = percentile(times, 0.5)
+                p95 = percentile(times, 0.95)
+                result = {'scenario': name, 'mode': mode, 'p50_ms': p50, 'p95_ms': p95, 'ok': ok}
+                memory = ''
+                if mode != 'daemon':
+                    result['peak_rss_kb'] = peak_rss
+                    result['copies'] = search_copies(binary, [command], mode_env)
+                    memory = '  rss %6d KB  copies %3d' % (peak_rss, result['copies'])
+                print('%-10s %-6s p50 %8.2f ms  p95 %8.2f ms%s  %s' %
+                      (name, mode, p50, p95, memory, 'ok' if ok else 'UNEXPECTED OUTPUT'))
+                results.append(result)
+
+            # Много имен: отдельные запуски против одного прохода --batch
+            if args.batch > 0 and mode in ('scan', 'index'):
+                names = batch_names(env['CNF_RPMDB_DIR'], args.batch)
+                per_name, batch, ok = measure_batch(args.binary, env, names)
+                failed |= not ok
+                print('%-10s %-6s %d names: per-name %8.2f ms  batch %8.2f ms  %s' %
+                      ('batch', mode, len(names), per_name, batch, 'ok' if ok else 'UNEXPECTED OUTPUT'))
+                results.append({'scenario': 'batch', 'mode': mode, 'names': len(names),
+                                 'per_name_ms': per_name, 'batch_ms': batch, 'ok': ok})
+    finally:
+        if daemon is not None:
+            daemon.terminate()
+            daemon.wait()
+        shutil.rmtree(work, ignore_errors=True)
+
+    if args.json:
+        with open(args.json, 'a') as out:
+            for result in results:
+                out.write(json.dumps(result) + '\n')
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
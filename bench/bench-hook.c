@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cnf.h"
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Перенаправляет вывод дочернего процесса в /dev/null */
+static void silence_output(void) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+}
+
+/*
+ * Один ответ оболочке, как его видит обработчик: оболочка уже
+ * выполнила fork, дальше либо exec программы, либо поиск внутри процесса
+ * Возвращает код завершения дочернего процесса или -1
+ */
+static int run_once(const char *binary, const char *command, int in_process) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        silence_output();
+        if (in_process) {
+            char exec_name[256];
+            int code = cnf_lookup(command, NULL, stdout, exec_name, sizeof(exec_name));
+            fflush(stdout);
+            _exit(code);
+        }
+        execl(binary, binary, command, (char *)NULL);
+        _exit(126);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/* Замеряет iterations ответов и записывает медиану и 95-й перцентиль */
+static int measure(const char *binary, const char *command, int in_process, int iterations,
+                   double *p50, double *p95) {
+    double *times = malloc(iterations * sizeof(double));
+    if (times == NULL) {
+        return -1;
+    }
+    int code = 0;
+    for (int i = 0; i < iterations; i++) {
+        double start = now_ms();
+        code = run_once(binary, command, in_process);
+        times[i] = now_ms() - start;
+    }
+    qsort(times, iterations, sizeof(double), compare_doubles);
+    *p50 = times[iterations / 2];
+    *p95 = times[(iterations * 95) / 100 < iterations ? (iterations * 95) / 100 : iterations - 1];
+    free(times);
+    return code;
+}
+
+/*
+ * Сравнивает ответ обработчика оболочки через запуск command-not-found
+ * и через библиотеку внутри процесса (встроенная команда bash, модуль zsh)
+ * Пути к данным и PATH берутся из окружения, как у самой программы
+ * Использование: bench-hook <command-not-found> <повторы> <команда>...
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 4 || atoi(argv[2]) <= 0) {
+        fprintf(stderr, "Usage: bench-hook <command-not-found> <iterations> <command>...\n");
+        return 1;
+    }
+    const char *binary = argv[1];
+    int iterations = atoi(argv[2]);
+
+    // Как при загрузке встроенной команды: кеш PATH готов до первого fork
+    cnf_prepare(NULL);
+
+    int failed = 0;
+    for (int i = 3; i < argc; i++) {
+        double exec_p50, exec_p95, builtin_p50, builtin_p95;
+        int exec_code = measure(binary, argv[i], 0, iterations, &exec_p50, &exec_p95);
+        int builtin_code = measure(binary, argv[i], 1, iterations, &builtin_p50, &builtin_p95);
+        int same = exec_code == builtin_code && exec_code >= 0;
+        printf("%-20s exec    p50 %8.3f ms  p95 %8.3f ms\n", argv[i], exec_p50, exec_p95);
+        printf("%-20s builtin p50 %8.3f ms  p95 %8.3f ms  x%.1f  %s\n", argv[i], builtin_p50, builtin_p95,
+               builtin_p50 > 0 ? exec_p50 / builtin_p50 : 0.0, same ? "ok" : "MISMATCH");
+        if (!same) {
+            failed = 1;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "search.h"
+#include "pkglist.h"
+
+/* Сколько имен из индекса проверяется холодным поиском */
+#define COLD_SAMPLES 200
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Суммарный размер файлов pkglist */
+static long long pkglist_size(const char *pkglist_dir) {
+    long long total = 0;
+    DIR *dir = opendir(pkglist_dir);
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        if (is_pkglist_file(entry->d_name) && fstatat(dirfd(dir), entry->d_name, &st, 0) == 0) {
+            total += st.st_size;
+        }
+    }
+    closedir(dir);
+    return total;
+}
+
+/* Выполняет поиск iterations раз и возвращает среднее время; последний результат остается в result */
+static double run_search(const SearchQuery *query, SearchResult *result, int iterations) {
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        search_result_free(result);
+        search_packages(query, result);
+    }
+    return (now_ms() - start) / iterations;
+}
+
+/* Имена файлов, равномерно выбранные из индекса */
+typedef struct {
+    char **names;
+    int count;
+    uint32_t step;     // Берется каждая step-я запись
+    uint32_t position;
+} Sample;
+
+static int sample_entry(const char *dirname, const char *basename, const char *package, void *user_data) {
+    (void)dirname;
+    (void)package;
+    Sample *sample = user_data;
+    if (sample->position++ % sample->step == 0 && sample->count < COLD_SAMPLES) {
+        sample->names[sample->count++] = strdup(basename);
+    }
+    return 0;
+}
+
+/* Количество страниц отображений всех сегментов, находящихся в кеше страниц */
+static long resident_pages(const CommandIndex *index) {
+    long page = sysconf(_SC_PAGESIZE);
+    long resident = 0;
+    for (int s = 0; s < index->segment_count; s++) {
+        const IndexSegment *segment = &index->segments[s];
+        size_t pages = (segment->size + page - 1) / page;
+        unsigned char *vec = malloc(pages);
+        if (vec != NULL && mincore(segment->map, segment->size, vec) == 0) {
+            for (size_t i = 0; i < pages; i++) {
+                resident += vec[i] & 1;
+            }
+        }
+        free(vec);
+    }
+    return resident;
+}
+
+/* Размер всех сегментов индекса */
+static size_t index_size(const CommandIndex *index) {
+    size_t total = 0;
+    for (int s = 0; s < index->segment_count; s++) {
+        total += index->segments[s].size;
+    }
+    return total;
+}
+
+/* Вытесняет сегменты индекса из кеша страниц; только что записанные страницы сначала сбрасываются на диск */
+static void drop_cache(const char *index_path) {
+    DIR *dir = opendir(index_path);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int fd = openat(dirfd(dir), entry->d_name, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    closedir(dir);
+}
+
+/* Удаляет все сегменты из каталога индекса */
+static void remove_segments(const char *index_path) {
+    DIR *dir = opendir(index_path);
+    if (dir == NULL) {
+        return;
+    }
+    size_t suffix_len = strlen(INDEX_SEGMENT_SUFFIX);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > suffix_len && strcmp(entry->d_name + len - suffix_len, INDEX_SEGMENT_SUFFIX) == 0) {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+/*
+ * Удаляет сегмент первого файла pkglist и обновляет индекс
+ * Возвращает время обновления в миллисекундах или -1, если перестроено
+ * не ровно один сегмент
+ */
+static double incremental_update(const char *index_path, const char *pkglist_dir) {
+    DIR *dir = opendir(pkglist_dir);
+    if (dir == NULL) {
+        return -1;
+    }
+    struct dirent *entry;
+    char seg_path[MAX_PATH_LEN] = "";
+    while ((entry = readdir(dir)) != NULL) {
+        if (is_pkglist_file(entry->d_name)) {
+            snprintf(seg_path, sizeof(seg_path), "%s/%s%s", index_path, entry->d_name, INDEX_SEGMENT_SUFFIX);
+            break;
+        }
+    }
+    closedir(dir);
+    if (seg_path[0] == '\0' || unlink(seg_path) != 0) {
+        return -1;
+    }
+
+    int rebuilt;
+    double start = now_ms();
+    if (index_rebuild(index_path, pkglist_dir, &rebuilt) < 0 || rebuilt != 1) {
+        return -1;
+    }
+    return now_ms() - start;
+}
+
+/*
+ * Холодный поиск: индекс вытеснен из кеша, открывается заново и ищется
+ * одно имя; записывает среднее число страниц, прочитанных открытием,
+ * и среднее и наибольшее число страниц, прочитанных поиском
+ * Возвращает -1, если вытеснить индекс не удалось
+ */
+static int cold_pages(const char *index_path, const char *pkglist_dir, const Sample *sample,
+                      double *open_average, double *lookup_average, long *lookup_max) {
+    long open_total = 0;
+    long lookup_total = 0;
+    *lookup_max = 0;
+    for (int i = 0; i < sample->count; i++) {
+        drop_cache(index_path);
+        CommandIndex index;
+        if (index_open(&index, index_path, pkglist_dir) != 0) {
+            return -1;
+        }
+        // Открытие читает заголовок и концы таблиц строк каждого сегмента;
+        // если страниц больше, файлы не вытесняются и замер не имеет смысла
+        long opened = resident_pages(&index);
+        if (opened > 8L * index.segment_count) {
+            index_close(&index);
+            return -1;
+        }
+        Arena arena;
+        arena_init(&arena);
+        PackageInfo info;
+        index_lookup(&index, sample->names[i], &arena, &info);
+        long pages = resident_pages(&index) - opened;
+        arena_free(&arena);
+        index_close(&index);
+
+        open_total += opened;
+        lookup_total += pages;
+        if (pages > *lookup_max) {
+            *lookup_max = pages;
+        }
+    }
+    int count = sample->count > 0 ? sample->count : 1;
+    *open_average = (double)open_total / count;
+    *lookup_average = (double)lookup_total / count;
+    return 0;
+}
+
+/*
+ * Сравнивает поиск по сжатому индексу со сканированием pkglist:
+ * размер индекса, время ответа и число страниц индекса на холодный поиск
+ * и время обновления одного сегмента против построения всего индекса
+ * Использование: bench-index <каталог pkglist> <каталог индекса> [повторы]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: bench-index <pkglist-dir> <index-path> [iterations]\n");
+        return 1;
+    }
+    const char *pkglist_dir = argv[1];
+    const char *index_path = argv[2];
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+    int failed = 0;
+
+    // Полное построение: старые сегменты удаляются
+    remove_segments(index_path);
+    double start = now_ms();
+    long entries = index_rebuild(index_path, pkglist_dir, NULL);
+    if (entries < 0) {
+        fprintf(stderr, "Failed to build index %s\n", index_path);
+        return 1;
+    }
+    double build_ms = now_ms() - start;
+    double update_ms = incremental_update(index_path, pkglist_dir);
+
+    CommandIndex index;
+    if (index_open(&index, index_path, pkglist_dir) != 0) {
+        fprintf(stderr, "Index %s is not up to date\n", index_path);
+        return 1;
+    }
+    uint64_t paths_size = 0;
+    uint64_t data_size = 0;
+    for (int s = 0; s < index.segment_count; s++) {
+        IndexReport report;
+        if (index_segment_verify(&index.segments[s], &report) != 0) {
+            fprintf(stderr, "Index %s does not verify: %s\n", index_path, report.first_error);
+            return 1;
+        }
+        paths_size += report.paths_size;
+        data_size += report.data_size;
+    }
+    size_t size = index_size(&index);
+    long long source_size = pkglist_size(pkglist_dir);
+    printf("pkglist %12lld bytes\n", source_size);
+    printf("index   %12zu bytes  %.1f bytes/entry  %.1f%% of pkglist  paths %.1fx  built in %.0f ms\n",
+           size, (double)size / (entries > 0 ? entries : 1),
+           source_size > 0 ? 100.0 * size / source_size : 0.0,
+           data_size > 0 ? (double)paths_size / data_size : 0.0, build_ms);
+    if (update_ms >= 0) {
+        printf("update  one of %d segments in %.0f ms (%.1f%% of a full build)\n",
+               index.segment_count, update_ms, build_ms > 0 ? 100.0 * update_ms / build_ms : 0.0);
+    } else {
+        printf("update  incremental update failed\n");
+        failed = 1;
+    }
+
+    // Имена для холодного поиска берутся по всей длине индекса
+    Sample sample = { calloc(COLD_SAMPLES, sizeof(char *)), 0, 1, 0 };
+    if (sample.names == NULL) {
+        return 1;
+    }
+    sample.step = index.entry_count / COLD_SAMPLES > 0 ? index.entry_count / COLD_SAMPLES : 1;
+    index_foreach_entry(&index, sample_entry, &sample);
+
+    // Попадание, промах и полное сканирование для сравнения
+    const char *queries[] = { "bench-target", "no-such-command" };
+    static SearchResult scanned, indexed;
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        SearchQuery query = { queries[i], queries[i], 1, pkglist_dir, NULL, 0, NULL, 0, NULL, 0, 0 };
+        double scan_ms = run_search(&query, &scanned, iterations);
+
+        // Как отдельный запуск: индекс открывается для каждого поиска
+        query.index_path = index_path;
+        double open_ms = run_search(&query, &indexed, iterations * 100);
+
+        // Как резидентный режим и библиотека: индекс уже открыт
+        query.index = &index;
+        double warm_ms = run_search(&query, &indexed, iterations * 1000);
+
+        int same = scanned.found == indexed.found &&
+                   (!scanned.found || (strcmp(scanned.exact.package_name, indexed.exact.package_name) == 0 &&
+                                       strcmp(scanned.exact.binary_path, indexed.exact.binary_path) == 0));
+        failed |= !same;
+        printf("%-16s %-4s scan %8.2f ms  index open+lookup %8.4f ms  lookup %8.4f ms  %s\n",
+               queries[i], scanned.found ? "hit" : "miss", scan_ms, open_ms, warm_ms,
+               same ? "results match" : "RESULTS DIFFER");
+    }
+    search_result_free(&scanned);
+    search_result_free(&indexed);
+    index_close(&index);
+
+    double open_average, lookup_average;
+    long lookup_max;
+    if (cold_pages(index_path, pkglist_dir, &sample, &open_average, &lookup_average, &lookup_max) == 0) {
+        printf("cold lookup: open %.1f index pages, lookup %.1f pages on average, %ld at most (%d names)\n",
+               open_average, lookup_average, lookup_max, sample.count);
+    } else {
+        printf("cold lookup: index pages cannot be evicted here, skipped\n");
+    }
+
+    for (int i = 0; i < sample.count; i++) {
+        free(sample.names[i]);
+    }
+    free(sample.names);
+    return failed;
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "layout.h"
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Прежняя таблица: линейный поиск по строкам UTF-8 */
+typedef struct {
+    const char *ru_char;
+    char en_char;
+} LinearMap;
+
+static const LinearMap linear_map[] = {
+    {"а", 'f'}, {"б", ','}, {"в", 'd'}, {"г", 'u'}, {"д", 'l'}, {"е", 't'}, {"ё", '`'},
+    {"ж", ';'}, {"з", 'p'}, {"и", 'b'}, {"й", 'q'}, {"к", 'r'}, {"л", 'k'}, {"м", 'v'},
+    {"н", 'y'}, {"о", 'j'}, {"п", 'g'}, {"р", 'h'}, {"с", 'c'}, {"т", 'n'}, {"у", 'e'},
+    {"ф", 'a'}, {"х", '['}, {"ц", 'w'}, {"ч", 'x'}, {"ш", 'i'}, {"щ", 'o'}, {"ъ", ']'},
+    {"ы", 's'}, {"ь", 'm'}, {"э", '\''}, {"ю", '.'}, {"я", 'z'},
+    {"А", 'F'}, {"Б", '<'}, {"В", 'D'}, {"Г", 'U'}, {"Д", 'L'}, {"Е", 'T'}, {"Ё", '~'},
+    {"Ж", ':'}, {"З", 'P'}, {"И", 'B'}, {"Й", 'Q'}, {"К", 'R'}, {"Л", 'K'}, {"М", 'V'},
+    {"Н", 'Y'}, {"О", 'J'}, {"П", 'G'}, {"Р", 'H'}, {"С", 'C'}, {"Т", 'N'}, {"У", 'E'},
+    {"Ф", 'A'}, {"Х", '{'}, {"Ц", 'W'}, {"Ч", 'X'}, {"Ш", 'I'}, {"Щ", 'O'}, {"Ъ", '}'},
+    {"Ы", 'S'}, {"Ь", 'M'}, {"Э", '\"'}, {"Ю", '>'}, {"Я", 'Z'}
+};
+
+/* Прежнее преобразование: копия символа и strcmp с каждой строкой таблицы */
+static void linear_convert(const char *input, char *output) {
+    size_t out = 0;
+    for (size_t i = 0; input[i] != '\0' && out < MAX_INPUT_LEN - 1; ) {
+        uint32_t code_point;
+        int len = utf8_decode(input + i, &code_point);
+        if (len > 1) {
+            char utf8_char[5] = {0};
+            memcpy(utf8_char, input + i, len);
+            char en_char = utf8_char[0];
+            for (size_t j = 0; j < sizeof(linear_map) / sizeof(linear_map[0]); j++) {
+                if (strcmp(utf8_char, linear_map[j].ru_char) == 0) {
+                    en_char = linear_map[j].en_char;
+                    break;
+                }
+            }
+            output[out++] = en_char;
+        } else {
+            output[out++] = input[i];
+        }
+        i += len;
+    }
+    output[out] = '\0';
+}
+
+/*
+ * Замеряет преобразование раскладки: прежний линейный поиск,
+ * прямую таблицу одной раскладки и сбор всех вариантов
+ * Использование: bench-layout [слов] [повторы]
+ */
+int main(int argc, char *argv[]) {
+    int words = argc > 1 ? atoi(argv[1]) : 10000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    if (words <= 0 || iterations <= 0) {
+        fprintf(stderr, "Usage: bench-layout [words] [iterations]\n");
+        return 1;
+    }
+
+    // Слова из строчных русских букв длиной 3-12 символов
+    static const char *const letters[] = {
+        "а", "б", "в", "г", "д", "е", "ж", "з", "и", "й", "к", "л", "м", "н", "о", "п",
+        "р", "с", "т", "у", "ф", "х", "ц", "ч", "ш", "щ", "ы", "ь", "э", "ю", "я"
+    };
+    char (*corpus)[MAX_INPUT_LEN + 1] = malloc(words * sizeof(*corpus));
+    if (corpus == NULL) {
+        return 1;
+    }
+    srand(1);
+    size_t total_chars = 0;
+    for (int i = 0; i < words; i++) {
+        int len = 3 + rand() % 10;
+        corpus[i][0] = '\0';
+        for (int j = 0; j < len; j++) {
+            strcat(corpus[i], letters[rand() % (sizeof(letters) / sizeof(letters[0]))]);
+        }
+        total_chars += len;
+    }
+
+    char output[MAX_INPUT_LEN + 1];
+    char candidates[LAYOUT_MAX_CANDIDATES][MAX_INPUT_LEN + 1];
+    char expected[MAX_INPUT_LEN + 1];
+    int mismatches = 0;
+    long candidate_total = 0;
+
+    double start = now_ms();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < words; i++) {
+            linear_convert(corpus[i], output);
+        }
+    }
+    double linear_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < words; i++) {
+            layout_convert(keyboard_layouts[0], corpus[i], output, sizeof(output));
+        }
+    }
+    double table_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < words; i++) {
+            candidate_total += layout_candidates(corpus[i], candidates, LAYOUT_MAX_CANDIDATES);
+        }
+    }
+    double candidates_ms = now_ms() - start;
+
+    // Русская раскладка должна давать тот же результат, что и прежняя таблица
+    for (int i = 0; i < words; i++) {
+        linear_convert(corpus[i], expected);
+        if (layout_convert(keyboard_layouts[0], corpus[i], output, sizeof(output)) != 0 ||
+            strcmp(expected, output) != 0) {
+            mismatches++;
+        }
+    }
+
+    double chars = (double)total_chars * iterations;
+    printf("corpus %d words, %zu characters\n", words, total_chars);
+    printf("linear strcmp    %8.2f ns/char\n", linear_ms * 1e6 / chars);
+    printf("direct table     %8.2f ns/char  speedup %.1fx\n", table_ms * 1e6 / chars,
+           table_ms > 0 ? linear_ms / table_ms : 0.0);
+    printf("all candidates   %8.2f ns/char  (%.2f candidates/word)\n", candidates_ms * 1e6 / chars,
+           (double)candidate_total / ((double)words * iterations));
+    printf("ru layout identical to old table: %d/%d\n", words - mismatches, words);
+
+    free(corpus);
+    return mismatches != 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "search.h"
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Выполняет поиск iterations раз и возвращает среднее время; последний результат остается в result */
+static double run_search(const SearchQuery *query, SearchResult *result, int iterations) {
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        search_result_free(result);
+        search_packages(query, result);
+    }
+    return (now_ms() - start) / iterations;
+}
+
+/* Проверяет, что последовательный и параллельный обход дали одинаковый ответ */
+static int same_result(const SearchResult *a, const SearchResult *b) {
+    if (a->found != b->found || a->similar_count != b->similar_count) {
+        return 0;
+    }
+    if (a->found && strcmp(a->exact.package_name, b->exact.package_name) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < a->similar_count; i++) {
+        if (strcmp(a->similar[i].package_name, b->similar[i].package_name) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Сравнивает последовательное и параллельное сканирование pkglist
+ * Использование: bench-scan <каталог pkglist> [потоки] [повторы]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: bench-scan <pkglist-dir> [threads] [iterations]\n");
+        return 1;
+    }
+
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+
+    // Запросы: полный промах (худший случай) и команда в конце последнего репозитория
+    const char *queries[][2] = {
+        { "no-such-command", "no-such-command" },
+        { "bench-target", "bench-target" },
+    };
+
+    static SearchResult serial, parallel;
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        SearchQuery query = { .command_name = queries[i][0], .pattern = queries[i][1],
+                              .similar_on_miss_only = 1, .pkglist_dir = argv[1], .threads = 1 };
+        double serial_ms = run_search(&query, &serial, iterations);
+
+        query.threads = threads;
+        double parallel_ms = run_search(&query, &parallel, iterations);
+
+        int same = same_result(&serial, &parallel);
+        failed |= !same;
+        printf("%-16s %-4s serial %8.2f ms  parallel %8.2f ms  speedup %.2fx  %s\n",
+               queries[i][0], serial.found ? "hit" : "miss", serial_ms, parallel_ms,
+               parallel_ms > 0 ? serial_ms / parallel_ms : 0.0,
+               same ? "results match" : "RESULTS DIFFER");
+    }
+
+    return failed;
+}
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "index.h"
+#include "pkglist.h"
+#include "util.h"
+
+/* Сколько имен каждого состояния проверяется при каждом открытии */
+#define STRESS_SAMPLES 32
+
+/* Сколько файлов pkglist меняет каждая перестройка */
+#define STRESS_FILES 2
+
+/* Исходных файлов: по два состояния каждого изменяемого и один неизменный */
+#define STRESS_SOURCES (2 * STRESS_FILES + 1)
+
+/* Файлы pkglist, содержимое которых меняет перестраивающий процесс */
+static const char *const stress_pkglists[STRESS_FILES] = {
+    "stress0_pkglist.classic", "stress1_pkglist.classic",
+};
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Имена команд из /usr/bin, равномерно выбранные из файла pkglist */
+typedef struct {
+    char **names;
+    int count;
+    int step;
+    int position;
+} Sample;
+
+static int sample_row(const PkglistRow *row, void *user_data) {
+    Sample *sample = user_data;
+    if (row->dirname_len == 9 && memcmp(row->dirname, "/usr/bin/", 9) == 0 &&
+        sample->position++ % sample->step == 0 && sample->count < STRESS_SAMPLES) {
+        sample->names[sample->count++] = strdup(row->basename);
+    }
+    return 0;
+}
+
+/*
+ * Проверяемые имена и ожидаемые ответы в обоих состояниях
+ * Состояние - содержимое всех изменяемых файлов сразу: открытие, в котором
+ * один файл уже новый, а другой еще прежний, не совпадает ни с одним
+ */
+typedef struct {
+    char *names[STRESS_SOURCES * STRESS_SAMPLES];  // Имена из всех исходных файлов
+    int count;
+    char *expected[2][STRESS_SOURCES * STRESS_SAMPLES];  // "пакет путь" или "" для каждого состояния
+    const char *index_path;
+    const char *pkglist_dir;
+    double deadline;
+} StressPlan;
+
+/* Результат одного читающего потока */
+typedef struct {
+    const StressPlan *plan;
+    int pinned;               // Один раз открытый индекс на все время замера
+    long opens;
+    long lookups;
+    long generations[2];      // Открытия, давшие ответы первого и второго состояния
+    long inconsistent;        // Ответы, не совпавшие ни с одним состоянием целиком
+    long failed_opens;        // Индекс не открылся (запрос ушел бы в сканирование)
+    double slowest_ms;
+} Reader;
+
+/*
+ * Ищет все имена плана и сверяет ответы с состояниями
+ * Возвращает номер состояния, которому соответствуют все ответы, или -1
+ */
+static int check_answers(const StressPlan *plan, const CommandIndex *index, long *lookups) {
+    int matches[2] = { 1, 1 };
+    Arena arena;
+    arena_init(&arena);
+    for (int i = 0; i < plan->count; i++) {
+        PackageInfo info;
+        char answer[2 * MAX_PATH_LEN] = "";
+        if (index_lookup(index, plan->names[i], &arena, &info)) {
+            snprintf(answer, sizeof(answer), "%s %s", info.package_name, info.binary_path);
+        }
+        for (int state = 0; state < 2; state++) {
+            matches[state] &= strcmp(answer, plan->expected[state][i]) == 0;
+        }
+        (*lookups)++;
+    }
+    arena_free(&arena);
+    return matches[0] ? 0 : matches[1] ? 1 : -1;
+}
+
+static void *reader_thread(void *user_data) {
+    Reader *reader = user_data;
+    const StressPlan *plan = reader->plan;
+    CommandIndex pinned;
+    int pinned_state = -1;
+    if (reader->pinned) {
+        if (index_open(&pinned, plan->index_path, plan->pkglist_dir) != 0) {
+            reader->failed_opens++;
+            return NULL;
+        }
+        reader->opens++;
+    }
+
+    while (now_ms() < plan->deadline) {
+        double start = now_ms();
+        CommandIndex index;
+        const CommandIndex *current = &pinned;
+        if (!reader->pinned) {
+            if (index_open(&index, plan->index_path, plan->pkglist_dir) != 0) {
+                reader->failed_opens++;
+                continue;
+            }
+            reader->opens++;
+            current = &index;
+        }
+
+        int state = check_answers(plan, current, &reader->lookups);
+        if (state < 0 || (reader->pinned && pinned_state >= 0 && state != pinned_state)) {
+            reader->inconsistent++;
+        } else {
+            reader->generations[state]++;
+            pinned_state = state;
+        }
+        if (!reader->pinned) {
+            index_close(&index);
+        }
+        double elapsed = now_ms() - start;
+        if (elapsed > reader->slowest_ms) {
+            reader->slowest_ms = elapsed;
+        }
+    }
+
+    if (reader->pinned) {
+        index_close(&pinned);
+    }
+    return NULL;
+}
+
+/*
+ * Заменяет файл pkglist name содержимым data так же, как apt: запись рядом
+ * и переименование
+ */
+static int replace_pkglist(const char *pkglist_dir, const char *name, const char *data, size_t size) {
+    char tmp_path[MAX_PATH_LEN];
+    char path[MAX_PATH_LEN];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/.stress-next", pkglist_dir);
+    snprintf(path, sizeof(path), "%s/%s", pkglist_dir, name);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = write_all(fd, data, size);
+    if (close(fd) != 0 || rc != 0) {
+        return -1;
+    }
+    return rename(tmp_path, path);
+}
+
+/* Заменяет все изменяемые файлы pkglist их содержимым в состоянии state */
+static int replace_state(const char *pkglist_dir, int state, char *data[][2], size_t size[][2]) {
+    for (int i = 0; i < STRESS_FILES; i++) {
+        if (replace_pkglist(pkglist_dir, stress_pkglists[i], data[i][state], size[i][state]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Перестраивающий процесс: как apt-get update с хуком, отмечает
+ * обновление, заменяет все изменяемые файлы pkglist другим состоянием
+ * и перестраивает индекс
+ * Возвращает количество перестроек или -1 при ошибке
+ */
+static long run_writer(const StressPlan *plan, char *data[][2], size_t size[][2]) {
+    long cycles = 0;
+    for (int state = 1; now_ms() < plan->deadline; state ^= 1) {
+        if (index_pin(plan->index_path) != 0 || replace_state(plan->pkglist_dir, state, data, size) != 0) {
+            return -1;
+        }
+        int rebuilt;
+        if (index_rebuild(plan->index_path, plan->pkglist_dir, &rebuilt) < 0 || rebuilt != STRESS_FILES) {
+            return -1;
+        }
+        cycles++;
+    }
+    return cycles;
+}
+
+/*
+ * Находит в каталоге pkglist STRESS_SOURCES файлов: по два состояния
+ * каждого изменяемого файла и неизменный файл, который остается в
+ * рабочем каталоге
+ * Возвращает 0 при успехе, -1 если файлов меньше
+ */
+static int pick_sources(const char *source_dir, char paths[STRESS_SOURCES][MAX_PATH_LEN]) {
+    DIR *dir = opendir(source_dir);
+    if (dir == NULL) {
+        return -1;
+    }
+    int count = 0;
+    struct dirent *entry;
+    while (count < STRESS_SOURCES && (entry = readdir(dir)) != NULL) {
+        if (is_pkglist_file(entry->d_name)) {
+            snprintf(paths[count++], MAX_PATH_LEN, "%s/%s", source_dir, entry->d_name);
+        }
+    }
+    closedir(dir);
+    return count == STRESS_SOURCES ? 0 : -1;
+}
+
+/* Записывает ответы индекса для всех имен плана в состоянии state */
+static int record_expected(StressPlan *plan, int state) {
+    CommandIndex index;
+    if (index_open(&index, plan->index_path, plan->pkglist_dir) != 0) {
+        return -1;
+    }
+    Arena arena;
+    arena_init(&arena);
+    for (int i = 0; i < plan->count; i++) {
+        PackageInfo info;
+        char answer[2 * MAX_PATH_LEN] = "";
+        if (index_lookup(&index, plan->names[i], &arena, &info)) {
+            snprintf(answer, sizeof(answer), "%s %s", info.package_name, info.binary_path);
+        }
+        plan->expected[state][i] = strdup(answer);
+    }
+    arena_free(&arena);
+    index_close(&index);
+    return 0;
+}
+
+/*
+ * Одновременные поиски против непрерывных перестроек индекса, каждая из
+ * которых меняет STRESS_FILES файлов: каждое открытие должно удаваться и
+ * давать ответы одного из двух состояний целиком, а один раз открытый
+ * индекс - не меняться до закрытия
+ * Использование: bench-stress <каталог pkglist> <рабочий каталог> [секунды] [потоки]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: bench-stress <pkglist-dir> <work-dir> [seconds] [readers]\n");
+        return 1;
+    }
+    const char *work_dir = argv[2];
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    int reader_count = argc > 4 ? atoi(argv[4]) : 8;
+    if (reader_count < 1) {
+        reader_count = 1;
+    }
+
+    char sources[STRESS_SOURCES][MAX_PATH_LEN];
+    if (pick_sources(argv[1], sources) != 0) {
+        fprintf(stderr, "%s needs at least %d pkglist files\n", argv[1], STRESS_SOURCES);
+        return 1;
+    }
+    // Состояния изменяемого файла i - исходные файлы 2i и 2i + 1
+    char *data[STRESS_FILES][2];
+    size_t size[STRESS_FILES][2];
+    for (int i = 0; i < STRESS_FILES; i++) {
+        for (int state = 0; state < 2; state++) {
+            data[i][state] = read_file(sources[2 * i + state], &size[i][state]);
+            if (data[i][state] == NULL) {
+                fprintf(stderr, "Failed to read %s\n", sources[2 * i + state]);
+                return 1;
+            }
+        }
+    }
+
+    // Рабочий каталог: изменяемые файлы и ссылка на неизменный
+    char pkglist_dir[MAX_PATH_LEN];
+    char index_path[MAX_PATH_LEN];
+    char stable_path[MAX_PATH_LEN + 32];
+    snprintf(pkglist_dir, sizeof(pkglist_dir), "%s/pkglist", work_dir);
+    snprintf(index_path, sizeof(index_path), "%s/index", work_dir);
+    snprintf(stable_path, sizeof(stable_path), "%s/stable_pkglist.classic", pkglist_dir);
+    mkdir(work_dir, 0755);
+    mkdir(pkglist_dir, 0755);
+    unlink(stable_path);
+    if (symlink(sources[STRESS_SOURCES - 1], stable_path) != 0) {
+        fprintf(stderr, "Failed to link %s\n", sources[STRESS_SOURCES - 1]);
+        return 1;
+    }
+
+    StressPlan plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.index_path = index_path;
+    plan.pkglist_dir = pkglist_dir;
+    for (int i = 0; i < STRESS_SOURCES; i++) {
+        Sample sample = { plan.names + plan.count, 0, 50, 0 };
+        pkglist_scan_file(sources[i], sample_row, &sample);
+        plan.count += sample.count;
+    }
+
+    // Ожидаемые ответы: индекс каждого состояния, построенный без помех
+    for (int state = 0; state < 2; state++) {
+        if (replace_state(pkglist_dir, state, data, size) != 0 ||
+            index_rebuild(index_path, pkglist_dir, NULL) < 0 ||
+            record_expected(&plan, state) != 0) {
+            fprintf(stderr, "Failed to build index %s\n", index_path);
+            return 1;
+        }
+    }
+    plan.deadline = now_ms() + seconds * 1000;
+
+    // Перестройки идут в отдельном процессе, как у хука apt
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        return 1;
+    }
+    fflush(stdout);
+    pid_t writer = fork();
+    if (writer < 0) {
+        return 1;
+    }
+    if (writer == 0) {
+        close(pipe_fds[0]);
+        long cycles = run_writer(&plan, data, size);
+        _exit(write(pipe_fds[1], &cycles, sizeof(cycles)) == sizeof(cycles) ? 0 : 1);
+    }
+    close(pipe_fds[1]);
+
+    // Последний поток держит один раз открытый индекс все время замера
+    Reader *readers = calloc(reader_count + 1, sizeof(Reader));
+    pthread_t *threads = calloc(reader_count + 1, sizeof(pthread_t));
+    if (readers == NULL || threads == NULL) {
+        return 1;
+    }
+    for (int i = 0; i <= reader_count; i++) {
+        readers[i].plan = &plan;
+        readers[i].pinned = i == reader_count;
+        pthread_create(&threads[i], NULL, reader_thread, &readers[i]);
+    }
+
+    Reader total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i <= reader_count; i++) {
+        pthread_join(threads[i], NULL);
+        total.opens += readers[i].opens;
+        total.lookups += readers[i].lookups;
+        total.generations[0] += readers[i].generations[0];
+        total.generations[1] += readers[i].generations[1];
+        total.inconsistent += readers[i].inconsistent;
+        total.failed_opens += readers[i].failed_opens;
+        if (readers[i].slowest_ms > total.slowest_ms) {
+            total.slowest_ms = readers[i].slowest_ms;
+        }
+    }
+
+    long cycles = -1;
+    int status;
+    if (read(pipe_fds[0], &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        cycles = -1;
+    }
+    close(pipe_fds[0]);
+    waitpid(writer, &status, 0);
+
+    int failed = cycles <= 0 || total.inconsistent > 0 || total.failed_opens > 0;
+    printf("rebuilds %ld of %d files in %.0f s, readers %d + 1 pinned\n", cycles, STRESS_FILES, seconds,
+           reader_count);
+    printf("opens %ld, lookups %ld, state A %ld, state B %ld, slowest open+%d lookups %.2f ms\n",
+           total.opens, total.lookups, total.generations[0], total.generations[1], plan.count, total.slowest_ms);
+    printf("inconsistent %ld, failed opens %ld  %s\n", total.inconsistent, total.failed_opens,
+           failed ? "FAILED" : "ok");
+
+    for (int i = 0; i < plan.count; i++) {
+        free(plan.names[i]);
+        free(plan.expected[0][i]);
+        free(plan.expected[1][i]);
+    }
+    free(readers);
+    free(threads);
+    for (int i = 0; i < STRESS_FILES; i++) {
+        free(data[i][0]);
+        free(data[i][1]);
+    }
+    return failed;
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "typo.h"
+
+/* Слоги для синтетических имен команд */
+static const char *syllables[] = {
+    "ka", "lo", "mi", "ne", "ru", "ta", "zo", "gi", "py", "x", "ctl", "fs", "ng", "io",
+    "do", "ck", "er", "th", "on", "sh", "git", "ls", "ps", "top", "d"
+};
+
+/* Монотонное время в миллисекундах */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Функция сравнения для qsort по времени */
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Вносит в имя одну случайную правку: замену, вставку, удаление или перестановку */
+static void make_typo(char *dest, const char *src) {
+    size_t len = strlen(src);
+    size_t pos = (size_t)rand() % len;
+    strcpy(dest, src);
+
+    switch (rand() % 4) {
+    case 0:
+        dest[pos] = 'a' + rand() % 26;
+        break;
+    case 1:
+        memmove(dest + pos + 1, dest + pos, len - pos + 1);
+        dest[pos] = 'a' + rand() % 26;
+        break;
+    case 2:
+        if (len > 3) {
+            memmove(dest + pos, dest + pos + 1, len - pos);
+        }
+        break;
+    default:
+        if (pos + 1 < len) {
+            char c = dest[pos];
+            dest[pos] = dest[pos + 1];
+            dest[pos + 1] = c;
+        }
+        break;
+    }
+}
+
+/*
+ * Сравнивает поиск опечаток по BK-дереву с линейным перебором
+ * Использование: bench-typo <файл дерева> [имен] [запросов]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: bench-typo <tree-file> [names] [queries]\n");
+        return 1;
+    }
+
+    size_t count = argc > 2 ? (size_t)atol(argv[2]) : 500000;
+    int queries = argc > 3 ? atoi(argv[3]) : 200;
+    size_t syllable_count = sizeof(syllables) / sizeof(syllables[0]);
+
+    // Синтетический корпус имен команд
+    srand(42);
+    char *storage = malloc(count * 32);
+    const char **names = malloc(count * sizeof(*names));
+    if (storage == NULL || names == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        char *name = storage + i * 32;
+        name[0] = '\0';
+        int parts = 2 + rand() % 4;
+        for (int p = 0; p < parts; p++) {
+            strcat(name, syllables[rand() % syllable_count]);
+        }
+        snprintf(name + strlen(name), 32 - strlen(name), "%zu", i % 97);
+        names[i] = name;
+    }
+
+    double start = now_ms();
+    long nodes = typo_tree_write(argv[1], names, NULL, count, -1);
+    double build_ms = now_ms() - start;
+    if (nodes < 0) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return 1;
+    }
+
+    TypoTree tree;
+    if (typo_tree_open(&tree, argv[1], -1) != 0) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    double *tree_times = malloc(queries * sizeof(double));
+    double *linear_times = malloc(queries * sizeof(double));
+    int matched = 0;
+
+    for (int q = 0; q < queries; q++) {
+        char typo[64];
+        make_typo(typo, names[(size_t)rand() % count]);
+
+        TypoPattern pattern;
+        typo_pattern_init(&pattern, typo);
+        int max_distance = typo_max_distance(pattern.length);
+
+        TypoResults tree_results, linear_results;
+        typo_results_init(&tree_results, 3, max_distance);
+        start = now_ms();
+        typo_tree_search(&tree, &pattern, &tree_results, 1000.0);
+        tree_times[q] = now_ms() - start;
+
+        typo_results_init(&linear_results, 3, max_distance);
+        start = now_ms();
+        for (size_t i = 0; i < count; i++) {
+            typo_check_name(&pattern, &linear_results, names[i], NULL);
+        }
+        linear_times[q] = now_ms() - start;
+
+        // Совпадение лучших вариантов с точным перебором
+        int same = tree_results.count == linear_results.count;
+        for (int i = 0; same && i < tree_results.count; i++) {
+            same = strcmp(tree_results.items[i].name, linear_results.items[i].name) == 0;
+        }
+        matched += same;
+    }
+
+    qsort(tree_times, queries, sizeof(double), compare_double);
+    qsort(linear_times, queries, sizeof(double), compare_double);
+
+    printf("corpus %zu names, %ld tree nodes, build %.0f ms\n", count, nodes, build_ms);
+    printf("bk-tree  p50 %7.3f ms  p99 %7.3f ms\n", tree_times[queries / 2], tree_times[queries * 99 / 100]);
+    printf("linear   p50 %7.3f ms  p99 %7.3f ms\n", linear_times[queries / 2], linear_times[queries * 99 / 100]);
+    printf("top-3 identical to linear scan: %d/%d\n", matched, queries);
+
+    typo_tree_close(&tree);
+    free(tree_times);
+    free(linear_times);
+    free(names);
+    free(storage);
+    return 0;
+}
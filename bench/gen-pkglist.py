@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# Генератор синтетических репозиториев в формате pkglist (заголовки RPM)
+import argparse
+import os
+import random
+import struct
+
+HEADER_MAGIC = b'\x8e\xad\xe8\x01\x00\x00\x00\x00'
+
+RPMTAG_NAME = 1000
+RPMTAG_SUMMARY = 1004
+RPMTAG_DIRINDEXES = 1116
+RPMTAG_BASENAMES = 1117
+RPMTAG_DIRNAMES = 1118
+
+RPM_INT32_TYPE = 4
+RPM_STRING_TYPE = 6
+RPM_STRING_ARRAY_TYPE = 8
+RPM_I18NSTRING_TYPE = 9
+
+DIRS = ['/usr/bin/', '/usr/sbin/', '/usr/lib64/', '/usr/share/doc/', '/usr/share/man/man1/']
+SYLLABLES = ['ka', 'lo', 'mi', 'ne', 'ru', 'ta', 'zo', 'gi', 'py', 'x', 'ctl', 'fs', 'ng', 'io']
+
+
+def header(name, summary, files):
+    """Собирает заголовок RPM со сжатым списком файлов"""
+    tags = []
+    data = bytearray()
+
+    def add(tag, tag_type, payload, count, align=1):
+        while len(data) % align:
+            data.append(0)
+        tags.append((tag, tag_type, len(data), count))
+        data.extend(payload)
+
+    dirs = []
+    indexes = []
+    for path in files:
+        dirname, basename = path.rsplit('/', 1)
+        dirname += '/'
+        if dirname not in dirs:
+            dirs.append(dirname)
+        indexes.append((dirs.index(dirname), basename))
+
+    add(RPMTAG_NAME, RPM_STRING_TYPE, name.encode() + b'\0', 1)
+    add(RPMTAG_SUMMARY, RPM_I18NSTRING_TYPE, summary.encode() + b'\0', 1)
+    add(RPMTAG_DIRINDEXES, RPM_INT32_TYPE,
+        b''.join(struct.pack('>I', i) for i, _ in indexes), len(indexes), 4)
+    add(RPMTAG_BASENAMES, RPM_STRING_ARRAY_TYPE,
+        b''.join(b.encode() + b'\0' for _, b in indexes), len(indexes))
+    add(RPMTAG_DIRNAMES, RPM_STRING_ARRAY_TYPE,
+        b''.join(d.encode() + b'\0' for d in dirs), len(dirs))
+
+    out = bytearray(HEADER_MAGIC)
+    out += struct.pack('>II', len(tags), len(data))
+    for tag in tags:
+        out += struct.pack('>IIII', *tag)
+    return bytes(out + data)
+
+
+def package_name(rng, repo, index):
+    word = ''.join(rng.choice(SYLLABLES) for _ in range(rng.randint(2, 4)))
+    return '%s-r%d-%d' % (word, repo, index)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate synthetic pkglist repositories')
+    parser.add_argument('--output', required=True, help='directory for pkglist.* files')
+    parser.add_argument('--repos', type=int, default=4, help='number of pkglist files')
+    parser.add_argument('--packages', type=int, default=5000, help='packages per pkglist file')
+    parser.add_argument('--files', type=int, default=20, help='files per package')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--rpmdb', help='directory for the installed package list read by bench/stand-in/rpm')
+    parser.add_argument('--installed', type=float, default=0.1, help='share of installed packages')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    os.makedirs(args.output, exist_ok=True)
+    installed = []
+
+    for repo in range(args.repos):
+        path = os.path.join(args.output, 'synthetic_repo%d_pkglist.classic' % repo)
+        with open(path, 'wb') as out:
+            for index in range(args.packages):
+                name = package_name(rng, repo, index)
+                files = ['/usr/bin/' + name]
+                for n in range(args.files - 1):
+                    files.append('%s%s-%d' % (rng.choice(DIRS), name, n))
+                out.write(header(name, 'Synthetic package %s' % name, files))
+                if rng.random() < args.installed:
+                    installed.append(name)
+            # Известные команды в конце последнего репозитория для замеров попадания:
+            # bench-target не установлен, bench-installed установлен, но команды нет в PATH
+            if repo == args.repos - 1:
+                out.write(header('bench-target', 'Benchmark target package',
+                                 ['/usr/bin/bench-target', '/usr/share/doc/bench-target/README']))
+                out.write(header('bench-installed', 'Benchmark installed package',
+                                 ['/usr/bin/bench-installed']))
+                installed.append('bench-installed')
+
+    if args.rpmdb:
+        os.makedirs(args.rpmdb, exist_ok=True)
+        with open(os.path.join(args.rpmdb, 'names'), 'w') as out:
+            out.write(''.join(name + '\n' for name in installed))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "answers.h"
+#include "util.h"
+
+/* Сигнатура файла кеша ответов */
+#define ANSWER_CACHE_MAGIC "CNF-ANSWERS 1"
+
+/* Запись кеша; ключ и текст указывают в прочитанный буфер */
+typedef struct {
+    uint64_t state;
+    int code;
+    const char *key;
+    size_t key_len;
+    const char *text;
+    size_t text_len;
+} AnswerEntry;
+
+/* Добавляет байты к хешу FNV-1a 64 */
+static uint64_t hash_bytes64(const void *data, size_t len, uint64_t hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Добавляет к состоянию строку; NULL отличается от пустой строки */
+uint64_t answer_state_string(uint64_t state, const char *str) {
+    unsigned char present = str != NULL;
+    state = hash_bytes64(&present, 1, state);
+    return str != NULL ? hash_bytes64(str, strlen(str) + 1, state) : state;
+}
+
+/* Добавляет к состоянию число (время изменения, размер) */
+uint64_t answer_state_number(uint64_t state, int64_t value) {
+    return hash_bytes64(&value, sizeof(value), state);
+}
+
+/* Проверяет, что запись - ответ на команду key */
+static int entry_matches(const AnswerEntry *entry, const char *key) {
+    return entry->key_len == strlen(key) && memcmp(entry->key, key, entry->key_len) == 0;
+}
+
+/*
+ * Разбирает файл кеша: строка-сигнатура, затем записи
+ * "<состояние> <код> <длина команды> <длина ответа>\n<команда><ответ>",
+ * самые свежие первыми
+ * Возвращает количество записей; поврежденный хвост отбрасывается
+ */
+static int parse_entries(const char *buffer, size_t size, AnswerEntry *entries) {
+    size_t magic_len = strlen(ANSWER_CACHE_MAGIC);
+    if (size <= magic_len || memcmp(buffer, ANSWER_CACHE_MAGIC, magic_len) != 0 || buffer[magic_len] != '\n') {
+        return 0;
+    }
+
+    const char *pos = buffer + magic_len + 1;
+    const char *end = buffer + size;
+    int count = 0;
+    while (count < ANSWER_CACHE_ENTRIES && pos < end) {
+        const char *line_end = memchr(pos, '\n', end - pos);
+        unsigned long long state;
+        int code;
+        size_t key_len, text_len;
+        if (line_end == NULL || sscanf(pos, "%16llx %d %zu %zu", &state, &code, &key_len, &text_len) != 4) {
+            break;
+        }
+        const char *data = line_end + 1;
+        if (key_len > (size_t)(end - data) || text_len > (size_t)(end - data) - key_len) {
+            break;
+        }
+
+        AnswerEntry *entry = &entries[count++];
+        entry->state = state;
+        entry->code = code;
+        entry->key = data;
+        entry->key_len = key_len;
+        entry->text = data + key_len;
+        entry->text_len = text_len;
+        pos = data + key_len + text_len;
+    }
+    return count;
+}
+
+/*
+ * Записывает first первым, затем записи entries, кроме ответов на ту же
+ * команду, пока их не больше ANSWER_CACHE_ENTRIES
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+static int write_entries(const char *path, const AnswerEntry *first, const AnswerEntry *entries, int count) {
+    size_t size = strlen(ANSWER_CACHE_MAGIC) + 1;
+    size += 64 + first->key_len + first->text_len;
+    for (int i = 0; i < count; i++) {
+        size += 64 + entries[i].key_len + entries[i].text_len;
+    }
+
+    char *data = malloc(size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    size_t len = snprintf(data, size, "%s\n", ANSWER_CACHE_MAGIC);
+    int written = 0;
+    for (int i = -1; i < count && written < ANSWER_CACHE_ENTRIES; i++) {
+        const AnswerEntry *entry = i < 0 ? first : &entries[i];
+        if (i >= 0 && entry->key_len == first->key_len && memcmp(entry->key, first->key, first->key_len) == 0) {
+            continue;
+        }
+        len += snprintf(data + len, size - len, "%016" PRIx64 " %d %zu %zu\n",
+                        entry->state, entry->code, entry->key_len, entry->text_len);
+        memcpy(data + len, entry->key, entry->key_len);
+        memcpy(data + len + entry->key_len, entry->text, entry->text_len);
+        len += entry->key_len + entry->text_len;
+        written++;
+    }
+
+    int rc = write_file_atomic(path, data, len);
+    free(data);
+    return rc;
+}
+
+/*
+ * Ищет ответ на команду key, сохраненный при том же состоянии
+ * Ответы из первой половины списка не переставляются, чтобы частые
+ * повторы не переписывали файл при каждом попадании
+ */
+char *answer_cache_get(const char *path, uint64_t state, const char *key, int *code, size_t *len) {
+    size_t size;
+    char *buffer = read_file(path, &size);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    AnswerEntry entries[ANSWER_CACHE_ENTRIES];
+    int count = parse_entries(buffer, size, entries);
+    char *text = NULL;
+    for (int i = 0; i < count; i++) {
+        if (entries[i].state != state || !entry_matches(&entries[i], key)) {
+            continue;
+        }
+        text = malloc(entries[i].text_len + 1);
+        if (text != NULL) {
+            memcpy(text, entries[i].text, entries[i].text_len);
+            text[entries[i].text_len] = '\0';
+            *len = entries[i].text_len;
+            *code = entries[i].code;
+            if (i >= ANSWER_CACHE_ENTRIES / 2) {
+                AnswerEntry hit = entries[i];
+                write_entries(path, &hit, entries, count);
+            }
+        }
+        break;
+    }
+
+    free(buffer);
+    return text;
+}
+
+/*
+ * Сохраняет ответ первым в списке, вытесняя прежний ответ на ту же
+ * команду и самые давние сверх ANSWER_CACHE_ENTRIES
+ * Одновременная запись из нескольких оболочек может потерять чужой ответ,
+ * но файл всегда остается целым
+ */
+int answer_cache_put(const char *path, uint64_t state, const char *key, int code,
+                     const char *text, size_t len) {
+    if (len > ANSWER_MAX_TEXT) {
+        return -1;
+    }
+
+    size_t size = 0;
+    char *buffer = read_file(path, &size);
+    AnswerEntry entries[ANSWER_CACHE_ENTRIES];
+    int count = buffer != NULL ? parse_entries(buffer, size, entries) : 0;
+
+    AnswerEntry fresh = { state, code, key, strlen(key), text, len };
+    int rc = write_entries(path, &fresh, entries, count);
+    free(buffer);
+    return rc;
+}
@@ -0,0 +1,41 @@
+#ifndef CNF_ANSWERS_H
+#define CNF_ANSWERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Сколько последних ответов хранится в кеше */
+#define ANSWER_CACHE_ENTRIES 64
+
+/* Ответы длиннее этого не сохраняются */
+#define ANSWER_MAX_TEXT 4096
+
+/* Начальное значение состояния (FNV-1a 64) */
+#define ANSWER_STATE_INIT 14695981039346656037ull
+
+/*
+ * Добавляет к состоянию строку; NULL отличается от пустой строки
+ * Состояние описывает все, от чего зависит ответ, кроме самой команды
+ */
+uint64_t answer_state_string(uint64_t state, const char *str);
+
+/* Добавляет к состоянию число (время изменения, размер) */
+uint64_t answer_state_number(uint64_t state, int64_t value);
+
+/*
+ * Ищет ответ на команду key, сохраненный при том же состоянии
+ * Возвращает текст ответа (освобождается free), его длину в *len и код
+ * завершения в *code или NULL, если ответа нет
+ * Ответ из второй, более давней половины списка переносится в начало
+ */
+char *answer_cache_get(const char *path, uint64_t state, const char *key, int *code, size_t *len);
+
+/*
+ * Сохраняет ответ первым в списке, вытесняя прежний ответ на ту же
+ * команду и самые давние сверх ANSWER_CACHE_ENTRIES
+ * Возвращает 0 при успехе, -1 при ошибке или слишком длинном ответе
+ */
+int answer_cache_put(const char *path, uint64_t state, const char *key, int code,
+                     const char *text, size_t len);
+
+#endif /* CNF_ANSWERS_H */
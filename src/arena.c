@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stddef.h>
+
+#include "arena.h"
+
+/* Блок памяти арены; данные идут сразу за заголовком */
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;              // Размер области данных
+    size_t used;              // Занятая часть
+    alignas(max_align_t) unsigned char data[];
+};
+
+/* Отложенное освобождение ресурса */
+struct ArenaCleanup {
+    ArenaCleanup *next;
+    void (*release)(void *);
+    void *resource;
+};
+
+/* Инициализирует пустую арену */
+void arena_init(Arena *arena) {
+    arena->blocks = NULL;
+    arena->cleanups = NULL;
+}
+
+/*
+ * Выделяет size байт, выровненных для любого типа
+ * Большие запросы получают отдельный блок, чтобы не терять остаток текущего
+ * Возвращает NULL при нехватке памяти
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t aligned = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    if (aligned < size) {
+        return NULL;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < aligned) {
+        size_t block_size = aligned > ARENA_BLOCK_SIZE / 4 ? aligned : ARENA_BLOCK_SIZE;
+        ArenaBlock *fresh = malloc(sizeof(ArenaBlock) + block_size);
+        if (fresh == NULL) {
+            return NULL;
+        }
+        fresh->size = block_size;
+        fresh->used = 0;
+        if (block != NULL && block_size != ARENA_BLOCK_SIZE) {
+            // Отдельный блок встает за текущим: в текущем остается место
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            arena->blocks = fresh;
+        }
+        block = fresh;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += aligned;
+    return ptr;
+}
+
+/* Копирует len байт строки и завершает копию нулем */
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+/* Копирует строку, завершенную нулем */
+char *arena_strdup(Arena *arena, const char *str) {
+    return arena_strndup(arena, str, strlen(str));
+}
+
+/*
+ * Регистрирует освобождение ресурса вместе с ареной
+ * Возвращает 0 при успехе, -1 при нехватке памяти (ресурс не зарегистрирован)
+ */
+int arena_defer(Arena *arena, void (*release)(void *), void *resource) {
+    ArenaCleanup *cleanup = arena_alloc(arena, sizeof(ArenaCleanup));
+    if (cleanup == NULL) {
+        return -1;
+    }
+    cleanup->release = release;
+    cleanup->resource = resource;
+    cleanup->next = arena->cleanups;
+    arena->cleanups = cleanup;
+    return 0;
+}
+
+/*
+ * Переносит блоки и ресурсы src в dst без копирования данных
+ * Блоки src встают за текущим блоком dst, ресурсы освобождаются раньше ресурсов dst
+ */
+void arena_adopt(Arena *dst, Arena *src) {
+    if (src->blocks != NULL) {
+        ArenaBlock *last = src->blocks;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        if (dst->blocks != NULL) {
+            last->next = dst->blocks->next;
+            dst->blocks->next = src->blocks;
+        } else {
+            dst->blocks = src->blocks;
+        }
+    }
+    if (src->cleanups != NULL) {
+        ArenaCleanup *last = src->cleanups;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = dst->cleanups;
+        dst->cleanups = src->cleanups;
+    }
+    arena_init(src);
+}
+
+/* Освобождает все блоки и ресурсы; арена снова пуста */
+void arena_free(Arena *arena) {
+    // Записи об освобождении лежат в блоках арены: сначала ресурсы, затем память
+    for (ArenaCleanup *cleanup = arena->cleanups; cleanup != NULL; cleanup = cleanup->next) {
+        cleanup->release(cleanup->resource);
+    }
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
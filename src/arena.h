@@ -0,0 +1,53 @@
+#ifndef CNF_ARENA_H
+#define CNF_ARENA_H
+
+#include <stddef.h>
+
+/* Размер блока арены по умолчанию */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct ArenaCleanup ArenaCleanup;
+
+/*
+ * Арена: память выделяется из блоков подряд и освобождается целиком
+ * Кроме памяти арена может владеть внешними ресурсами (отображениями
+ * файлов), на которые ссылаются выделенные в ней данные
+ * Одну арену нельзя использовать из нескольких потоков одновременно
+ */
+typedef struct {
+    ArenaBlock *blocks;       // Текущий блок, за ним заполненные
+    ArenaCleanup *cleanups;   // Освобождение ресурсов в порядке, обратном добавлению
+} Arena;
+
+/* Инициализирует пустую арену */
+void arena_init(Arena *arena);
+
+/*
+ * Выделяет size байт, выровненных для любого типа
+ * Возвращает NULL при нехватке памяти
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/* Копирует len байт строки и завершает копию нулем */
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+
+/* Копирует строку, завершенную нулем */
+char *arena_strdup(Arena *arena, const char *str);
+
+/*
+ * Регистрирует освобождение ресурса вместе с ареной
+ * Возвращает 0 при успехе, -1 при нехватке памяти (ресурс не зарегистрирован)
+ */
+int arena_defer(Arena *arena, void (*release)(void *), void *resource);
+
+/*
+ * Переносит блоки и ресурсы src в dst без копирования данных
+ * src остается пустой
+ */
+void arena_adopt(Arena *dst, Arena *src);
+
+/* Освобождает все блоки и ресурсы; арена снова пуста */
+void arena_free(Arena *arena);
+
+#endif /* CNF_ARENA_H */
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "daemon.h"
+
+/* Программа, выполняющая поиск сама, если резидентная недоступна */
+#ifndef CNF_STANDALONE
+#define CNF_STANDALONE "/usr/bin/command-not-found"
+#endif
+
+/* Первая заданная переменная локали сообщений */
+static const char *messages_locale(void) {
+    static const char *const names[] = { "LC_ALL", "LC_MESSAGES", "LANG", NULL };
+    for (int i = 0; names[i] != NULL; i++) {
+        const char *value = getenv(names[i]);
+        if (value != NULL && value[0] != '\0') {
+            return value;
+        }
+    }
+    return "";
+}
+
+/*
+ * Клиент для обработчиков оболочки: передает команду программе,
+ * запущенной с --daemon, и выводит ее ответ
+ * Если она недоступна или аргументы отличаются от одного имени команды,
+ * запускается command-not-found с теми же аргументами
+ */
+int main(int argc, char *argv[]) {
+    char socket_path[MAX_PATH_LEN];
+    if (argc == 2 && argv[1][0] != '-' && getenv("CNF_NO_DAEMON") == NULL &&
+        daemon_socket_path(socket_path, sizeof(socket_path)) == 0) {
+        const char *path_env = getenv("PATH");
+        DaemonRequest request = { argv[1], path_env != NULL ? path_env : "", messages_locale() };
+        int code;
+        char exec_name[MAX_CMD_LEN];
+        if (daemon_query(socket_path, &request, stdout, &code, exec_name, sizeof(exec_name)) == 0) {
+            if (exec_name[0] != '\0') {
+                execlp(exec_name, exec_name, NULL);
+                perror("exec failed");
+                return 1;
+            }
+            return code;
+        }
+    }
+
+    argv[0] = CNF_STANDALONE;
+    execv(CNF_STANDALONE, argv);
+    perror(CNF_STANDALONE);
+    return 127;
+}
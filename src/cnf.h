@@ -0,0 +1,70 @@
+#ifndef CNF_H
+#define CNF_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Библиотека command-not-found для поиска внутри процесса оболочки
+ * (встроенные команды bash и zsh) без запуска command-not-found на каждую
+ * ненайденную команду
+ *
+ * Пути к данным, CNF_THREADS, CNF_BUDGET и CNF_STATS читаются из окружения
+ * при первом вызове. Состояние (кеш PATH, индекс, снимок установленных
+ * пакетов) общее для процесса, функции не потокобезопасны
+ * Совместимость: новые функции добавляются с увеличением CNF_API_VERSION,
+ * существующие не меняются в пределах soname libcommand-not-found.so.1
+ */
+
+#define CNF_API_VERSION 1
+
+#if defined(__GNUC__)
+#define CNF_EXPORT __attribute__((visibility("default")))
+#else
+#define CNF_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Результат cnf_quick_lookup */
+enum {
+    CNF_LOOKUP_EXEC = 0,    // Команду из exec_name нужно выполнить
+    CNF_LOOKUP_DONE = 1,    // Подсказка выведена, поиск не нужен
+    CNF_LOOKUP_SEARCH = 2,  // Нужен поиск по базе пакетов (cnf_lookup)
+};
+
+/* Возвращает версию API собранной библиотеки */
+CNF_EXPORT int cnf_api_version(void);
+
+/*
+ * Заранее читает каталоги path_env (NULL - PATH процесса), чтобы
+ * дочерние процессы оболочки получили готовый кеш
+ */
+CNF_EXPORT void cnf_prepare(const char *path_env);
+
+/*
+ * Проверяет раскладку, PATH (path_env, NULL - PATH процесса) и системные
+ * каталоги, не открывая базу пакетов
+ * Возвращает CNF_LOOKUP_*, -1 если имя команды слишком длинное
+ */
+CNF_EXPORT int cnf_quick_lookup(const char *command, const char *path_env, FILE *out,
+                                char *exec_name, size_t exec_size);
+
+/*
+ * Полный поиск, как при запуске command-not-found <command>
+ * Если команду нужно выполнить, ее имя записывается в exec_name и возвращается 0,
+ * иначе exec_name остается пустым и возвращается код завершения
+ */
+CNF_EXPORT int cnf_lookup(const char *command, const char *path_env, FILE *out,
+                          char *exec_name, size_t exec_size);
+
+/* Закрывает индекс и забывает снимок установленных пакетов */
+CNF_EXPORT void cnf_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CNF_H */
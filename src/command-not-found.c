@@ -3,395 +3,516 @@
 #include <string.h>
 #include <libintl.h>
 #include <locale.h>
-#include <wchar.h>
-#include <wctype.h>
 #include <unistd.h>
-#include <sys/stat.h>
-#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
-/* Макрос для интернационализации */
-#define _(string) gettext(string)
-/* Максимальная длина команды */
-#define MAX_CMD_LEN 2048
-/* Максимальная длина ввода пользователя */
-#define MAX_INPUT_LEN 100
-/* Максимальная длина пути */
-#define MAX_PATH_LEN 1024
+#include "common.h"
+#include "lookup.h"
+#include "index.h"
+#include "pkglist.h"
+#include "search.h"
+#include "arena.h"
+#include "typo.h"
+#include "stats.h"
+#include "daemon.h"
 
-/* Структура для сопоставления русских и английских символов раскладки */
-typedef struct {
-    const char *ru_char;  // Русский символ в UTF-8
-    char en_char;         // Соответствующий английский символ
-} LayoutMap;
-
-/* Таблица преобразования русской раскладки в английскую */
-const LayoutMap ru_to_en_map[] = {
-    {"а", 'f'}, {"б", ','}, {"в", 'd'}, {"г", 'u'}, {"д", 'l'}, {"е", 't'}, {"ё", '`'}, 
-    {"ж", ';'}, {"з", 'p'}, {"и", 'b'}, {"й", 'q'}, {"к", 'r'}, {"л", 'k'}, {"м", 'v'}, 
-    {"н", 'y'}, {"о", 'j'}, {"п", 'g'}, {"р", 'h'}, {"с", 'c'}, {"т", 'n'}, {"у", 'e'}, 
-    {"ф", 'a'}, {"х", '['}, {"ц", 'w'}, {"ч", 'x'}, {"ш", 'i'}, {"щ", 'o'}, {"ъ", ']'}, 
-    {"ы", 's'}, {"ь", 'm'}, {"э", '\''}, {"ю", '.'}, {"я", 'z'},
-    /* Заглавные буквы */
-    {"А", 'F'}, {"Б", '<'}, {"В", 'D'}, {"Г", 'U'}, {"Д", 'L'}, {"Е", 'T'}, {"Ё", '~'}, 
-    {"Ж", ':'}, {"З", 'P'}, {"И", 'B'}, {"Й", 'Q'}, {"К", 'R'}, {"Л", 'K'}, {"М", 'V'}, 
-    {"Н", 'Y'}, {"О", 'J'}, {"П", 'G'}, {"Р", 'H'}, {"С", 'C'}, {"Т", 'N'}, {"У", 'E'}, 
-    {"Ф", 'A'}, {"Х", '{'}, {"Ц", 'W'}, {"Ч", 'X'}, {"Ш", 'I'}, {"Щ", 'O'}, {"Ъ", '}'}, 
-    {"Ы", 'S'}, {"Ь", 'M'}, {"Э", '\"'}, {"Ю", '>'}, {"Я", 'Z'}
-};
+/* Формат вывода пакетного режима */
+typedef enum {
+    BATCH_FORMAT_TSV,
+    BATCH_FORMAT_JSON,
+} BatchFormat;
 
-/* Размер таблицы преобразования */
-const int map_size = sizeof(ru_to_en_map) / sizeof(ru_to_en_map[0]);
+/* Выводит строку в кавычках JSON */
+static void print_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
 
-/* Структура для хранения информации о пакете */
-typedef struct {
-    char package_name[256];    // Название пакета
-    char binary_path[256];     // Путь к бинарному файлу
-    char description[512];     // Описание пакета
-} PackageInfo;
-
-/* 
- * Определяет длину UTF-8 символа
- * Возвращает количество байт, занимаемых символом
+/*
+ * Читает имена команд: первое слово каждой строки, так что подходят
+ * и списки имен, и история оболочки; пустые строки и комментарии пропускаются
+ * Возвращает количество имен или -1 при ошибке
  */
-int utf8_char_len(const char *str) {
-    unsigned char c = (unsigned char)str[0];
-    if ((c & 0x80) == 0) return 1;        // 1-байтовый символ (0xxxxxxx)
-    else if ((c & 0xE0) == 0xC0) return 2; // 2-байтовый символ (110xxxxx)
-    else if ((c & 0xF0) == 0xE0) return 3; // 3-байтовый символ (1110xxxx)
-    else if ((c & 0xF8) == 0xF0) return 4; // 4-байтовый символ (11110xxx)
-    return 1; // По умолчанию 1 байт
+static int read_batch_names(FILE *in, char ***names_out) {
+    char **names = NULL;
+    int count = 0;
+    int cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    int failed = 0;
+
+    while (getline(&line, &line_cap, in) >= 0) {
+        char *name = line + strspn(line, " \t");
+        name[strcspn(name, " \t\r\n")] = '\0';
+        if (name[0] == '\0' || name[0] == '#' || strlen(name) > MAX_INPUT_LEN) {
+            continue;
+        }
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : 64;
+            char **grown = realloc(names, new_cap * sizeof(char *));
+            if (grown == NULL) {
+                failed = 1;
+                break;
+            }
+            names = grown;
+            cap = new_cap;
+        }
+        names[count] = strdup(name);
+        if (names[count] == NULL) {
+            failed = 1;
+            break;
+        }
+        count++;
+    }
+    free(line);
+
+    // Неполный список не обрабатывается: ответ выглядел бы полным
+    if (failed || ferror(in)) {
+        for (int i = 0; i < count; i++) {
+            free(names[i]);
+        }
+        free(names);
+        return -1;
+    }
+    *names_out = names;
+    return count;
 }
 
-/* 
- * Копирует один UTF-8 символ из src в dest
- * dest должен иметь размер не менее 5 байт
- */
-void utf8_char_copy(char *dest, const char *src) {
-    int len = utf8_char_len(src);
-    strncpy(dest, src, len);
-    dest[len] = '\0'; // Завершающий нуль
+/* Сравнивает строки для qsort */
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
 }
 
-/* 
- * Преобразует русский символ в соответствующий английский
- * Возвращает английский символ или оригинал, если сопоставление не найдено
+/*
+ * Пакетный режим: определяет состояние каждой команды из списка
+ * available - есть в PATH, system - только в системных каталогах,
+ * installed - пакет с командой установлен, missing - пакет нужно установить,
+ * unknown - пакет не найден
+ * Все имена ищутся одним проходом по базе, установленные пакеты
+ * проверяются по одному снимку; в конце выводится набор пакетов для установки
  */
-char convert_ru_to_en(const char *ru_char) {
-    for (int i = 0; i < map_size; i++) {
-        if (strcmp(ru_char, ru_to_en_map[i].ru_char) == 0) {
-            return ru_to_en_map[i].en_char;
+static int run_batch(const char *input_path, BatchFormat format, const LookupOptions *options) {
+    FILE *in = stdin;
+    if (input_path != NULL && strcmp(input_path, "-") != 0) {
+        in = fopen(input_path, "r");
+        if (in == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", input_path, strerror(errno));
+            return 1;
         }
     }
-    return ru_char[0]; // Возвращаем первый байт, если символ не найден
-}
+    char **names;
+    int count = read_batch_names(in, &names);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (count < 0) {
+        fprintf(stderr, "Failed to read command names\n");
+        return 1;
+    }
 
-/* 
- * Преобразует команду из русской раскладки в английскую
- * Обрабатывает многобайтовые UTF-8 символы
- */
-void convert_command(char* cmd) {
-    char converted[MAX_CMD_LEN] = {0}; // Буфер для преобразованной команды
-    int conv_index = 0; // Индекс в буфере converted
-    
-    // Обрабатываем команду посимвольно (с учетом UTF-8)
-    for (int i = 0; cmd[i] != '\0' && conv_index < MAX_INPUT_LEN - 1; ) {
-        int char_len = utf8_char_len(&cmd[i]);
-        
-        if (char_len > 1) {
-            // Многобайтовый UTF-8 символ (русская буква)
-            char utf8_char[5] = {0};
-            utf8_char_copy(utf8_char, &cmd[i]);
-            
-            // Преобразуем русский символ в английский
-            char en_char = convert_ru_to_en(utf8_char);
-            converted[conv_index++] = en_char;
-            i += char_len; // Пропускаем все байты UTF-8 символа
+    BatchResult *results = count > 0 ? malloc(count * sizeof(BatchResult)) : NULL;
+    const char **install = count > 0 ? malloc(count * sizeof(char *)) : NULL;
+    // Строки найденных пакетов живут в арене до конца вывода
+    Arena arena;
+    arena_init(&arena);
+    int rc = 0;
+    if (count > 0 && (results == NULL || install == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        rc = 1;
+        goto out;
+    }
+
+    StatsPhase previous = stats_enter(STATS_PHASE_SEARCH);
+    const char *pkglist_dir = lookup_paths()->pkglist_dir;
+    BatchQuery query = { (const char *const *)names, count, pkglist_dir, NULL, lookup_index(),
+                         options->threads };
+    int searched = search_batch(&query, results, &arena);
+    stats_leave(previous);
+    if (searched < 0) {
+        fprintf(stderr, "Failed to search %s: %s\n", pkglist_dir, strerror(errno));
+        rc = 1;
+        goto out;
+    }
+
+    if (format == BATCH_FORMAT_TSV) {
+        printf("# command\tstatus\tpackage\tpath\n");
+    } else {
+        printf("{\"commands\":[");
+    }
+
+    int install_count = 0;
+    int printed = 0;
+    for (int i = 0; i < count; i++) {
+        // Повторяющееся имя выводится один раз
+        if (results[i].first != i) {
+            continue;
+        }
+
+        const char *status;
+        const PackageInfo *package = results[i].found ? &results[i].package : NULL;
+        if (command_exists_in_path(names[i])) {
+            status = "available";
+            package = NULL;
+        } else if (command_exists_in_system_bin(names[i])) {
+            status = "system";
+            package = NULL;
+        } else if (package == NULL) {
+            status = "unknown";
+        } else if (package_is_installed(package->package_name)) {
+            status = "installed";
         } else {
-            // Однобайтовый символ (английская буква или другой символ)
-            converted[conv_index++] = cmd[i];
-            i++;
+            status = "missing";
+            install[install_count++] = package->package_name;
         }
-    }
-    
-    converted[conv_index] = '\0'; // Завершаем строку
-    strcpy(cmd, converted); // Копируем обратно в оригинальный буфер
-}
 
-/* 
- * Проверяет существование команды в путях PATH
- * Возвращает 1 если команда найдена, 0 если нет
- */
-int command_exists_in_path(const char *cmd) {
-    char *path = getenv("PATH");
-    if (!path) return 0;
+        if (format == BATCH_FORMAT_TSV) {
+            printf("%s\t%s\t%s\t%s\n", names[i], status, package != NULL ? package->package_name : "",
+                   package != NULL ? package->binary_path : "");
+        } else {
+            printf("%s\n{\"command\":", printed > 0 ? "," : "");
+            print_json_string(stdout, names[i]);
+            printf(",\"status\":\"%s\"", status);
+            if (package != NULL) {
+                printf(",\"package\":");
+                print_json_string(stdout, package->package_name);
+                printf(",\"path\":");
+                print_json_string(stdout, package->binary_path);
+            }
+            printf("}");
+        }
+        printed++;
+    }
 
-    char *path_copy = strdup(path); // Копируем PATH для безопасного разбора
-    char *dir = strtok(path_copy, ":");
-    
-    int found = 0;
-    // Проверяем каждый каталог в PATH
-    while (dir != NULL) {
-        char full_path[MAX_CMD_LEN];
-        snprintf(full_path, sizeof(full_path), "%s/%s", dir, cmd);
-        
-        if (access(full_path, X_OK) == 0) {
-            found = 1;
-            break;
+    // Набор пакетов для установки без повторов
+    qsort(install, install_count, sizeof(char *), compare_strings);
+    int unique = 0;
+    for (int i = 0; i < install_count; i++) {
+        if (unique == 0 || strcmp(install[unique - 1], install[i]) != 0) {
+            install[unique++] = install[i];
         }
-        dir = strtok(NULL, ":");
     }
-    
-    free(path_copy);
-    return found;
-}
 
-/* 
- * Проверяет существование команды в системных каталогах
- * Использует предопределенный список системных каталогов и команду which
- */
-int command_exists_in_system_bin(const char *cmd) {
-    // Список системных каталогов для поиска
-    const char *system_dirs[] = {
-        "/bin", "/sbin", "/usr/bin", "/usr/sbin", 
-        "/usr/local/bin", "/usr/local/sbin", NULL
-    };
-    
-    // Проверяем в каждом системном каталоге
-    for (int i = 0; system_dirs[i] != NULL; i++) {
-        char full_path[MAX_CMD_LEN];
-        snprintf(full_path, sizeof(full_path), "%s/%s", system_dirs[i], cmd);
-        
-        if (access(full_path, F_OK) == 0) {
-            return 1;
+    if (format == BATCH_FORMAT_TSV) {
+        printf("# install:");
+        for (int i = 0; i < unique; i++) {
+            printf(" %s", install[i]);
+        }
+        printf("\n");
+    } else {
+        printf("\n],\"install\":[");
+        for (int i = 0; i < unique; i++) {
+            if (i > 0) {
+                printf(",");
+            }
+            print_json_string(stdout, install[i]);
         }
+        printf("]}\n");
     }
+    lookup_report_stats("batch", "batch");
 
-    // Дополнительная проверка с помощью команды which
-    char cmd_which[MAX_CMD_LEN];
-    snprintf(cmd_which, sizeof(cmd_which), "which %s >/dev/null 2>&1", cmd);
-    
-    if (system(cmd_which) == 0) {
-        return 1;
+out:
+    free(install);
+    free(results);
+    arena_free(&arena);
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
     }
-    
-    return 0;
+    free(names);
+    return rc;
 }
 
-/* 
- * Проверяет установлен ли пакет в системе
- * Использует команду rpm для проверки
+/* Каталоги, за которыми следит резидентная программа */
+enum {
+    WATCH_PKGLIST = 1 << 0,
+    WATCH_RPMDB = 1 << 1,
+    WATCH_INDEX = 1 << 2,
+};
+
+/* Состояние резидентной программы */
+typedef struct {
+    LookupOptions *options;  // Параметры поиска для запросов
+    pid_t rebuild_pid;       // Процесс, строящий копию индекса (0 - нет)
+    int rebuild_again;       // pkglist изменились, пока копия строилась
+} DaemonState;
+
+/*
+ * Открывает индекс для резидентной программы
+ * Если ни системный индекс, ни копия в кеше пользователя не актуальны,
+ * копия строится в фоновом процессе: программа живет долго, и одна
+ * перестройка дешевле чтения pkglist на каждый запрос
+ * Пока процесс работает, запросы обслуживаются прежними данными
  */
-int package_is_installed(const char *package_name) {
-    char cmd[MAX_CMD_LEN];
-    snprintf(cmd, sizeof(cmd), "rpm -q %s >/dev/null 2>&1", package_name);
-    return system(cmd) == 0; // Возвращает 1 если пакет установлен
+static void prepare_daemon_index(DaemonState *state) {
+    if (state->rebuild_pid > 0) {
+        state->rebuild_again = 1;
+        return;
+    }
+    if (lookup_switch_index() == 0) {
+        return;
+    }
+    state->rebuild_pid = lookup_start_rebuild(1);
 }
 
-/* 
- * Проверяет существует ли пакет уже в массиве результатов
- * Используется для избежания дубликатов при поиске
+/*
+ * Забирает завершившийся процесс перестройки и переключается на его индекс
+ * Если pkglist успели измениться еще раз, индекс подбирается заново
  */
-int package_already_exists(const PackageInfo *packages, int count, const char *package_name) {
-    for (int i = 0; i < count; i++) {
-        if (strcmp(packages[i].package_name, package_name) == 0) {
-            return 1;
-        }
+static void check_daemon_rebuild(DaemonState *state) {
+    if (state->rebuild_pid <= 0 || waitpid(state->rebuild_pid, NULL, WNOHANG) == 0) {
+        return;
+    }
+    state->rebuild_pid = 0;
+    if (state->rebuild_again) {
+        state->rebuild_again = 0;
+        prepare_daemon_index(state);
+    } else {
+        lookup_switch_index();
     }
-    return 0;
 }
 
-/* 
- * Функция сравнения для qsort
- * Сравнивает пакеты по длине имени, затем по алфавиту
- */
-int compare_package_by_name_length(const void *a, const void *b) {
-    const PackageInfo *pkg_a = (const PackageInfo *)a;
-    const PackageInfo *pkg_b = (const PackageInfo *)b;
-    
-    int len_a = strlen(pkg_a->package_name);
-    int len_b = strlen(pkg_b->package_name);
-    
-    // Сначала сравниваем по длине имени
-    if (len_a != len_b) {
-        return len_a - len_b;
+/* Сбрасывает данные, которые устарели после изменения каталогов */
+static void daemon_data_changed(unsigned changed, void *user_data) {
+    DaemonState *state = user_data;
+    check_daemon_rebuild(state);
+    // Пока идет обновление, открывается прежнее поколение сегментов:
+    // новое подхватывается по изменению каталога индекса
+    if (changed & (WATCH_PKGLIST | WATCH_INDEX)) {
+        prepare_daemon_index(state);
+    }
+    if (changed & WATCH_RPMDB) {
+        lookup_release_installed();
+    }
+}
+
+/* Переключает локаль сообщений на локаль клиента или возвращает свою */
+static void set_request_locale(const char *locale) {
+    if (locale[0] == '\0' || setlocale(LC_MESSAGES, locale) == NULL) {
+        setlocale(LC_MESSAGES, "");
+        setlocale(LC_CTYPE, "");
+        return;
+    }
+    if (setlocale(LC_CTYPE, locale) == NULL) {
+        setlocale(LC_CTYPE, "");
     }
-    
-    // При равной длине - по алфавиту
-    return strcmp(pkg_a->package_name, pkg_b->package_name);
 }
 
-/* 
- * Ищет пакет, содержащий указанную команду
- * Использует pkglist-query для поиска в базе пакетов
- * Возвращает 1 если пакет найден, 0 если нет
+/* Обрабатывает запрос оболочки так же, как обычный запуск программы */
+static int handle_daemon_request(const DaemonRequest *request, FILE *out,
+                                 char *exec_name, size_t exec_size, void *user_data) {
+    DaemonState *state = user_data;
+    if (strlen(request->command) > MAX_INPUT_LEN) {
+        fprintf(out, "Input command too long\n");
+        return 1;
+    }
+    check_daemon_rebuild(state);
+    set_request_locale(request->locale);
+    lookup_set_path(request->path_env);
+    stats_reset();
+    return lookup_command(request->command, state->options, out, exec_name, exec_size);
+}
+
+/*
+ * Резидентный режим: индекс, дерево опечаток, кеш PATH и снимок
+ * установленных пакетов остаются в памяти между запросами оболочки
  */
-int find_package_for_command(const char *command_name, PackageInfo *result) {
-    DIR *dir;
-    struct dirent *entry;
-    char *pkglist_dir = "/var/lib/apt/lists"; // Каталог с информацией о пакетах
-    int found = 0;
-    
-    dir = opendir(pkglist_dir);
+static int run_daemon(LookupOptions *options) {
+    char socket_path[MAX_PATH_LEN];
+    if (daemon_socket_path(socket_path, sizeof(socket_path)) != 0) {
+        fprintf(stderr, "XDG_RUNTIME_DIR is not set, cannot create the daemon socket\n");
+        return 1;
+    }
+
+    // Копию индекса строит только сама программа, по запросам она не запускается;
+    // все данные и так в памяти, кеш ответов только добавил бы запись файла
+    options->warm_cache = 0;
+    options->answer_cache = 0;
+    DaemonState state = { options, 0, 0 };
+    prepare_daemon_index(&state);
+
+    const char *const watch_dirs[] = { lookup_paths()->pkglist_dir, lookup_paths()->rpmdb_dir,
+                                       lookup_paths()->index_path, NULL };
+    if (daemon_serve(socket_path, watch_dirs, daemon_data_changed, handle_daemon_request, &state) != 0) {
+        fprintf(stderr, "Failed to serve %s: %s\n", socket_path, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+/* Суммарный размер файлов pkglist в каталоге */
+static uint64_t pkglist_sources_size(const char *pkglist_dir) {
+    uint64_t total = 0;
+    DIR *dir = opendir(pkglist_dir);
     if (dir == NULL) {
         return 0;
     }
-    
-    // Читаем все файлы в каталоге pkglist
+    struct dirent *entry;
     while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, "pkglist.") != NULL) {
-            char filepath[MAX_PATH_LEN];
-            snprintf(filepath, sizeof(filepath), "%s/%s", pkglist_dir, entry->d_name);
-            
-            // Формируем команду для запроса информации о пакете
-            char cmd[MAX_CMD_LEN];
-            int needed = snprintf(cmd, sizeof(cmd), 
-                     "pkglist-query \"[%%{FILENAMES}\\t%%{NAME}\\t%%{SUMMARY}\\n]\" \"%s\" 2>/dev/null", 
-                     filepath);
-            
-            if (needed >= (int)sizeof(cmd)) {
-                continue; // Пропускаем если команда слишком длинная
-            }
-            
-            // Выполняем команду и читаем вывод
-            FILE *fp = popen(cmd, "r");
-            if (fp == NULL) {
-                continue;
-            }
-            
-            char line[MAX_CMD_LEN];
-            while (fgets(line, sizeof(line), fp) != NULL) {
-                // Разбираем строку: путь, имя пакета, описание
-                char *path = strtok(line, "\t");
-                char *package = strtok(NULL, "\t");
-                char *description = strtok(NULL, "\n");
-                
-                if (path != NULL && package != NULL && description != NULL) {
-                    // Извлекаем имя файла из полного пути
-                    char *filename = strrchr(path, '/');
-                    if (filename != NULL) {
-                        filename++;
-                        
-                        // Проверяем совпадение имени команды
-                        if (strcmp(filename, command_name) == 0) {
-                            // Заполняем структуру результата
-                            strncpy(result->package_name, package, sizeof(result->package_name) - 1);
-                            strncpy(result->binary_path, path, sizeof(result->binary_path) - 1);
-                            strncpy(result->description, description, sizeof(result->description) - 1);
-                            
-                            // Гарантируем завершение строк
-                            result->package_name[sizeof(result->package_name) - 1] = '\0';
-                            result->binary_path[sizeof(result->binary_path) - 1] = '\0';
-                            result->description[sizeof(result->description) - 1] = '\0';
-                            
-                            found = 1;
-                            break;
-                        }
-                    }
-                }
-            }
-            pclose(fp);
-            
-            if (found) {
-                break;
-            }
+        struct stat st;
+        if (is_pkglist_file(entry->d_name) && fstatat(dirfd(dir), entry->d_name, &st, 0) == 0) {
+            total += st.st_size;
         }
     }
-    
     closedir(dir);
-    return found;
+    return total;
 }
 
-/* 
- * Ищет пакеты с похожими именами
- * Возвращает количество найденных пакетов (до max_results)
+/*
+ * Сверяет сегмент seg_name с его файлом pkglist
+ * Возвращает "up to date", "stale" или "no pkglist"
  */
-int find_similar_packages_by_name_only(const char *pattern, PackageInfo results[], int max_results) {
-    DIR *dir;
-    struct dirent *entry;
-    char *pkglist_dir = "/var/lib/apt/lists";
-    int count = 0;
-    
-    dir = opendir(pkglist_dir);
+static const char *segment_state(const char *seg_name, const IndexHeader *header, const char *pkglist_dir) {
+    size_t len = strlen(seg_name);
+    size_t suffix_len = strlen(INDEX_SEGMENT_SUFFIX);
+    if (len <= suffix_len || strcmp(seg_name + len - suffix_len, INDEX_SEGMENT_SUFFIX) != 0) {
+        return "no pkglist";
+    }
+    char source[MAX_PATH_LEN];
+    struct stat st;
+    snprintf(source, sizeof(source), "%s/%.*s", pkglist_dir, (int)(len - suffix_len), seg_name);
+    if (stat(source, &st) != 0) {
+        return "no pkglist";
+    }
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return mtime == header->source_mtime && (uint64_t)st.st_size == header->source_size ? "up to date" : "stale";
+}
+
+/*
+ * Выводит размеры разделов одного сегмента и проверяет все его блоки и таблицы
+ * Возвращает 0 если сегмент цел, 1 если он не открывается или поврежден
+ */
+static int inspect_segment_file(const char *path, const char *pkglist_dir) {
+    IndexSegment segment;
+    if (index_segment_open(&segment, path) != 0) {
+        fprintf(stderr, "Failed to open index segment %s: not a version %d segment\n", path, INDEX_VERSION);
+        return 1;
+    }
+
+    IndexReport report;
+    int rc = index_segment_verify(&segment, &report);
+    const IndexHeader *header = segment.header;
+    const char *slash = strrchr(path, '/');
+
+    printf("Segment: %s (format %u, %d entries per block)\n", path, header->version, INDEX_BLOCK_ENTRIES);
+    printf("Entries: %u in %u blocks, largest block %u bytes\n",
+           header->entry_count, header->block_count, report.max_block_size);
+    printf("Packages: %u, trigrams: %u\n", header->package_count, header->trigram_count);
+    printf("  %-10s %12" PRIu64 " bytes\n", "directory", report.directory_size);
+    printf("  %-10s %12" PRIu64 " bytes (paths %" PRIu64 " bytes, %.1fx)\n", "entries", report.data_size,
+           report.paths_size, report.data_size > 0 ? (double)report.paths_size / report.data_size : 0.0);
+    printf("  %-10s %12" PRIu64 " bytes\n", "packages", report.packages_size);
+    printf("  %-10s %12" PRIu64 " bytes\n", "strings", report.strings_size);
+    printf("  %-10s %12" PRIu64 " bytes\n", "trigrams", report.trigrams_size);
+    printf("  %-10s %12zu bytes, %.1f bytes per entry\n", "total", segment.size,
+           header->entry_count > 0 ? (double)segment.size / header->entry_count : 0.0);
+    printf("Source: %" PRIu64 " bytes of pkglist in %s, segment %s\n", header->source_size, pkglist_dir,
+           segment_state(slash != NULL ? slash + 1 : path, header, pkglist_dir));
+    if (rc == 0) {
+        printf("Check: ok\n");
+    } else {
+        printf("Check: %u errors, first: %s\n", report.errors, report.first_error);
+    }
+
+    index_segment_close(&segment);
+    return rc == 0 ? 0 : 1;
+}
+
+/*
+ * Выводит по строке на каждый сегмент каталога индекса и общие размеры;
+ * файл вместо каталога выводится подробно как один сегмент
+ * Возвращает 0 если все сегменты целы, 1 если какой-то не открывается или поврежден
+ */
+static int run_inspect_index(const char *index_path, const char *pkglist_dir) {
+    struct stat st;
+    if (stat(index_path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+        return inspect_segment_file(index_path, pkglist_dir);
+    }
+    DIR *dir = opendir(index_path);
     if (dir == NULL) {
-        return 0;
+        fprintf(stderr, "Failed to open index %s: %s\n", index_path, strerror(errno));
+        return 1;
     }
-    
-    // Временный массив для всех результатов
-    PackageInfo all_results[100];
-    int all_count = 0;
-    
-    // Поиск во всех файлах pkglist
-    while ((entry = readdir(dir)) != NULL && all_count < 100) {
-        if (strstr(entry->d_name, "pkglist.") != NULL) {
-            char filepath[MAX_PATH_LEN];
-            snprintf(filepath, sizeof(filepath), "%s/%s", pkglist_dir, entry->d_name);
-            
-            char cmd[MAX_CMD_LEN];
-            int needed = snprintf(cmd, sizeof(cmd), 
-                     "pkglist-query \"[%%{FILENAMES}\\t%%{NAME}\\t%%{SUMMARY}\\n]\" \"%s\" 2>/dev/null", 
-                     filepath);
-            
-            if (needed >= (int)sizeof(cmd)) {
-                continue;
-            }
-            
-            FILE *fp = popen(cmd, "r");
-            if (fp == NULL) {
-                continue;
-            }
-            
-            char line[MAX_CMD_LEN];
-            while (fgets(line, sizeof(line), fp) != NULL && all_count < 100) {
-                char *path = strtok(line, "\t");
-                char *package = strtok(NULL, "\t");
-                char *description = strtok(NULL, "\n");
-                
-                if (path != NULL && package != NULL && description != NULL) {
-                    // Ищем пакеты, содержащие pattern в имени
-                    if (strstr(package, pattern) != NULL) {
-                        // Проверяем дубликаты
-                        if (!package_already_exists(all_results, all_count, package)) {
-                            // Сохраняем информацию о пакете
-                            strncpy(all_results[all_count].package_name, package, 
-                                   sizeof(all_results[all_count].package_name) - 1);
-                            strncpy(all_results[all_count].binary_path, path, 
-                                   sizeof(all_results[all_count].binary_path) - 1);
-                            strncpy(all_results[all_count].description, description, 
-                                   sizeof(all_results[all_count].description) - 1);
-                            
-                            // Гарантируем завершение строк
-                            all_results[all_count].package_name[sizeof(all_results[all_count].package_name) - 1] = '\0';
-                            all_results[all_count].binary_path[sizeof(all_results[all_count].binary_path) - 1] = '\0';
-                            all_results[all_count].description[sizeof(all_results[all_count].description) - 1] = '\0';
-                            
-                            all_count++;
-                        }
-                    }
-                }
-            }
-            pclose(fp);
+
+    printf("Index: %s (format %d, %d entries per block)\n", index_path, INDEX_VERSION, INDEX_BLOCK_ENTRIES);
+    int segments = 0;
+    int broken = 0;
+    int fresh = 0;
+    uint64_t entries = 0;
+    uint64_t size = 0;
+    uint64_t paths_size = 0;
+    uint64_t data_size = 0;
+    size_t suffix_len = strlen(INDEX_SEGMENT_SUFFIX);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, INDEX_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        char path[MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/%s", index_path, entry->d_name);
+        segments++;
+
+        IndexSegment segment;
+        if (index_segment_open(&segment, path) != 0) {
+            printf("  %-40s not a version %d segment\n", entry->d_name, INDEX_VERSION);
+            broken++;
+            continue;
         }
+        IndexReport report;
+        int rc = index_segment_verify(&segment, &report);
+        const char *state = segment_state(entry->d_name, segment.header, pkglist_dir);
+        printf("  %-40s %9u entries %11zu bytes  %s, %s\n", entry->d_name, segment.header->entry_count,
+               segment.size, rc == 0 ? "ok" : report.first_error, state);
+        broken += rc != 0;
+        fresh += strcmp(state, "up to date") == 0;
+        entries += segment.header->entry_count;
+        size += segment.size;
+        paths_size += report.paths_size;
+        data_size += report.data_size;
+        index_segment_close(&segment);
     }
-    
     closedir(dir);
-    
-    // Сортируем результаты по длине имени
-    qsort(all_results, all_count, sizeof(PackageInfo), compare_package_by_name_length);
-    
-    // Возвращаем не более max_results результатов
-    count = (all_count < max_results) ? all_count : max_results;
-    for (int i = 0; i < count; i++) {
-        memcpy(&results[i], &all_results[i], sizeof(PackageInfo));
+
+    printf("Segments: %d, %d up to date\n", segments, fresh);
+    printf("Entries: %" PRIu64 ", paths %" PRIu64 " bytes, %.1fx\n", entries, paths_size,
+           data_size > 0 ? (double)paths_size / data_size : 0.0);
+    printf("Total: %" PRIu64 " bytes, %.1f bytes per entry\n", size,
+           entries > 0 ? (double)size / entries : 0.0);
+    printf("Sources: %" PRIu64 " bytes of pkglist in %s\n", pkglist_sources_size(pkglist_dir), pkglist_dir);
+    if (broken == 0) {
+        printf("Check: ok\n");
+    } else {
+        printf("Check: %d broken segments\n", broken);
     }
-    
-    return count;
+    return broken == 0 ? 0 : 1;
 }
 
 /* Выводит справку по использованию программы */
 void print_usage() {
     printf("Usage:\n");
     printf("  command-not-found <command>    - Search for a command and suggest packages\n");
+    printf("  command-not-found --threads=N <command> - Scan pkglist files with N threads\n");
+    printf("  command-not-found --stats[=FILE] <command> - Print per-phase timings to stderr or append JSON to FILE\n");
+    printf("  command-not-found --budget=MSms <command> - Stop slow searches after MS milliseconds\n");
+    printf("  command-not-found --batch[=FILE] [--format=tsv|json] - Resolve command names read from FILE or stdin\n");
+    printf("  command-not-found --rebuild-index - Rebuild the command index from pkglist files\n");
+    printf("  command-not-found --pin-index - Keep answering from the current index until the next --rebuild-index\n");
+    printf("  command-not-found --inspect-index[=PATH] - Print index segment sizes and verify every block\n");
+    printf("  command-not-found --daemon     - Serve shell hooks from memory over $XDG_RUNTIME_DIR/%s\n",
+           DAEMON_SOCKET_NAME);
     printf("  command-not-found --help       - Show this help message\n");
 }
 
@@ -404,110 +525,129 @@ int main(int argc, char *argv[]) {
     bindtextdomain("command-not-found", "/usr/share/locale/");
     textdomain("command-not-found");
     
+    // Пути к данным, PATH и параметры поиска из окружения
+    LookupOptions options;
+    lookup_init(&options);
+    const LookupPaths *paths = lookup_paths();
+
+    // Разбор параметров, предшествующих имени команды; --batch и --format
+    // принимаются в любом порядке
+    BatchFormat batch_format = BATCH_FORMAT_TSV;
+    int format_given = 0;
+    int batch = 0;
+    const char *batch_input = NULL;
+    int arg_index = 1;
+    while (arg_index < argc) {
+        const char *arg = argv[arg_index];
+        if (strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = atoi(arg + 10);
+        } else if (strncmp(arg, "--budget=", 9) == 0) {
+            options.budget_ms = lookup_parse_budget(arg + 9);
+            if (options.budget_ms < 0) {
+                fprintf(stderr, "Invalid budget: %s\n", arg + 9);
+                return 1;
+            }
+        } else if (strncmp(arg, "--format=", 9) == 0) {
+            if (strcmp(arg + 9, "tsv") == 0) {
+                batch_format = BATCH_FORMAT_TSV;
+            } else if (strcmp(arg + 9, "json") == 0) {
+                batch_format = BATCH_FORMAT_JSON;
+            } else {
+                fprintf(stderr, "Invalid format: %s\n", arg + 9);
+                return 1;
+            }
+            format_given = 1;
+        } else if (strcmp(arg, "--batch") == 0 || strncmp(arg, "--batch=", 8) == 0) {
+            batch = 1;
+            batch_input = arg[7] == '=' ? arg + 8 : NULL;
+        } else if (strcmp(arg, "--stats") == 0) {
+            lookup_enable_stats("");
+        } else if (strncmp(arg, "--stats=", 8) == 0) {
+            lookup_enable_stats(arg + 8);
+        } else {
+            break;
+        }
+        arg_index++;
+    }
+
+    // Пакетный режим читает имена из файла или stdin: лишний аргумент
+    // означает ошибку в вызове, а не имя для поиска
+    if (format_given && !batch) {
+        fprintf(stderr, "--format is only valid with --batch\n");
+        return 1;
+    }
+    if (batch) {
+        if (arg_index < argc) {
+            fprintf(stderr, "Unexpected argument: %s\n", argv[arg_index]);
+            return 1;
+        }
+        return run_batch(batch_input, batch_format, &options);
+    }
+
+
     // Обработка аргументов командной строки
-    if (argc == 2) {
-        if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+    if (argc - arg_index == 1) {
+        const char *arg = argv[arg_index];
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
             print_usage();
             return 0;
         }
-        else if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-v") == 0) {
+        else if (strcmp(arg, "--version") == 0 || strcmp(arg, "-v") == 0) {
             printf("command-not-found with direct pkglist query\n");
             return 0;
         }
+        else if (strcmp(arg, "--rebuild-index") == 0) {
+            int rebuilt;
+            long entries = index_rebuild(paths->index_path, paths->pkglist_dir, &rebuilt);
+            if (entries < 0) {
+                fprintf(stderr, "Failed to rebuild index %s: %s\n", paths->index_path, strerror(errno));
+                return 1;
+            }
+            printf("Index rebuilt: %ld entries, %d segments updated\n", entries, rebuilt);
+
+            long commands = typo_tree_rebuild(paths->typo_path, paths->index_path, paths->pkglist_dir);
+            if (commands < 0) {
+                fprintf(stderr, "Failed to rebuild typo index %s: %s\n", paths->typo_path, strerror(errno));
+                return 1;
+            }
+            printf("Typo index rebuilt: %ld commands\n", commands);
+            return 0;
+        }
+        else if (strcmp(arg, "--pin-index") == 0) {
+            if (index_pin(paths->index_path) != 0) {
+                fprintf(stderr, "Failed to pin index %s: %s\n", paths->index_path, strerror(errno));
+                return 1;
+            }
+            return 0;
+        }
+        else if (strcmp(arg, "--inspect-index") == 0 || strncmp(arg, "--inspect-index=", 16) == 0) {
+            return run_inspect_index(arg[15] == '=' ? arg + 16 : paths->index_path, paths->pkglist_dir);
+        }
+        else if (strcmp(arg, "--daemon") == 0) {
+            return run_daemon(&options);
+        }
     }
     
     // Проверка количества аргументов
-    if (argc < 2) {
+    if (argc - arg_index < 1) {
         print_usage();
         return 1;
     }
 
     // Проверка длины входной команды
-    if (strlen(argv[1]) > MAX_INPUT_LEN) {
+    const char *command = argv[arg_index];
+    if (strlen(command) > MAX_INPUT_LEN) {
         fprintf(stderr, "Input command too long\n");
         return 1;
     }
 
-    // Создаем копии оригинальной и преобразованной команды
-    char converted_cmd[MAX_INPUT_LEN + 1];
-    strncpy(converted_cmd, argv[1], MAX_INPUT_LEN);
-    converted_cmd[MAX_INPUT_LEN] = '\0';
-    
-    char original_cmd[MAX_INPUT_LEN + 1];
-    strncpy(original_cmd, argv[1], MAX_INPUT_LEN);
-    original_cmd[MAX_INPUT_LEN] = '\0';
-    
-    // Пытаемся преобразовать команду (автокоррекция раскладки)
-    convert_command(converted_cmd);
-    if (strcmp(original_cmd, converted_cmd) != 0) {
-        // Если команда преобразована и существует - выполняем ее
-        if (command_exists_in_path(converted_cmd)) {
-            printf("Auto-correcting '%s' to '%s' and executing:\n", original_cmd, converted_cmd);
-            execlp(converted_cmd, converted_cmd, NULL);
-            perror("exec failed");
-            return 1;
-        }
-    }
-
-    // Пытаемся выполнить оригинальную команду
-    if (command_exists_in_path(original_cmd)) {
-        execlp(original_cmd, original_cmd, NULL);
+    char exec_name[MAX_INPUT_LEN + 1];
+    int code = lookup_command(command, &options, stdout, exec_name, sizeof(exec_name));
+    if (exec_name[0] != '\0') {
+        fflush(stdout);
+        execlp(exec_name, exec_name, NULL);
         perror("exec failed");
         return 1;
     }
-
-    // Проверяем существование команды в системных каталогах
-    if (command_exists_in_system_bin(original_cmd)) {
-        printf("%s: %s\n", original_cmd, _("Command found in system directories but not in your PATH"));
-        printf("%s 'su - -c \"%s\"'\n", _("Try running as root:"), original_cmd);
-        return 127;
-    }
-    // Проверяем преобразованную команду в системных каталогах
-    if (strcmp(original_cmd, converted_cmd) != 0 && command_exists_in_system_bin(converted_cmd)) {
-        printf("%s '%s'?\n", _("Did you mean"), converted_cmd);
-        printf("%s 'su - -c \"%s\"'\n", _("Try running as root:"), converted_cmd);
-        return 127;
-    }
-
-    fflush(stdout);
-
-    // Поиск пакета, содержащего команду
-    PackageInfo package_info;
-    int found = find_package_for_command(converted_cmd, &package_info);
-
-    if (found) {
-        if (package_is_installed(package_info.package_name)) {
-            // Пакет установлен, но команда не найдена
-            printf("%s\n", _("Package is already installed but command not found."));
-            printf("%s: %s\n", _("Package"), package_info.package_name);
-            printf("%s: %s\n", _("Binary path"), package_info.binary_path);
-            printf("%s: %s\n", _("Description"), package_info.description);
-        } else {
-            // Предлагаем установить пакет
-            printf("%s:\n", _("The program can be installed using"));
-            printf("su - -c 'apt-get install %s'\n", package_info.package_name);
-            printf("%s: %s\n", _("Description"), package_info.description);
-        }
-    } else {
-        // Поиск похожих пакетов по имени
-        printf("%s\n", _("Perhaps you were looking for:"));
-        
-        PackageInfo similar_results[3];
-        int result_count = find_similar_packages_by_name_only(converted_cmd, similar_results, 3);
-        
-        if (result_count > 0) {
-            for (int i = 0; i < result_count; i++) {
-                if (package_is_installed(similar_results[i].package_name)) {
-                    printf("%s [%s]\n", similar_results[i].package_name, _("already installed"));
-                } else {
-                    printf("%s - %s\n", similar_results[i].package_name, similar_results[i].description);
-                }
-            }
-        } else {
-            // Если похожих пакетов не найдено
-            printf("%s 'apt-cache search %s'\n", _("Try:"), converted_cmd);
-        }
-    }
-
-    return 127;
-}
\ No newline at end of file
+    return code;
+}
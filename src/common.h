@@ -0,0 +1,56 @@
+#ifndef CNF_COMMON_H
+#define CNF_COMMON_H
+
+#include <libintl.h>
+
+/* Домен переводов; задается сборкой */
+#ifndef GETTEXT_PACKAGE
+#define GETTEXT_PACKAGE "command-not-found"
+#endif
+
+/*
+ * Макрос для интернационализации
+ * Домен указан явно: код поиска работает и внутри оболочки,
+ * где текущий домен принадлежит ей
+ */
+#define _(string) dgettext(GETTEXT_PACKAGE, string)
+/* Максимальная длина команды */
+#define MAX_CMD_LEN 2048
+/* Максимальная длина ввода пользователя */
+#define MAX_INPUT_LEN 100
+/* Максимальная длина пути */
+#define MAX_PATH_LEN 1024
+
+/* Каталог с информацией о пакетах */
+#ifndef PKGLIST_DIR
+#define PKGLIST_DIR "/var/lib/apt/lists"
+#endif
+
+/* Каталог сегментов индекса команда -> пакет */
+#ifndef INDEX_PATH
+#define INDEX_PATH "/var/cache/command-not-found/index"
+#endif
+
+/* BK-дерево имен команд для исправления опечаток */
+#ifndef TYPO_PATH
+#define TYPO_PATH "/var/cache/command-not-found/typo"
+#endif
+
+/*
+ * Информация о пакете
+ * Строки не копируются: они указывают в отображенный pkglist или индекс
+ * либо в арену результата и живут, пока результат не освобожден
+ */
+typedef struct {
+    const char *package_name;  // Название пакета
+    const char *binary_path;   // Путь к бинарному файлу
+    const char *description;   // Описание пакета
+} PackageInfo;
+
+/* Копирует строку в буфер фиксированного размера с гарантированным завершением */
+#define copy_field(dest, src) do { \
+        strncpy((dest), (src), sizeof(dest) - 1); \
+        (dest)[sizeof(dest) - 1] = '\0'; \
+    } while (0)
+
+#endif /* CNF_COMMON_H */
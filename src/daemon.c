@@ -0,0 +1,403 @@
+/* struct ucred и accept4 */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+
+#include "common.h"
+#include "daemon.h"
+#include "util.h"
+
+/* Время без изменений в каталогах, после которого вызывается on_change */
+#define DAEMON_SETTLE_MS 1000
+
+/* Таймаут чтения запроса и записи ответа */
+#define DAEMON_IO_TIMEOUT_MS 2000
+
+/* Таймаут ожидания начала ответа клиентом; дольше выгоднее работать без демона */
+#define DAEMON_CLIENT_TIMEOUT_MS 1000
+
+/* Первый сокет, переданный systemd */
+#define SD_LISTEN_FDS_START 3
+
+/* Флаг завершения, выставляется обработчиком сигнала */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/*
+ * Формирует путь к сокету в $XDG_RUNTIME_DIR
+ * Возвращает 0 при успехе, -1 если каталог не задан или путь слишком длинный
+ */
+int daemon_socket_path(char *buf, size_t size) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime == NULL || runtime[0] != '/') {
+        return -1;
+    }
+    int len = snprintf(buf, size, "%s/%s", runtime, DAEMON_SOCKET_NAME);
+    if (len < 0 || (size_t)len >= size || (size_t)len >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Заполняет адрес сокета; путь уже проверен daemon_socket_path */
+static socklen_t socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return sizeof(*addr);
+}
+
+/* Устанавливает таймауты чтения и записи сокета */
+static void set_timeouts(int fd, int timeout_ms) {
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* Подключается к сокету; возвращает дескриптор или -1 */
+static int connect_socket(const char *path) {
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(&addr, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Возвращает слушающий сокет: переданный systemd или созданный по пути path
+ * *created выставляется в 1, если файл сокета нужно удалить при завершении
+ */
+static int listen_socket(const char *path, int *created) {
+    *created = 0;
+    const char *listen_pid = getenv("LISTEN_PID");
+    const char *listen_fds = getenv("LISTEN_FDS");
+    if (listen_pid != NULL && listen_fds != NULL &&
+        atol(listen_pid) == (long)getpid() && atoi(listen_fds) >= 1) {
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDS");
+        return SD_LISTEN_FDS_START;
+    }
+
+    // Сокет отвечающей программы не трогаем: второй экземпляр не нужен
+    int running = connect_socket(path);
+    if (running >= 0) {
+        close(running);
+        errno = EADDRINUSE;
+        return -1;
+    }
+    unlink(path);
+
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(&addr, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    mode_t mask = umask(0077);
+    int rc = bind(fd, (struct sockaddr *)&addr, addr_len);
+    umask(mask);
+    if (rc != 0 || listen(fd, 16) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    *created = 1;
+    return fd;
+}
+
+/*
+ * Разбирает запрос "CNF1\0команда\0PATH\0локаль\0"
+ * Возвращает 0 при успехе, -1 при неверном формате
+ */
+static int parse_request(char *buf, size_t len, DaemonRequest *request) {
+    const char *fields[4];
+    size_t pos = 0;
+    for (int i = 0; i < 4; i++) {
+        char *end = memchr(buf + pos, '\0', len - pos);
+        if (end == NULL) {
+            return -1;
+        }
+        fields[i] = buf + pos;
+        pos = (size_t)(end - buf) + 1;
+    }
+    if (strcmp(fields[0], DAEMON_PROTOCOL) != 0 || fields[1][0] == '\0') {
+        return -1;
+    }
+    request->command = fields[1];
+    request->path_env = fields[2];
+    request->locale = fields[3];
+    return 0;
+}
+
+/* Читает запрос клиента, обрабатывает его и отправляет ответ */
+static void serve_client(int fd, DaemonHandler handler, void *user_data) {
+    // Запросы принимаются только от того же пользователя
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 || cred.uid != getuid()) {
+        return;
+    }
+    set_timeouts(fd, DAEMON_IO_TIMEOUT_MS);
+
+    char *buf = malloc(DAEMON_MAX_REQUEST);
+    if (buf == NULL) {
+        return;
+    }
+    size_t len = 0;
+    for (;;) {
+        if (len == DAEMON_MAX_REQUEST) {
+            free(buf);
+            return;
+        }
+        ssize_t got = read(fd, buf + len, DAEMON_MAX_REQUEST - len);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            free(buf);
+            return;
+        }
+        if (got == 0) {
+            break;
+        }
+        len += (size_t)got;
+    }
+
+    DaemonRequest request;
+    if (parse_request(buf, len, &request) != 0) {
+        free(buf);
+        return;
+    }
+
+    // Ответ собирается целиком: первая строка зависит от результата
+    char *output = NULL;
+    size_t output_len = 0;
+    FILE *out = open_memstream(&output, &output_len);
+    if (out == NULL) {
+        free(buf);
+        return;
+    }
+    char exec_name[MAX_CMD_LEN];
+    exec_name[0] = '\0';
+    int code = handler(&request, out, exec_name, sizeof(exec_name), user_data);
+    fclose(out);
+    free(buf);
+
+    char header[MAX_CMD_LEN + 32];
+    int header_len;
+    if (exec_name[0] != '\0') {
+        header_len = snprintf(header, sizeof(header), "%d exec %s\n", code, exec_name);
+    } else {
+        header_len = snprintf(header, sizeof(header), "%d print\n", code);
+    }
+    if (header_len > 0 && (size_t)header_len < sizeof(header) &&
+        write_all(fd, header, (size_t)header_len) == 0) {
+        write_all(fd, output, output_len);
+    }
+    free(output);
+}
+
+/*
+ * Читает события inotify и отмечает изменившиеся каталоги в *changed
+ * Возвращает количество событий в отслеживаемых каталогах
+ */
+static int read_watch_events(int inotify_fd, const int *watches, int watch_count, unsigned *changed) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int events = 0;
+    for (;;) {
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            return events;
+        }
+        for (char *ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            for (int i = 0; i < watch_count; i++) {
+                if (watches[i] == event->wd) {
+                    *changed |= 1u << i;
+                    events++;
+                }
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+/*
+ * Обслуживает запросы на сокете socket_path до сигнала завершения
+ * Сокет, переданный systemd (LISTEN_FDS), используется вместо создания своего
+ * watch_dirs - список каталогов с завершающим NULL, не более DAEMON_MAX_WATCHES
+ * Возвращает 0 при штатном завершении, -1 при ошибке
+ */
+int daemon_serve(const char *socket_path, const char *const *watch_dirs,
+                 DaemonWatchFunc on_change, DaemonHandler handler, void *user_data) {
+    int created;
+    int listen_fd = listen_socket(socket_path, &created);
+    if (listen_fd < 0) {
+        return -1;
+    }
+
+    // Отсутствующий каталог не мешает работе: он просто не отслеживается
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int watches[DAEMON_MAX_WATCHES];
+    int watch_count = 0;
+    for (; watch_count < DAEMON_MAX_WATCHES && watch_dirs[watch_count] != NULL; watch_count++) {
+        watches[watch_count] = inotify_fd < 0 ? -1 :
+            inotify_add_watch(inotify_fd, watch_dirs[watch_count],
+                              IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE |
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct pollfd fds[2] = {
+        { listen_fd, POLLIN, 0 },
+        { inotify_fd, POLLIN, 0 },
+    };
+    unsigned changed = 0;
+    int64_t last_event_ns = 0;
+    int rc = 0;
+    while (!stop_requested) {
+        // Пока каталоги меняются, обновление данных откладывается; срок
+        // отсчитывается от последнего события inotify, и запросы клиентов
+        // его не сдвигают, иначе при постоянных запросах данные не обновятся
+        int timeout_ms = -1;
+        if (changed != 0) {
+            int64_t remaining_ns = last_event_ns + (int64_t)DAEMON_SETTLE_MS * 1000000 - monotonic_ns();
+            if (remaining_ns <= 0) {
+                on_change(changed, user_data);
+                changed = 0;
+            } else {
+                timeout_ms = (int)((remaining_ns + 999999) / 1000000);
+            }
+        }
+
+        int ready = poll(fds, inotify_fd < 0 ? 1 : 2, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -1;
+            break;
+        }
+        if (inotify_fd >= 0 && (fds[1].revents & POLLIN) &&
+            read_watch_events(inotify_fd, watches, watch_count, &changed) > 0) {
+            last_event_ns = monotonic_ns();
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (client >= 0) {
+                serve_client(client, handler, user_data);
+                close(client);
+            }
+        }
+    }
+
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    close(listen_fd);
+    if (created) {
+        unlink(socket_path);
+    }
+    return rc;
+}
+
+/*
+ * Отправляет запрос программе, запущенной с --daemon, и пересылает
+ * выводимый текст в out
+ * Возвращает 0 при успехе (заполнены exit_code и exec_name),
+ * -1 если программа недоступна и ответ еще не начат
+ */
+int daemon_query(const char *socket_path, const DaemonRequest *request, FILE *out,
+                 int *exit_code, char *exec_name, size_t exec_size) {
+    int fd = connect_socket(socket_path);
+    if (fd < 0) {
+        return -1;
+    }
+    set_timeouts(fd, DAEMON_CLIENT_TIMEOUT_MS);
+
+    const char *fields[] = { DAEMON_PROTOCOL, request->command, request->path_env, request->locale };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (write_all(fd, fields[i], strlen(fields[i]) + 1) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    shutdown(fd, SHUT_WR);
+
+    // Первая строка ответа: код и действие
+    char buf[MAX_CMD_LEN + 32];
+    size_t len = 0;
+    char *newline = NULL;
+    while (newline == NULL) {
+        if (len == sizeof(buf)) {
+            close(fd);
+            return -1;
+        }
+        ssize_t got = read(fd, buf + len, sizeof(buf) - len);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            close(fd);
+            return -1;
+        }
+        len += (size_t)got;
+        newline = memchr(buf, '\n', len);
+    }
+    *newline = '\0';
+
+    char *action;
+    long code = strtol(buf, &action, 10);
+    exec_name[0] = '\0';
+    if (strncmp(action, " exec ", 6) == 0 && action[6] != '\0') {
+        snprintf(exec_name, exec_size, "%s", action + 6);
+    } else if (strcmp(action, " print") != 0) {
+        close(fd);
+        return -1;
+    }
+    *exit_code = (int)code;
+
+    // Остаток - текст для пользователя
+    char *rest = newline + 1;
+    fwrite(rest, 1, len - (size_t)(rest - buf), out);
+    for (;;) {
+        ssize_t got = read(fd, buf, sizeof(buf));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        fwrite(buf, 1, (size_t)got, out);
+    }
+    fflush(out);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef CNF_DAEMON_H
+#define CNF_DAEMON_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Протокол между оболочкой и резидентной программой
+ * Запрос: "CNF1\0<команда>\0<PATH>\0<локаль>\0", затем клиент закрывает запись
+ * Ответ: первая строка "<код> print\n" или "<код> exec <команда>\n",
+ * далее текст для вывода пользователю до закрытия соединения
+ */
+#define DAEMON_PROTOCOL "CNF1"
+#define DAEMON_SOCKET_NAME "command-not-found.socket"
+#define DAEMON_MAX_REQUEST 65536
+#define DAEMON_MAX_WATCHES 8
+
+/* Запрос клиента; строки указывают в буфер запроса */
+typedef struct {
+    const char *command;   // Ненайденная команда
+    const char *path_env;  // PATH оболочки
+    const char *locale;    // Локаль сообщений оболочки (пустая - локаль программы)
+} DaemonRequest;
+
+/*
+ * Обрабатывает запрос: пишет сообщения в out и возвращает код завершения;
+ * если клиент должен выполнить команду, ее имя записывается в exec_name,
+ * иначе exec_name остается пустой строкой
+ */
+typedef int (*DaemonHandler)(const DaemonRequest *request, FILE *out,
+                             char *exec_name, size_t exec_size, void *user_data);
+
+/*
+ * Сообщает об изменении отслеживаемых каталогов; бит i в changed
+ * соответствует watch_dirs[i]
+ * Вызывается, когда изменения в каталогах прекратились
+ */
+typedef void (*DaemonWatchFunc)(unsigned changed, void *user_data);
+
+/*
+ * Формирует путь к сокету в $XDG_RUNTIME_DIR
+ * Возвращает 0 при успехе, -1 если каталог не задан или путь слишком длинный
+ */
+int daemon_socket_path(char *buf, size_t size);
+
+/*
+ * Обслуживает запросы на сокете socket_path до сигнала завершения
+ * Сокет, переданный systemd (LISTEN_FDS), используется вместо создания своего
+ * watch_dirs - список каталогов с завершающим NULL, не более DAEMON_MAX_WATCHES
+ * Возвращает 0 при штатном завершении, -1 при ошибке
+ */
+int daemon_serve(const char *socket_path, const char *const *watch_dirs,
+                 DaemonWatchFunc on_change, DaemonHandler handler, void *user_data);
+
+/*
+ * Отправляет запрос программе, запущенной с --daemon, и пересылает
+ * выводимый текст в out
+ * Возвращает 0 при успехе (заполнены exit_code и exec_name),
+ * -1 если программа недоступна и ответ еще не начат
+ */
+int daemon_query(const char *socket_path, const DaemonRequest *request, FILE *out,
+                 int *exit_code, char *exec_name, size_t exec_size);
+
+#endif /* CNF_DAEMON_H */
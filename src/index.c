@@ -0,0 +1,1704 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "pkglist.h"
+#include "stats.h"
+#include "util.h"
+
+/* Сколько раз index_open пробует открыть сегменты, прежде чем признать индекс устаревшим */
+#define INDEX_OPEN_ATTEMPTS 3
+
+/* Сколько раз по миллисекунде index_open ждет окончания публикации сегментов */
+#define INDEX_PUBLISH_WAITS 100
+
+/* Проверяет, что раздел [offset, offset + size) лежит внутри файла */
+static int section_fits(const IndexSegment *segment, uint64_t offset, uint64_t size) {
+    return offset <= segment->size && size <= segment->size - offset;
+}
+
+/*
+ * Отображает файл сегмента с рекомендацией advice для madvise и проверяет заголовок
+ * Возвращает 0 при успехе, -1 если сегмент отсутствует или поврежден
+ */
+static int segment_map(IndexSegment *segment, const char *path, int advice) {
+    memset(segment, 0, sizeof(*segment));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    // Рекомендация действует уже на чтение заголовка
+    madvise(map, st.st_size, advice);
+    segment->map = map;
+    segment->size = st.st_size;
+    segment->header = (const IndexHeader *)map;
+
+    // Проверяем заголовок, границы и выравнивание разделов
+    const IndexHeader *header = segment->header;
+    uint32_t block_count = (uint32_t)(((uint64_t)header->entry_count + INDEX_BLOCK_ENTRIES - 1) / INDEX_BLOCK_ENTRIES);
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != INDEX_VERSION ||
+        header->source_count != 1 ||
+        header->block_count != block_count ||
+        !section_fits(segment, header->blocks_offset, (uint64_t)header->block_count * sizeof(IndexBlock)) ||
+        !section_fits(segment, header->packages_offset, (uint64_t)header->package_count * sizeof(IndexPackage)) ||
+        !section_fits(segment, header->trigrams_offset, (uint64_t)header->trigram_count * sizeof(IndexTrigram)) ||
+        !section_fits(segment, header->keys_offset, header->keys_size) ||
+        !section_fits(segment, header->postings_offset, header->postings_size) ||
+        !section_fits(segment, header->strings_offset, header->strings_size) ||
+        !section_fits(segment, header->data_offset, header->data_size) ||
+        header->blocks_offset % sizeof(uint32_t) != 0 ||
+        header->packages_offset % sizeof(uint32_t) != 0 ||
+        header->trigrams_offset % sizeof(uint32_t) != 0 ||
+        header->strings_size == 0 || header->strings_size > UINT32_MAX ||
+        (header->block_count > 0 && header->keys_size == 0) || header->keys_size > UINT32_MAX ||
+        header->postings_size > UINT32_MAX || header->data_size > UINT32_MAX) {
+        index_segment_close(segment);
+        return -1;
+    }
+
+    const char *base = map;
+    segment->blocks = (const IndexBlock *)(base + header->blocks_offset);
+    segment->packages = (const IndexPackage *)(base + header->packages_offset);
+    segment->trigrams = (const IndexTrigram *)(base + header->trigrams_offset);
+    segment->keys = base + header->keys_offset;
+    segment->postings = (const unsigned char *)base + header->postings_offset;
+    segment->strings = base + header->strings_offset;
+    segment->data = (const unsigned char *)base + header->data_offset;
+    if (segment->strings[header->strings_size - 1] != '\0' ||
+        (header->keys_size > 0 && segment->keys[header->keys_size - 1] != '\0')) {
+        index_segment_close(segment);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Отображает файл сегмента и проверяет заголовок без проверки актуальности
+ * Возвращает 0 при успехе, -1 если сегмент отсутствует или поврежден
+ */
+int index_segment_open(IndexSegment *segment, const char *path) {
+    return segment_map(segment, path, MADV_NORMAL);
+}
+
+/* Освобождает отображение сегмента */
+void index_segment_close(IndexSegment *segment) {
+    if (segment->map != NULL) {
+        munmap(segment->map, segment->size);
+    }
+    memset(segment, 0, sizeof(*segment));
+}
+
+/* Возвращает строку по смещению или NULL, если смещение вне таблицы */
+static const char *segment_string(const IndexSegment *segment, uint32_t offset) {
+    if (offset >= segment->header->strings_size) {
+        return NULL;
+    }
+    return segment->strings + offset;
+}
+
+/* Возвращает первое имя файла блока или NULL, если смещение вне таблицы */
+static const char *segment_key(const IndexSegment *segment, uint32_t block) {
+    uint32_t offset = segment->blocks[block].key;
+    if (offset >= segment->header->keys_size) {
+        return NULL;
+    }
+    return segment->keys + offset;
+}
+
+/*
+ * Сравнивает первое имя блока с name, по возможности только по началу из каталога
+ * Возвращает 0 при успехе, -1 если имя блока вне таблицы
+ */
+static int compare_block_key(const IndexSegment *segment, uint32_t block, const char *name, int *cmp) {
+    const char *prefix = segment->blocks[block].prefix;
+    *cmp = strncmp(prefix, name, sizeof(segment->blocks[block].prefix));
+    if (*cmp != 0 || prefix[sizeof(segment->blocks[block].prefix) - 1] == '\0') {
+        return 0;
+    }
+    const char *key = segment_key(segment, block);
+    if (key == NULL) {
+        return -1;
+    }
+    *cmp = strcmp(key, name);
+    return 0;
+}
+
+/* Хеш FNV-1a для контрольных сумм разделов */
+static uint32_t hash_bytes(const void *data, size_t len, uint32_t hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Последовательное чтение чисел varint и байтов с проверкой границ */
+typedef struct {
+    const unsigned char *pos;
+    const unsigned char *end;
+    int failed;               // Данные закончились или число слишком длинное
+} ByteReader;
+
+/* Читает беззнаковое 32-битное число varint */
+static uint32_t read_varint(ByteReader *reader) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (reader->pos == reader->end) {
+            break;
+        }
+        unsigned char byte = *reader->pos++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    reader->failed = 1;
+    return 0;
+}
+
+/* Возвращает len байт подряд или NULL, если данные закончились */
+static const unsigned char *read_bytes(ByteReader *reader, uint32_t len) {
+    if ((size_t)(reader->end - reader->pos) < len) {
+        reader->failed = 1;
+        return NULL;
+    }
+    const unsigned char *bytes = reader->pos;
+    reader->pos += len;
+    return bytes;
+}
+
+/* Декодер записей одного блока */
+typedef struct {
+    ByteReader reader;
+    uint32_t remaining;       // Записи, которые еще не прочитаны
+    uint32_t package_count;   // Граница номеров пакетов
+    char base[MAX_PATH_LEN];  // Имя файла текущей записи
+    size_t base_len;
+    char dir[MAX_PATH_LEN];   // Каталог текущей записи с завершающим '/'
+    size_t dir_len;
+    uint32_t package;         // Номер пакета текущей записи
+} BlockCursor;
+
+/*
+ * Начинает чтение блока block
+ * Возвращает 0 при успехе, -1 если блок выходит за область данных
+ */
+static int block_cursor_init(const IndexSegment *segment, uint32_t block, BlockCursor *cursor) {
+    const IndexHeader *header = segment->header;
+    uint64_t start = segment->blocks[block].offset;
+    uint64_t end = block + 1 < header->block_count ? segment->blocks[block + 1].offset : header->data_size;
+    if (start > end || end > header->data_size) {
+        return -1;
+    }
+    cursor->reader.pos = segment->data + start;
+    cursor->reader.end = segment->data + end;
+    cursor->reader.failed = 0;
+    cursor->remaining = block + 1 < header->block_count ?
+        INDEX_BLOCK_ENTRIES : header->entry_count - block * INDEX_BLOCK_ENTRIES;
+    cursor->package_count = header->package_count;
+    cursor->base[0] = '\0';
+    cursor->base_len = 0;
+    cursor->dir[0] = '\0';
+    cursor->dir_len = 0;
+    return 0;
+}
+
+/* Читает строку, закодированную общей с предыдущей частью и остатком */
+static int read_front_coded(ByteReader *reader, char *buf, size_t *len) {
+    uint32_t shared = read_varint(reader);
+    uint32_t suffix_len = read_varint(reader);
+    if (reader->failed || shared > *len || (uint64_t)shared + suffix_len >= MAX_PATH_LEN) {
+        return -1;
+    }
+    const unsigned char *suffix = read_bytes(reader, suffix_len);
+    if (suffix == NULL) {
+        return -1;
+    }
+    memcpy(buf + shared, suffix, suffix_len);
+    *len = shared + suffix_len;
+    buf[*len] = '\0';
+    return 0;
+}
+
+/*
+ * Декодирует следующую запись блока
+ * Возвращает 1 если запись прочитана, 0 в конце блока, -1 если блок поврежден
+ */
+static int block_cursor_next(BlockCursor *cursor) {
+    if (cursor->remaining == 0) {
+        return 0;
+    }
+    if (read_front_coded(&cursor->reader, cursor->base, &cursor->base_len) != 0 ||
+        read_front_coded(&cursor->reader, cursor->dir, &cursor->dir_len) != 0) {
+        return -1;
+    }
+    cursor->package = read_varint(&cursor->reader);
+    if (cursor->reader.failed || cursor->package >= cursor->package_count) {
+        return -1;
+    }
+    cursor->remaining--;
+    return 1;
+}
+
+/*
+ * Находит первую запись с именем файла name
+ * Возвращает 1 если запись найдена (она остается в cursor), 0 если нет
+ */
+static int segment_find_entry(const IndexSegment *segment, const char *name, BlockCursor *cursor) {
+    // Двоичный поиск по каталогу блоков: первый блок с первым именем не меньше искомого
+    uint32_t low = 0;
+    uint32_t high = segment->header->block_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int cmp;
+        if (compare_block_key(segment, mid, name, &cmp) != 0) {
+            return 0;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // Первая запись с именем может оказаться в конце предыдущего блока,
+    // поэтому декодируется не больше двух блоков
+    uint32_t block = low > 0 ? low - 1 : 0;
+    for (; block <= low && block < segment->header->block_count; block++) {
+        if (block_cursor_init(segment, block, cursor) != 0) {
+            return 0;
+        }
+        int rc;
+        while ((rc = block_cursor_next(cursor)) > 0) {
+            int cmp = strcmp(cursor->base, name);
+            if (cmp == 0) {
+                return 1;
+            }
+            if (cmp > 0) {
+                return 0;
+            }
+        }
+        if (rc < 0) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Ищет в сегменте пакет, содержащий файл с именем command_name
+ * Возвращает 1 если пакет найден, 0 если нет
+ */
+static int segment_lookup(const IndexSegment *segment, const char *command_name, Arena *arena, PackageInfo *result) {
+    BlockCursor cursor;
+    if (!segment_find_entry(segment, command_name, &cursor)) {
+        return 0;
+    }
+
+    const IndexPackage *package = &segment->packages[cursor.package];
+    const char *name = segment_string(segment, package->name);
+    const char *summary = segment_string(segment, package->summary);
+    if (name == NULL || summary == NULL) {
+        return 0;
+    }
+
+    // Путь хранится частями: собираем его в арене результата
+    size_t path_len = cursor.dir_len + cursor.base_len;
+    char *path = arena_alloc(arena, path_len + 1);
+    if (path == NULL) {
+        return 0;
+    }
+    memcpy(path, cursor.dir, cursor.dir_len);
+    memcpy(path + cursor.dir_len, cursor.base, cursor.base_len + 1);
+    stats_count(STATS_COPIES, 1);
+    stats_count(STATS_BYTES_COPIED, path_len + 1);
+
+    result->package_name = name;
+    result->binary_path = path;
+    result->description = summary;
+    return 1;
+}
+
+/* Упаковывает три байта строки в триграмму */
+static uint32_t pack_trigram(const char *str) {
+    return ((uint32_t)(unsigned char)str[0] << 16) |
+           ((uint32_t)(unsigned char)str[1] << 8) |
+           (uint32_t)(unsigned char)str[2];
+}
+
+/* Находит триграмму двоичным поиском или возвращает NULL */
+static const IndexTrigram *segment_trigram(const IndexSegment *segment, uint32_t trigram) {
+    uint32_t low = 0;
+    uint32_t high = segment->header->trigram_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (segment->trigrams[mid].trigram < trigram) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == segment->header->trigram_count || segment->trigrams[low].trigram != trigram) {
+        return NULL;
+    }
+    return &segment->trigrams[low];
+}
+
+/* Начинает чтение списка пакетов триграммы */
+static void postings_reader(const IndexSegment *segment, const IndexTrigram *trigram, ByteReader *reader) {
+    reader->pos = segment->postings + (trigram->first < segment->header->postings_size ?
+                                       trigram->first : segment->header->postings_size);
+    reader->end = segment->postings + segment->header->postings_size;
+    reader->failed = 0;
+}
+
+/* Проверяет пакет по образцу и передает его колбэку */
+static int segment_offer_package(const IndexSegment *segment, uint32_t id, const char *pattern,
+                                 IndexPackageFunc func, void *user_data) {
+    if (id >= segment->header->package_count) {
+        return 0;
+    }
+    const IndexPackage *package = &segment->packages[id];
+    const char *name = segment_string(segment, package->name);
+    const char *summary = segment_string(segment, package->summary);
+    if (name == NULL || summary == NULL || strstr(name, pattern) == NULL) {
+        return 0;
+    }
+    return func(name, summary, user_data);
+}
+
+/*
+ * Перебирает пакеты сегмента, имя которых содержит подстроку pattern
+ * Кандидаты берутся из списка самой редкой триграммы образца,
+ * короткие образцы проверяются по всей таблице пакетов
+ * Возвращает 1, если колбэк прервал перебор, иначе 0
+ */
+static int segment_find_packages(const IndexSegment *segment, const char *pattern,
+                                 IndexPackageFunc func, void *user_data) {
+    size_t len = strlen(pattern);
+
+    if (len < 3) {
+        for (uint32_t id = 0; id < segment->header->package_count; id++) {
+            if (segment_offer_package(segment, id, pattern, func, user_data)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Любое подходящее имя содержит все триграммы образца,
+    // поэтому достаточно проверить кандидатов из самого короткого списка
+    const IndexTrigram *rarest = NULL;
+    for (size_t i = 0; i + 3 <= len; i++) {
+        const IndexTrigram *trigram = segment_trigram(segment, pack_trigram(pattern + i));
+        if (trigram == NULL) {
+            return 0;
+        }
+        if (rarest == NULL || trigram->count < rarest->count) {
+            rarest = trigram;
+        }
+    }
+
+    // Номера пакетов записаны разностями с предыдущим
+    ByteReader reader;
+    postings_reader(segment, rarest, &reader);
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < rarest->count; i++) {
+        id += read_varint(&reader);
+        if (reader.failed) {
+            return 0;
+        }
+        if (segment_offer_package(segment, id, pattern, func, user_data)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Собирает путь файла сегмента для файла pkglist name в каталоге индекса dir
+ * Возвращает 0 при успехе, -1 если путь слишком длинный
+ */
+static int segment_path(char *buf, size_t size, const char *dir, const char *name) {
+    return snprintf(buf, size, "%s/%s%s", dir, name, INDEX_SEGMENT_SUFFIX) < (int)size ? 0 : -1;
+}
+
+/* Время изменения файла в наносекундах */
+static int64_t stat_mtime(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/* Добавляет байты к хешу FNV-1a 64 */
+static uint64_t hash_bytes64(const void *data, size_t len, uint64_t hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * Проверяет, держит ли перестройка блокировку каталога индекса path
+ * Блокировка только проверяется, читатель никогда ее не ждет
+ */
+static int rebuild_running(const char *path) {
+    char lock_path[MAX_PATH_LEN];
+    if (snprintf(lock_path, sizeof(lock_path), "%s/%s", path, INDEX_LOCK_FILE) >= (int)sizeof(lock_path)) {
+        return 0;
+    }
+    int lock = open(lock_path, O_RDONLY | O_CLOEXEC);
+    if (lock < 0) {
+        return 0;
+    }
+    int busy = flock(lock, LOCK_SH | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    close(lock);
+    return busy;
+}
+
+/*
+ * Проверяет, идет ли обновление индекса в каталоге path: перестройка
+ * держит блокировку, либо index_pin отметил скорое обновление pkglist
+ */
+static int update_in_progress(const char *path) {
+    if (rebuild_running(path)) {
+        return 1;
+    }
+
+    // Отметка без последующей перестройки со временем перестает действовать
+    char file_path[MAX_PATH_LEN];
+    struct stat st;
+    return snprintf(file_path, sizeof(file_path), "%s/%s", path, INDEX_PIN_FILE) < (int)sizeof(file_path) &&
+           stat(file_path, &st) == 0 && st.st_mtime + INDEX_PIN_TIMEOUT > time(NULL);
+}
+
+/*
+ * Читает номер поколения индекса из каталога path: нечетный, пока
+ * перестройка переименовывает новые сегменты на место прежних
+ * Возвращает 0, если индекс еще ни разу не публиковался
+ */
+static uint64_t read_generation(const char *path) {
+    char gen_path[MAX_PATH_LEN];
+    uint64_t generation = 0;
+    if (snprintf(gen_path, sizeof(gen_path), "%s/%s", path, INDEX_GENERATION_FILE) >= (int)sizeof(gen_path)) {
+        return 0;
+    }
+    int fd = open(gen_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    if (read(fd, &generation, sizeof(generation)) != (ssize_t)sizeof(generation)) {
+        generation = 0;
+    }
+    close(fd);
+    return generation;
+}
+
+/*
+ * Одна попытка открыть сегменты индекса
+ * Пока идет обновление индекса, открывается прежнее поколение: устаревшие
+ * сегменты используются как есть, файлы pkglist без сегмента пропускаются
+ * Возвращает 0 при успехе, -1 если какой-то сегмент отсутствует, поврежден или устарел
+ */
+static int index_open_once(CommandIndex *index, const char *path, const char *pkglist_dir) {
+    memset(index, 0, sizeof(*index));
+
+    DIR *dir = opendir(pkglist_dir);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    int capacity = 0;
+    int updating = -1;  // Проверяется только при первом устаревшем сегменте
+    uint64_t stamp = 14695981039346656037ull;
+    int rc = 0;
+    struct dirent *entry;
+    while (rc == 0 && (entry = readdir(dir)) != NULL) {
+        struct stat st;
+        if (!is_pkglist_file(entry->d_name) || fstatat(dirfd(dir), entry->d_name, &st, 0) != 0) {
+            continue;
+        }
+
+        if (index->segment_count == capacity) {
+            int new_capacity = capacity > 0 ? capacity * 2 : 8;
+            IndexSegment *segments = realloc(index->segments, new_capacity * sizeof(IndexSegment));
+            if (segments == NULL) {
+                rc = -1;
+                break;
+            }
+            index->segments = segments;
+            capacity = new_capacity;
+        }
+
+        // Поиск читает несколько страниц в разных местах файла: упреждающее
+        // чтение соседних страниц только заняло бы кеш страниц
+        char seg_path[MAX_PATH_LEN];
+        IndexSegment *segment = &index->segments[index->segment_count];
+        if (segment_path(seg_path, sizeof(seg_path), path, entry->d_name) != 0) {
+            rc = -1;
+            break;
+        }
+        int mapped = segment_map(segment, seg_path, MADV_RANDOM) == 0;
+
+        // Сегмент устарел, если его файл pkglist изменился после построения
+        if (!mapped || segment->header->source_mtime != stat_mtime(&st) ||
+            segment->header->source_size != (uint64_t)st.st_size) {
+            if (updating < 0) {
+                updating = update_in_progress(path);
+            }
+            if (!updating) {
+                if (mapped) {
+                    index_segment_close(segment);
+                }
+                rc = -1;
+                break;
+            }
+            if (!mapped) {
+                continue;
+            }
+        }
+        index->segment_count++;
+        if ((uint64_t)index->entry_count + segment->header->entry_count > UINT32_MAX) {
+            rc = -1;
+            break;
+        }
+        index->entry_count += segment->header->entry_count;
+
+        // Отпечаток берется из заголовков: дерево опечаток прежнего
+        // поколения подходит к нему, пока идет обновление
+        int64_t mtime = segment->header->source_mtime;
+        uint64_t size = segment->header->source_size;
+        stamp = hash_bytes64(entry->d_name, strlen(entry->d_name) + 1, stamp);
+        stamp = hash_bytes64(&mtime, sizeof(mtime), stamp);
+        stamp = hash_bytes64(&size, sizeof(size), stamp);
+    }
+    closedir(dir);
+
+    if (rc != 0) {
+        index_close(index);
+        return -1;
+    }
+    index->source_stamp = (int64_t)(stamp & INT64_MAX);
+    return 0;
+}
+
+/*
+ * Открывает сегменты индекса из каталога path для всех файлов pkglist из pkglist_dir
+ * Сегменты идут в порядке обхода каталога pkglist, как при сканировании
+ * Возвращает 0 при успехе, -1 если какой-то сегмент отсутствует, поврежден или устарел
+ */
+int index_open(CommandIndex *index, const char *path, const char *pkglist_dir) {
+    // Перестройка может закончиться между чтением устаревшего сегмента и
+    // проверкой блокировки: тогда новая попытка застает новые сегменты
+    int waits = 0;
+    for (int attempt = 0; attempt < INDEX_OPEN_ATTEMPTS; attempt++) {
+        // Новые сегменты переименовываются на место прежних подряд, без
+        // долгой работы между ними: короткое ожидание дешевле сканирования.
+        // Нечетный номер без блокировки остался от прерванной перестройки
+        uint64_t generation = read_generation(path);
+        if ((generation & 1) && waits < INDEX_PUBLISH_WAITS && rebuild_running(path)) {
+            struct timespec pause = { 0, 1000000 };
+            nanosleep(&pause, NULL);
+            waits++;
+            attempt--;
+            continue;
+        }
+        if (index_open_once(index, path, pkglist_dir) == 0) {
+            // Сегменты одного поколения: во время открытия ничего не переименовано
+            if (read_generation(path) == generation) {
+                return 0;
+            }
+            index_close(index);
+        }
+    }
+    return -1;
+}
+
+/* Освобождает отображения всех сегментов */
+void index_close(CommandIndex *index) {
+    for (int i = 0; i < index->segment_count; i++) {
+        index_segment_close(&index->segments[i]);
+    }
+    free(index->segments);
+    memset(index, 0, sizeof(*index));
+}
+
+/*
+ * Ищет пакет, содержащий файл с именем command_name
+ * Сегменты просматриваются в порядке обхода pkglist: побеждает первый
+ * файл pkglist с таким именем, как при сканировании
+ * Имя и описание пакета указывают в отображение индекса и действительны
+ * до index_close, путь собирается в arena
+ * Возвращает 1 если пакет найден, 0 если нет
+ */
+int index_lookup(const CommandIndex *index, const char *command_name, Arena *arena, PackageInfo *result) {
+    for (int i = 0; i < index->segment_count; i++) {
+        if (segment_lookup(&index->segments[i], command_name, arena, result)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Перебирает пакеты, имя которых содержит подстроку pattern
+ * Пакеты перебираются по сегментам, внутри сегмента - в порядке имени;
+ * пакет из нескольких файлов pkglist передается колбэку несколько раз
+ */
+void index_find_packages(const CommandIndex *index, const char *pattern,
+                         IndexPackageFunc func, void *user_data) {
+    for (int i = 0; i < index->segment_count; i++) {
+        if (segment_find_packages(&index->segments[i], pattern, func, user_data)) {
+            return;
+        }
+    }
+}
+
+/* Положение перебора записей в одном сегменте */
+typedef struct {
+    const IndexSegment *segment;
+    uint32_t block;           // Блок, который читает cursor
+    int valid;                // В cursor есть непрочитанная колбэком запись
+    BlockCursor cursor;
+} SegmentCursor;
+
+/*
+ * Переходит к следующей записи сегмента
+ * Возвращает 0 при успехе (valid == 0 в конце сегмента), -1 если блок поврежден
+ */
+static int segment_cursor_next(SegmentCursor *position) {
+    const IndexSegment *segment = position->segment;
+    for (;;) {
+        int rc = block_cursor_next(&position->cursor);
+        if (rc > 0) {
+            position->valid = 1;
+            return 0;
+        }
+        if (rc < 0) {
+            return -1;
+        }
+        if (++position->block >= segment->header->block_count) {
+            position->valid = 0;
+            return 0;
+        }
+        if (block_cursor_init(segment, position->block, &position->cursor) != 0) {
+            return -1;
+        }
+    }
+}
+
+/*
+ * Перебирает записи всех сегментов в порядке имени файла
+ * При равных именах записи идут в порядке сегментов, то есть в порядке
+ * обхода pkglist, как в индексе, построенном одним файлом
+ * Возвращает 0 после полного или прерванного перебора, -1 если блок поврежден
+ */
+int index_foreach_entry(const CommandIndex *index, IndexEntryFunc func, void *user_data) {
+    if (index->segment_count == 0) {
+        return 0;
+    }
+    SegmentCursor *positions = malloc(index->segment_count * sizeof(SegmentCursor));
+    if (positions == NULL) {
+        return -1;
+    }
+
+    int rc = 0;
+    for (int i = 0; i < index->segment_count && rc == 0; i++) {
+        positions[i].segment = &index->segments[i];
+        positions[i].block = 0;
+        positions[i].valid = 0;
+        if (positions[i].segment->header->block_count > 0) {
+            rc = block_cursor_init(positions[i].segment, 0, &positions[i].cursor) != 0 ||
+                 segment_cursor_next(&positions[i]) != 0 ? -1 : 0;
+        }
+    }
+
+    // Сегментов немного: наименьшее имя выбирается простым просмотром
+    while (rc == 0) {
+        SegmentCursor *next = NULL;
+        for (int i = 0; i < index->segment_count; i++) {
+            if (positions[i].valid &&
+                (next == NULL || strcmp(positions[i].cursor.base, next->cursor.base) < 0)) {
+                next = &positions[i];
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        const char *package = segment_string(next->segment, next->segment->packages[next->cursor.package].name);
+        if (package == NULL) {
+            rc = -1;
+            break;
+        }
+        if (func(next->cursor.dir, next->cursor.base, package, user_data)) {
+            break;
+        }
+        rc = segment_cursor_next(next);
+    }
+
+    free(positions);
+    return rc;
+}
+
+/* Отмечает нарушение формата; сохраняет описание первого */
+static void report_error(IndexReport *report, const char *message) {
+    if (report->errors++ == 0) {
+        report->first_error = message;
+    }
+}
+
+/* Проверяет блоки записей: декодирование, границы и порядок имен */
+static void verify_blocks(const IndexSegment *segment, IndexReport *report) {
+    char previous[MAX_PATH_LEN];
+    BlockCursor cursor;
+    uint32_t decoded = 0;
+    previous[0] = '\0';
+
+    for (uint32_t block = 0; block < segment->header->block_count; block++) {
+        if (block_cursor_init(segment, block, &cursor) != 0) {
+            report_error(report, "block outside of the data section");
+            continue;
+        }
+        uint64_t block_size = cursor.reader.end - cursor.reader.pos;
+        if (block_size > report->max_block_size) {
+            report->max_block_size = (uint32_t)block_size;
+        }
+        if (hash_bytes(cursor.reader.pos, block_size, 2166136261u) != segment->blocks[block].checksum) {
+            report_error(report, "block checksum mismatch");
+        }
+
+        const char *key = segment_key(segment, block);
+        uint32_t expected = cursor.remaining;
+        int rc;
+        while ((rc = block_cursor_next(&cursor)) > 0) {
+            if (strlen(cursor.base) != cursor.base_len || strlen(cursor.dir) != cursor.dir_len) {
+                report_error(report, "entry name contains a zero byte");
+            }
+            if (cursor.remaining + 1 == expected &&
+                (key == NULL || strcmp(key, cursor.base) != 0 ||
+                 strncmp(segment->blocks[block].prefix, cursor.base, sizeof(segment->blocks[block].prefix)) != 0)) {
+                report_error(report, "block key differs from its first entry");
+            }
+            if (decoded > 0 && strcmp(previous, cursor.base) > 0) {
+                report_error(report, "entries are not sorted by file name");
+            }
+            memcpy(previous, cursor.base, cursor.base_len + 1);
+            report->paths_size += cursor.dir_len + cursor.base_len + 1;
+            decoded++;
+        }
+        if (rc < 0) {
+            report_error(report, "block cannot be decoded");
+        } else if (cursor.reader.pos != cursor.reader.end) {
+            report_error(report, "block has trailing bytes");
+        }
+    }
+
+    if (decoded != segment->header->entry_count) {
+        report_error(report, "entry count differs from the header");
+    }
+}
+
+/* Проверяет таблицу пакетов и списки триграмм */
+static void verify_packages(const IndexSegment *segment, IndexReport *report) {
+    const IndexHeader *header = segment->header;
+    const char *previous = NULL;
+    for (uint32_t id = 0; id < header->package_count; id++) {
+        const char *name = segment_string(segment, segment->packages[id].name);
+        if (name == NULL || segment_string(segment, segment->packages[id].summary) == NULL) {
+            report_error(report, "package string outside of the string table");
+            previous = NULL;
+            continue;
+        }
+        if (previous != NULL && strcmp(previous, name) >= 0) {
+            report_error(report, "packages are not sorted by name");
+        }
+        previous = name;
+    }
+
+    uint64_t postings_end = 0;
+    for (uint32_t i = 0; i < header->trigram_count; i++) {
+        const IndexTrigram *trigram = &segment->trigrams[i];
+        if (i > 0 && segment->trigrams[i - 1].trigram >= trigram->trigram) {
+            report_error(report, "trigrams are not sorted");
+        }
+        if (trigram->first > header->postings_size) {
+            report_error(report, "trigram list outside of the postings section");
+            continue;
+        }
+
+        char text[4] = { (char)(trigram->trigram >> 16), (char)(trigram->trigram >> 8), (char)trigram->trigram, '\0' };
+        ByteReader reader;
+        postings_reader(segment, trigram, &reader);
+        uint32_t id = 0;
+        for (uint32_t j = 0; j < trigram->count; j++) {
+            uint32_t delta = read_varint(&reader);
+            if (reader.failed || (j > 0 && delta == 0) || (uint64_t)id + delta >= header->package_count) {
+                report_error(report, "trigram list is not an ascending list of packages");
+                break;
+            }
+            id += delta;
+            const char *name = segment_string(segment, segment->packages[id].name);
+            if (name == NULL || strstr(name, text) == NULL) {
+                report_error(report, "trigram list names a package without the trigram");
+            }
+        }
+        uint64_t end = reader.pos - segment->postings;
+        if (end > postings_end) {
+            postings_end = end;
+        }
+    }
+    if (postings_end != header->postings_size) {
+        report_error(report, "postings section has unused bytes");
+    }
+}
+
+/*
+ * Декодирует все блоки и таблицы и проверяет порядок записей, номера
+ * пакетов и списки триграмм; заполняет report
+ * Возвращает 0 если нарушений нет, -1 если они найдены
+ */
+int index_segment_verify(const IndexSegment *segment, IndexReport *report) {
+    const IndexHeader *header = segment->header;
+    memset(report, 0, sizeof(*report));
+    report->directory_size = header->block_count * sizeof(IndexBlock) + header->keys_size;
+    report->packages_size = header->package_count * sizeof(IndexPackage);
+    report->trigrams_size = header->trigram_count * sizeof(IndexTrigram) + header->postings_size;
+    report->strings_size = header->strings_size;
+    report->data_size = header->data_size;
+
+    // Таблицы лежат подряд от каталога блоков до начала блоков записей
+    if (header->data_offset < header->blocks_offset ||
+        hash_bytes((const char *)segment->map + header->blocks_offset, header->data_offset - header->blocks_offset,
+                   2166136261u) != header->tables_checksum) {
+        report_error(report, "table checksum mismatch");
+    }
+    verify_blocks(segment, report);
+    verify_packages(segment, report);
+    return report->errors == 0 ? 0 : -1;
+}
+
+/* Растущий буфер байтов раздела */
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} ByteBuffer;
+
+/*
+ * Добавляет len байт в буфер и записывает их смещение в offset
+ * Возвращает 0 при успехе, -1 при нехватке памяти или переполнении смещения
+ */
+static int buffer_append(ByteBuffer *buffer, const void *bytes, size_t len, uint32_t *offset) {
+    if (buffer->len + len > UINT32_MAX) {
+        return -1;
+    }
+    if (buffer->len + len > buffer->cap) {
+        size_t cap = buffer->cap ? buffer->cap * 2 : 1 << 16;
+        while (cap < buffer->len + len) {
+            cap *= 2;
+        }
+        unsigned char *data = realloc(buffer->data, cap);
+        if (data == NULL) {
+            return -1;
+        }
+        buffer->data = data;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, bytes, len);
+    if (offset != NULL) {
+        *offset = (uint32_t)buffer->len;
+    }
+    buffer->len += len;
+    return 0;
+}
+
+/* Добавляет число varint */
+static int buffer_append_varint(ByteBuffer *buffer, uint32_t value) {
+    unsigned char bytes[5];
+    size_t len = 0;
+    while (value >= 0x80) {
+        bytes[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (unsigned char)value;
+    return buffer_append(buffer, bytes, len, NULL);
+}
+
+/* Добавляет строку общей с предыдущей длиной и остатком */
+static int buffer_append_front_coded(ByteBuffer *buffer, const char *previous, size_t previous_len,
+                                     const char *str, size_t len) {
+    size_t shared = 0;
+    while (shared < previous_len && shared < len && previous[shared] == str[shared]) {
+        shared++;
+    }
+    if (buffer_append_varint(buffer, (uint32_t)shared) != 0 ||
+        buffer_append_varint(buffer, (uint32_t)(len - shared)) != 0) {
+        return -1;
+    }
+    return buffer_append(buffer, str + shared, len - shared, NULL);
+}
+
+/* Запись построителя: смещения в таблицах путей и строк */
+typedef struct {
+    uint32_t path;     // Полный путь к файлу в таблице путей
+    uint32_t base;     // Имя файла (указывает внутрь пути)
+    uint32_t package;  // Имя пакета, после сборки пакетов - номер пакета
+    uint32_t summary;  // Описание пакета
+} BuilderEntry;
+
+/* Состояние построителя индекса */
+typedef struct {
+    ByteBuffer paths;       // Пути записей, только на время построения
+    ByteBuffer strings;     // Имена и описания пакетов без повторов
+    uint32_t *dedup;        // Хеш-таблица смещений строк (смещение + 1, 0 - пусто)
+    size_t dedup_cap;
+    size_t dedup_used;
+    BuilderEntry *entries;  // Записи в порядке обхода
+    size_t entry_count;
+    size_t entry_cap;
+    IndexPackage *packages; // Различные пакеты
+    size_t package_count;
+    IndexTrigram *trigrams; // Триграммы имен пакетов
+    size_t trigram_count;
+    ByteBuffer postings;    // Списки номеров пакетов для триграмм
+    IndexBlock *blocks;     // Каталог блоков
+    size_t block_count;
+    ByteBuffer keys;        // Первые имена файлов блоков
+    ByteBuffer data;        // Блоки записей
+    int failed;             // Признак нехватки памяти или переполнения
+} IndexBuilder;
+
+/* Хеш FNV-1a */
+static uint32_t hash_string(const char *str) {
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Добавляет строку с дедупликацией (имена пакетов и описания повторяются) */
+static int builder_intern(IndexBuilder *builder, const char *str, uint32_t *offset) {
+    const char *strings = (const char *)builder->strings.data;
+    if (builder->dedup_used * 2 >= builder->dedup_cap) {
+        size_t cap = builder->dedup_cap ? builder->dedup_cap * 2 : 4096;
+        uint32_t *dedup = calloc(cap, sizeof(uint32_t));
+        if (dedup == NULL) {
+            return -1;
+        }
+        // Переносим старые значения в новую таблицу
+        for (size_t i = 0; i < builder->dedup_cap; i++) {
+            uint32_t slot = builder->dedup[i];
+            if (slot == 0) {
+                continue;
+            }
+            size_t pos = hash_string(strings + slot - 1) & (cap - 1);
+            while (dedup[pos] != 0) {
+                pos = (pos + 1) & (cap - 1);
+            }
+            dedup[pos] = slot;
+        }
+        free(builder->dedup);
+        builder->dedup = dedup;
+        builder->dedup_cap = cap;
+    }
+
+    size_t pos = hash_string(str) & (builder->dedup_cap - 1);
+    while (builder->dedup[pos] != 0) {
+        uint32_t existing = builder->dedup[pos] - 1;
+        if (strcmp(strings + existing, str) == 0) {
+            *offset = existing;
+            return 0;
+        }
+        pos = (pos + 1) & (builder->dedup_cap - 1);
+    }
+
+    if (buffer_append(&builder->strings, str, strlen(str) + 1, offset) != 0 || *offset == UINT32_MAX) {
+        return -1;
+    }
+    builder->dedup[pos] = *offset + 1;
+    builder->dedup_used++;
+    return 0;
+}
+
+/* Колбэк обхода pkglist: добавляет строку в индекс */
+static int builder_add_row(const PkglistRow *row, void *user_data) {
+    IndexBuilder *builder = user_data;
+
+    if (builder->entry_count == builder->entry_cap) {
+        size_t cap = builder->entry_cap ? builder->entry_cap * 2 : 65536;
+        BuilderEntry *entries = realloc(builder->entries, cap * sizeof(BuilderEntry));
+        if (entries == NULL) {
+            builder->failed = 1;
+            return 1;
+        }
+        builder->entries = entries;
+        builder->entry_cap = cap;
+    }
+
+    char path[MAX_PATH_LEN];
+    pkglist_row_path(row, path, sizeof(path));
+    const char *slash = strrchr(path, '/');
+
+    BuilderEntry *entry = &builder->entries[builder->entry_count];
+    if (buffer_append(&builder->paths, path, strlen(path) + 1, &entry->path) != 0 ||
+        builder_intern(builder, row->package, &entry->package) != 0 ||
+        builder_intern(builder, row->summary, &entry->summary) != 0) {
+        builder->failed = 1;
+        return 1;
+    }
+    entry->base = entry->path + (uint32_t)(slash != NULL ? slash + 1 - path : 0);
+    builder->entry_count++;
+    return 0;
+}
+
+/* Таблица строк для функции сравнения qsort */
+static const char *sort_strings;
+
+/*
+ * Сравнивает записи по имени файла, затем по порядку обхода
+ * Пути добавляются последовательно, поэтому смещение пути задает порядок обхода
+ */
+static int compare_index_entry(const void *a, const void *b) {
+    const BuilderEntry *entry_a = a;
+    const BuilderEntry *entry_b = b;
+
+    int cmp = strcmp(sort_strings + entry_a->base, sort_strings + entry_b->base);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (entry_a->path > entry_b->path) - (entry_a->path < entry_b->path);
+}
+
+/* Сравнивает пакеты по имени */
+static int compare_index_package(const void *a, const void *b) {
+    const IndexPackage *package_a = a;
+    const IndexPackage *package_b = b;
+    return strcmp(sort_strings + package_a->name, sort_strings + package_b->name);
+}
+
+/* Сравнивает пары (триграмма, номер пакета) */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t value_a = *(const uint64_t *)a;
+    uint64_t value_b = *(const uint64_t *)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/*
+ * Находит ячейку пакета с именем по смещению name в хеш-таблице
+ * slots (номер пакета + 1, 0 - пусто); возвращает найденную или пустую ячейку
+ */
+static size_t package_slot(const IndexBuilder *builder, const uint32_t *slots, size_t slot_count, uint32_t name) {
+    size_t pos = (name * 2654435761u) & (slot_count - 1);
+    while (slots[pos] != 0 && builder->packages[slots[pos] - 1].name != name) {
+        pos = (pos + 1) & (slot_count - 1);
+    }
+    return pos;
+}
+
+/*
+ * Собирает таблицу различных пакетов по записям в порядке обхода
+ * и заменяет имена пакетов записей номерами в отсортированной таблице
+ * Имена пакетов хранятся без повторов, поэтому пакет определяется смещением имени,
+ * описание берется у первой записи пакета
+ */
+static int builder_collect_packages(IndexBuilder *builder) {
+    size_t slot_count = 4096;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        return -1;
+    }
+
+    size_t package_cap = 0;
+    for (size_t i = 0; i < builder->entry_count; i++) {
+        const BuilderEntry *entry = &builder->entries[i];
+
+        if (builder->package_count * 2 >= slot_count) {
+            size_t new_count = slot_count * 2;
+            uint32_t *grown = calloc(new_count, sizeof(uint32_t));
+            if (grown == NULL) {
+                free(slots);
+                return -1;
+            }
+            for (size_t j = 0; j < builder->package_count; j++) {
+                grown[package_slot(builder, grown, new_count, builder->packages[j].name)] = (uint32_t)j + 1;
+            }
+            free(slots);
+            slots = grown;
+            slot_count = new_count;
+        }
+
+        size_t pos = package_slot(builder, slots, slot_count, entry->package);
+        if (slots[pos] != 0) {
+            continue;
+        }
+
+        if (builder->package_count == package_cap) {
+            size_t cap = package_cap ? package_cap * 2 : 4096;
+            IndexPackage *packages = realloc(builder->packages, cap * sizeof(IndexPackage));
+            if (packages == NULL) {
+                free(slots);
+                return -1;
+            }
+            builder->packages = packages;
+            package_cap = cap;
+        }
+        IndexPackage *package = &builder->packages[builder->package_count++];
+        package->name = entry->package;
+        package->summary = entry->summary;
+        slots[pos] = (uint32_t)builder->package_count;
+    }
+
+    if (builder->package_count > 1) {
+        sort_strings = (const char *)builder->strings.data;
+        qsort(builder->packages, builder->package_count, sizeof(IndexPackage), compare_index_package);
+        sort_strings = NULL;
+    }
+
+    // После сортировки номера пакетов изменились: заполняем таблицу заново
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+    for (size_t i = 0; i < builder->package_count; i++) {
+        slots[package_slot(builder, slots, slot_count, builder->packages[i].name)] = (uint32_t)i + 1;
+    }
+    for (size_t i = 0; i < builder->entry_count; i++) {
+        BuilderEntry *entry = &builder->entries[i];
+        entry->package = slots[package_slot(builder, slots, slot_count, entry->package)] - 1;
+    }
+
+    free(slots);
+    return 0;
+}
+
+/* Строит списки пакетов для каждой триграммы имени */
+static int builder_collect_trigrams(IndexBuilder *builder) {
+    const char *strings = (const char *)builder->strings.data;
+
+    // Пары (триграмма << 32 | номер пакета); после сортировки списки идут подряд
+    size_t pair_count = 0;
+    for (size_t i = 0; i < builder->package_count; i++) {
+        size_t len = strlen(strings + builder->packages[i].name);
+        pair_count += len >= 3 ? len - 2 : 0;
+    }
+    if (pair_count == 0) {
+        return 0;
+    }
+
+    uint64_t *pairs = malloc(pair_count * sizeof(uint64_t));
+    builder->trigrams = malloc(pair_count * sizeof(IndexTrigram));
+    if (pairs == NULL || builder->trigrams == NULL) {
+        free(pairs);
+        return -1;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < builder->package_count; i++) {
+        const char *name = strings + builder->packages[i].name;
+        for (size_t j = 0; name[j] && name[j + 1] && name[j + 2]; j++) {
+            pairs[used++] = ((uint64_t)pack_trigram(name + j) << 32) | i;
+        }
+    }
+    qsort(pairs, used, sizeof(uint64_t), compare_u64);
+
+    int rc = 0;
+    uint32_t previous = 0;
+    for (size_t i = 0; i < used && rc == 0; i++) {
+        // Триграмма может встретиться в одном имени несколько раз
+        if (i > 0 && pairs[i] == pairs[i - 1]) {
+            continue;
+        }
+        uint32_t trigram = (uint32_t)(pairs[i] >> 32);
+        uint32_t id = (uint32_t)pairs[i];
+        if (builder->trigram_count == 0 || builder->trigrams[builder->trigram_count - 1].trigram != trigram) {
+            IndexTrigram *entry = &builder->trigrams[builder->trigram_count++];
+            entry->trigram = trigram;
+            entry->first = (uint32_t)builder->postings.len;
+            entry->count = 0;
+            previous = 0;
+        }
+        // Номера в списке возрастают: записываем разность с предыдущим
+        rc = buffer_append_varint(&builder->postings, id - previous);
+        previous = id;
+        builder->trigrams[builder->trigram_count - 1].count++;
+    }
+
+    free(pairs);
+    return rc;
+}
+
+/*
+ * Кодирует отсортированные записи блоками по INDEX_BLOCK_ENTRIES
+ * Имя файла и каталог записи хранятся общей с предыдущей записью
+ * частью и остатком, первая запись блока - целиком
+ */
+static int builder_encode_blocks(IndexBuilder *builder) {
+    builder->block_count = (builder->entry_count + INDEX_BLOCK_ENTRIES - 1) / INDEX_BLOCK_ENTRIES;
+    builder->blocks = malloc((builder->block_count + 1) * sizeof(IndexBlock));
+    if (builder->blocks == NULL) {
+        return -1;
+    }
+
+    const char *paths = (const char *)builder->paths.data;
+    const char *previous_base = "";
+    size_t previous_base_len = 0;
+    const char *previous_dir = "";
+    size_t previous_dir_len = 0;
+    for (size_t i = 0; i < builder->entry_count; i++) {
+        const BuilderEntry *entry = &builder->entries[i];
+        const char *base = paths + entry->base;
+        const char *dir = paths + entry->path;
+        size_t base_len = strlen(base);
+        size_t dir_len = entry->base - entry->path;
+
+        if (i % INDEX_BLOCK_ENTRIES == 0) {
+            IndexBlock *block = &builder->blocks[i / INDEX_BLOCK_ENTRIES];
+            if (buffer_append(&builder->keys, base, base_len + 1, &block->key) != 0) {
+                return -1;
+            }
+            block->offset = (uint32_t)builder->data.len;
+            memset(block->prefix, 0, sizeof(block->prefix));
+            memcpy(block->prefix, base, base_len < sizeof(block->prefix) ? base_len : sizeof(block->prefix));
+            previous_base_len = 0;
+            previous_dir_len = 0;
+        }
+
+        if (buffer_append_front_coded(&builder->data, previous_base, previous_base_len, base, base_len) != 0 ||
+            buffer_append_front_coded(&builder->data, previous_dir, previous_dir_len, dir, dir_len) != 0 ||
+            buffer_append_varint(&builder->data, entry->package) != 0) {
+            return -1;
+        }
+        previous_base = base;
+        previous_base_len = base_len;
+        previous_dir = dir;
+        previous_dir_len = dir_len;
+    }
+
+    for (size_t i = 0; i < builder->block_count; i++) {
+        size_t end = i + 1 < builder->block_count ? builder->blocks[i + 1].offset : builder->data.len;
+        builder->blocks[i].checksum = hash_bytes(builder->data.data + builder->blocks[i].offset,
+                                                 end - builder->blocks[i].offset, 2166136261u);
+    }
+    return 0;
+}
+
+/*
+ * Записывает сегмент во временный файл tmp_path и сохраняет его на диск;
+ * на место сегмента его переименовывает publish_segments
+ */
+static int builder_write(IndexBuilder *builder, const char *tmp_path,
+                         int64_t source_mtime, uint64_t source_size) {
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Таблицы фиксированного размера идут первыми и остаются выровненными
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.entry_count = (uint32_t)builder->entry_count;
+    header.block_count = (uint32_t)builder->block_count;
+    header.package_count = (uint32_t)builder->package_count;
+    header.trigram_count = (uint32_t)builder->trigram_count;
+    header.blocks_offset = sizeof(IndexHeader);
+    header.packages_offset = header.blocks_offset + builder->block_count * sizeof(IndexBlock);
+    header.trigrams_offset = header.packages_offset + builder->package_count * sizeof(IndexPackage);
+    header.keys_offset = header.trigrams_offset + builder->trigram_count * sizeof(IndexTrigram);
+    header.keys_size = builder->keys.len;
+    header.postings_offset = header.keys_offset + header.keys_size;
+    header.postings_size = builder->postings.len;
+    header.strings_offset = header.postings_offset + header.postings_size;
+    header.strings_size = builder->strings.len;
+    header.data_offset = header.strings_offset + header.strings_size;
+    header.data_size = builder->data.len;
+    header.source_mtime = source_mtime;
+    header.source_size = source_size;
+    header.source_count = 1;
+
+    // Контрольная сумма таблиц в порядке записи в файл
+    uint32_t checksum = 2166136261u;
+    checksum = hash_bytes(builder->blocks, builder->block_count * sizeof(IndexBlock), checksum);
+    checksum = hash_bytes(builder->packages, builder->package_count * sizeof(IndexPackage), checksum);
+    checksum = hash_bytes(builder->trigrams, builder->trigram_count * sizeof(IndexTrigram), checksum);
+    checksum = hash_bytes(builder->keys.data, builder->keys.len, checksum);
+    checksum = hash_bytes(builder->postings.data, builder->postings.len, checksum);
+    checksum = hash_bytes(builder->strings.data, builder->strings.len, checksum);
+    header.tables_checksum = checksum;
+
+    int rc = 0;
+    if (write_all(fd, &header, sizeof(header)) != 0 ||
+        write_all(fd, builder->blocks, builder->block_count * sizeof(IndexBlock)) != 0 ||
+        write_all(fd, builder->packages, builder->package_count * sizeof(IndexPackage)) != 0 ||
+        write_all(fd, builder->trigrams, builder->trigram_count * sizeof(IndexTrigram)) != 0 ||
+        write_all(fd, builder->keys.data, builder->keys.len) != 0 ||
+        write_all(fd, builder->postings.data, builder->postings.len) != 0 ||
+        write_all(fd, builder->strings.data, builder->strings.len) != 0 ||
+        write_all(fd, builder->data.data, builder->data.len) != 0) {
+        rc = -1;
+    }
+    // Данные попадают на диск до переименования: после сбоя на месте
+    // сегмента оказывается прежний файл или новый целиком
+    if (rc == 0 && fsync(fd) != 0) {
+        rc = -1;
+    }
+    if (close(fd) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(tmp_path);
+    }
+    return rc;
+}
+
+/*
+ * Строит сегмент по одному файлу pkglist во временный файл tmp_path
+ * st - состояние файла до чтения: если файл изменится во время
+ * построения, сегмент окажется устаревшим, а не потерянным
+ * Возвращает количество записей или -1 при ошибке
+ */
+static long segment_build(const char *tmp_path, const char *pkglist_path, const struct stat *st) {
+    IndexBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+
+    // Пустая строка по смещению 0 гарантирует непустую таблицу строк
+    uint32_t empty;
+    if (buffer_append(&builder.strings, "", 1, &empty) != 0) {
+        builder.failed = 1;
+    }
+    if (!builder.failed) {
+        pkglist_scan_file(pkglist_path, builder_add_row, &builder);
+    }
+
+    long result = -1;
+    // Таблицу пакетов собираем до сортировки, пока записи идут в порядке обхода
+    if (!builder.failed && builder.entry_count <= UINT32_MAX &&
+        builder_collect_packages(&builder) == 0 && builder_collect_trigrams(&builder) == 0) {
+        if (builder.entry_count > 1) {
+            sort_strings = (const char *)builder.paths.data;
+            qsort(builder.entries, builder.entry_count, sizeof(BuilderEntry), compare_index_entry);
+            sort_strings = NULL;
+        }
+
+        if (builder_encode_blocks(&builder) == 0 &&
+            builder_write(&builder, tmp_path, stat_mtime(st), (uint64_t)st->st_size) == 0) {
+            result = (long)builder.entry_count;
+        }
+    }
+
+    free(builder.paths.data);
+    free(builder.strings.data);
+    free(builder.dedup);
+    free(builder.entries);
+    free(builder.packages);
+    free(builder.trigrams);
+    free(builder.postings.data);
+    free(builder.blocks);
+    free(builder.keys.data);
+    free(builder.data.data);
+    return result;
+}
+
+/*
+ * Проверяет, что name - временный файл сегмента (<сегмент>.tmp.<pid>),
+ * процесс которого уже завершился, не успев его переименовать или удалить
+ */
+static int is_stale_temp_segment(const char *name) {
+    const char *tmp = strstr(name, INDEX_SEGMENT_SUFFIX ".tmp.");
+    if (tmp == NULL) {
+        return 0;
+    }
+    const char *digits = tmp + strlen(INDEX_SEGMENT_SUFFIX ".tmp.");
+    char *end;
+    long pid = strtol(digits, &end, 10);
+    if (end == digits || *end != '\0' || pid <= 0) {
+        return 0;
+    }
+    return kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+}
+
+/*
+ * Удаляет сегменты, для которых в pkglist_dir больше нет файла pkglist,
+ * и временные файлы перестроек, прерванных вместе с процессом
+ * Вызывается под rebuild.lock: живые перестройки в это время не пишут
+ */
+static void remove_orphan_segments(const char *path, const char *pkglist_dir) {
+    DIR *dir = opendir(path);
+    DIR *sources = opendir(pkglist_dir);
+    if (dir == NULL || sources == NULL) {
+        if (dir != NULL) {
+            closedir(dir);
+        }
+        if (sources != NULL) {
+            closedir(sources);
+        }
+        return;
+    }
+    size_t suffix_len = strlen(INDEX_SEGMENT_SUFFIX);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (is_stale_temp_segment(entry->d_name)) {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+            continue;
+        }
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, INDEX_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        char name[MAX_PATH_LEN];
+        snprintf(name, sizeof(name), "%.*s", (int)(len - suffix_len), entry->d_name);
+        if (!is_pkglist_file(name) || faccessat(dirfd(sources), name, F_OK, 0) != 0) {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(sources);
+    closedir(dir);
+}
+
+/* Путь к временному файлу сегмента seg_path, который строит этот процесс */
+static int segment_tmp_path(char *buf, size_t size, const char *seg_path) {
+    return snprintf(buf, size, "%s.tmp.%ld", seg_path, (long)getpid()) < (int)size ? 0 : -1;
+}
+
+/*
+ * Записывает номер поколения индекса в каталог path
+ * Файл заменяется переименованием, читатель видит прежний номер или новый
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+static int write_generation(const char *path, uint64_t generation) {
+    char gen_path[MAX_PATH_LEN];
+    char tmp_path[MAX_PATH_LEN];
+    if (snprintf(gen_path, sizeof(gen_path), "%s/%s", path, INDEX_GENERATION_FILE) >= (int)sizeof(gen_path) ||
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", gen_path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = write_all(fd, &generation, sizeof(generation));
+    if (close(fd) != 0 || rc != 0 || rename(tmp_path, gen_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Публикует построенные сегменты файлов pkglist names одной пачкой
+ * На время переименований номер поколения нечетный: читатель, открывший
+ * сегменты в это время, видит смесь поколений и открывает их заново
+ * Сегменты удаленных файлов pkglist удаляются в той же пачке
+ * Возвращает 0 при успехе, -1 если какой-то сегмент не удалось переименовать
+ */
+static int publish_segments(const char *path, const char *pkglist_dir, char **names, int count) {
+    uint64_t generation = (read_generation(path) + 1) | 1;
+    int rc = write_generation(path, generation);
+    for (int i = 0; i < count; i++) {
+        char seg_path[MAX_PATH_LEN];
+        char tmp_path[MAX_PATH_LEN];
+        if (segment_path(seg_path, sizeof(seg_path), path, names[i]) != 0 ||
+            segment_tmp_path(tmp_path, sizeof(tmp_path), seg_path) != 0) {
+            rc = -1;
+            continue;
+        }
+        if (rename(tmp_path, seg_path) != 0) {
+            unlink(tmp_path);
+            rc = -1;
+        }
+    }
+    remove_orphan_segments(path, pkglist_dir);
+    if (write_generation(path, generation + 1) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+/*
+ * Создает каталог индекса path; индекс прежних версий был одним файлом,
+ * и на его месте создается каталог
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+static int make_index_dir(const char *path) {
+    struct stat st;
+    if (lstat(path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+        unlink(path);
+    }
+    char dir_buf[MAX_PATH_LEN];
+    snprintf(dir_buf, sizeof(dir_buf), "%s", path);
+    mkdir(dirname(dir_buf), 0755);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Отмечает, что файлы pkglist сейчас изменятся (apt-get update): до
+ * следующей перестройки, но не дольше INDEX_PIN_TIMEOUT секунд,
+ * index_open открывает уже опубликованное поколение сегментов
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+int index_pin(const char *path) {
+    char pin_path[MAX_PATH_LEN];
+    if (make_index_dir(path) != 0 ||
+        snprintf(pin_path, sizeof(pin_path), "%s/%s", path, INDEX_PIN_FILE) >= (int)sizeof(pin_path)) {
+        return -1;
+    }
+    // O_TRUNC обновляет время изменения и у существующей отметки
+    int fd = open(pin_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    return close(fd);
+}
+
+/*
+ * Обновляет сегменты индекса в каталоге path по файлам pkglist из pkglist_dir
+ * Сегмент перестраивается, только если его файл pkglist изменился
+ * (имя, размер или время изменения); сегменты удаленных файлов удаляются
+ * Новые сегменты сначала строятся и записываются на диск целиком, затем
+ * все сразу публикуются атомарными переименованиями и больше не меняются:
+ * читатели, отобразившие прежний сегмент, продолжают работать с ним
+ * В rebuilt (если не NULL) записывается количество перестроенных сегментов
+ * Возвращает общее количество записей или -1 при ошибке
+ */
+long index_rebuild(const char *path, const char *pkglist_dir, int *rebuilt) {
+    if (rebuilt != NULL) {
+        *rebuilt = 0;
+    }
+    char lock_path[MAX_PATH_LEN];
+    char pin_path[MAX_PATH_LEN];
+    if (make_index_dir(path) != 0 ||
+        snprintf(lock_path, sizeof(lock_path), "%s/%s", path, INDEX_LOCK_FILE) >= (int)sizeof(lock_path) ||
+        snprintf(pin_path, sizeof(pin_path), "%s/%s", path, INDEX_PIN_FILE) >= (int)sizeof(pin_path)) {
+        return -1;
+    }
+
+    // Перестройки идут по одной; читатели блокировку не ждут, а только
+    // проверяют, что она занята, и пока открывают прежнее поколение
+    int lock = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock < 0) {
+        return -1;
+    }
+    if (flock(lock, LOCK_EX) != 0) {
+        close(lock);
+        return -1;
+    }
+
+    DIR *dir = opendir(pkglist_dir);
+    if (dir == NULL) {
+        unlink(pin_path);
+        close(lock);
+        return -1;
+    }
+
+    long total = 0;
+    int failed = 0;
+    char **built = NULL;  // Файлы pkglist, сегменты которых ждут публикации
+    int built_count = 0;
+    int built_cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        if (!is_pkglist_file(entry->d_name) || fstatat(dirfd(dir), entry->d_name, &st, 0) != 0) {
+            continue;
+        }
+        char seg_path[MAX_PATH_LEN];
+        char pkglist_path[MAX_PATH_LEN];
+        if (segment_path(seg_path, sizeof(seg_path), path, entry->d_name) != 0) {
+            failed = 1;
+            continue;
+        }
+        snprintf(pkglist_path, sizeof(pkglist_path), "%s/%s", pkglist_dir, entry->d_name);
+
+        // Актуальный сегмент остается как есть
+        IndexSegment segment;
+        if (index_segment_open(&segment, seg_path) == 0) {
+            int fresh = segment.header->source_mtime == stat_mtime(&st) &&
+                        segment.header->source_size == (uint64_t)st.st_size;
+            long entries = segment.header->entry_count;
+            index_segment_close(&segment);
+            if (fresh) {
+                total += entries;
+                continue;
+            }
+        }
+
+        char tmp_path[MAX_PATH_LEN];
+        if (built_count == built_cap) {
+            int new_cap = built_cap ? built_cap * 2 : 16;
+            char **grown = realloc(built, new_cap * sizeof(char *));
+            if (grown == NULL) {
+                failed = 1;
+                continue;
+            }
+            built = grown;
+            built_cap = new_cap;
+        }
+        if (segment_tmp_path(tmp_path, sizeof(tmp_path), seg_path) != 0 ||
+            (built[built_count] = strdup(entry->d_name)) == NULL) {
+            failed = 1;
+            continue;
+        }
+        long entries = segment_build(tmp_path, pkglist_path, &st);
+        if (entries < 0) {
+            free(built[built_count]);
+            failed = 1;
+            continue;
+        }
+        built_count++;
+        total += entries;
+        if (rebuilt != NULL) {
+            (*rebuilt)++;
+        }
+    }
+    closedir(dir);
+
+    if (publish_segments(path, pkglist_dir, built, built_count) != 0) {
+        failed = 1;
+    }
+    for (int i = 0; i < built_count; i++) {
+        free(built[i]);
+    }
+    free(built);
+
+    // Переименования тоже сохраняются на диск до снятия отметки и блокировки
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    unlink(pin_path);
+    close(lock);
+    return failed ? -1 : total;
+}
@@ -0,0 +1,218 @@
+#ifndef CNF_INDEX_H
+#define CNF_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "common.h"
+
+/* Сигнатура и версия формата индекса */
+#define INDEX_MAGIC "CNFINDEX"
+#define INDEX_VERSION 4
+
+/* Суффикс файлов сегментов: сегмент файла pkglist NAME называется NAME.seg */
+#define INDEX_SEGMENT_SUFFIX ".seg"
+
+/* Блокировка перестройки и отметка скорого обновления pkglist в каталоге индекса */
+#define INDEX_LOCK_FILE "rebuild.lock"
+#define INDEX_PIN_FILE "pinned"
+
+/* Номер поколения в каталоге индекса: меняется при каждой публикации сегментов */
+#define INDEX_GENERATION_FILE "generation"
+
+/* Сколько секунд действует отметка index_pin без последующей перестройки */
+#define INDEX_PIN_TIMEOUT (15 * 60)
+
+/* Количество записей в блоке (в последнем блоке может быть меньше) */
+#define INDEX_BLOCK_ENTRIES 64
+
+/*
+ * Индекс - каталог сегментов, по одному на файл pkglist
+ * Сегмент строится по своему файлу pkglist и перестраивается только
+ * при изменении его размера или времени изменения
+ *
+ * Заголовок файла сегмента
+ * Числа хранятся в порядке байт машины: индекс строится локально
+ * Порядок разделов: заголовок, каталог блоков, пакеты, триграммы,
+ * первые имена блоков, списки пакетов триграмм, строки, блоки записей
+ */
+typedef struct {
+    char magic[8];            // Сигнатура INDEX_MAGIC
+    uint32_t version;         // Версия формата
+    uint32_t entry_count;     // Количество записей
+    uint64_t strings_offset;  // Смещение таблицы строк (имена и описания пакетов) от начала файла
+    uint64_t strings_size;    // Размер таблицы строк
+    int64_t source_mtime;     // Время изменения файла pkglist, нс
+    uint32_t source_count;    // Количество файлов pkglist (всегда 1)
+    uint32_t package_count;   // Количество различных пакетов
+    uint64_t packages_offset; // Смещение таблицы пакетов
+    uint64_t trigrams_offset; // Смещение таблицы триграмм
+    uint32_t trigram_count;   // Количество различных триграмм
+    uint32_t block_count;     // Количество блоков записей
+    uint64_t postings_offset; // Смещение списков номеров пакетов для триграмм
+    uint64_t postings_size;   // Размер списков в байтах
+    uint64_t blocks_offset;   // Смещение каталога блоков
+    uint64_t keys_offset;     // Смещение первых имен файлов блоков
+    uint64_t keys_size;       // Их размер
+    uint64_t data_offset;     // Смещение блоков записей
+    uint64_t data_size;       // Их размер
+    uint32_t tables_checksum; // FNV-1a разделов от каталога блоков до начала блоков записей
+    uint32_t reserved;
+    uint64_t source_size;     // Размер файла pkglist
+} IndexHeader;
+
+/*
+ * Блок записей: записи отсортированы по имени файла (при равных именах -
+ * в порядке обхода pkglist) и разбиты на блоки по INDEX_BLOCK_ENTRIES
+ * Каждая запись блока - последовательность чисел varint и байтов:
+ *   общая с предыдущей записью длина имени файла, длина остатка, остаток;
+ *   то же для каталога файла (с завершающим '/');
+ *   номер пакета
+ * У первой записи блока общие длины нулевые, поэтому блок декодируется
+ * независимо от остальных
+ */
+typedef struct {
+    char prefix[8];    // Начало первого имени, дополненное нулями: двоичный поиск
+                       // обращается к таблице первых имен только при равных началах
+    uint32_t key;      // Первое имя файла блока: смещение в таблице первых имен
+    uint32_t offset;   // Начало блока относительно data_offset
+    uint32_t checksum; // FNV-1a байтов блока (проверяется только index_segment_verify)
+} IndexBlock;
+
+/* Пакет индекса: записи отсортированы по имени, строки без повторов */
+typedef struct {
+    uint32_t name;     // Имя пакета
+    uint32_t summary;  // Описание пакета
+} IndexPackage;
+
+/*
+ * Триграмма имен пакетов: три байта подряд, упакованные в число
+ * Записи отсортированы по триграмме; список - возрастающие номера
+ * пакетов, записанные разностями varint
+ */
+typedef struct {
+    uint32_t trigram;  // (c0 << 16) | (c1 << 8) | c2
+    uint32_t first;    // Начало списка в байтах от postings_offset
+    uint32_t count;    // Длина списка
+} IndexTrigram;
+
+/* Отображенный в память сегмент индекса */
+typedef struct {
+    void *map;                  // Начало отображения
+    size_t size;                // Размер отображения
+    const IndexHeader *header;  // Заголовок
+    const IndexBlock *blocks;   // Каталог блоков
+    const IndexPackage *packages;  // Пакеты по имени
+    const IndexTrigram *trigrams;  // Триграммы имен пакетов
+    const char *keys;           // Первые имена файлов блоков
+    const unsigned char *postings; // Списки пакетов для триграмм
+    const char *strings;        // Таблица строк
+    const unsigned char *data;  // Блоки записей
+} IndexSegment;
+
+/* Открытый индекс: сегменты в порядке обхода каталога pkglist */
+typedef struct {
+    IndexSegment *segments;
+    int segment_count;
+    uint32_t entry_count;       // Записей во всех сегментах
+    int64_t source_stamp;       // Неотрицательный хеш имен, размеров и времен изменения файлов pkglist
+} CommandIndex;
+
+/* Размеры разделов и результат проверки сегмента */
+typedef struct {
+    uint64_t directory_size;  // Каталог блоков и первые имена
+    uint64_t packages_size;   // Таблица пакетов
+    uint64_t trigrams_size;   // Таблица триграмм и списки пакетов
+    uint64_t strings_size;    // Имена и описания пакетов
+    uint64_t data_size;       // Блоки записей
+    uint64_t paths_size;      // Полные пути записей без сжатия
+    uint32_t max_block_size;  // Наибольший блок в байтах
+    uint32_t errors;          // Количество найденных нарушений формата
+    const char *first_error;  // Описание первого нарушения (NULL - нарушений нет)
+} IndexReport;
+
+/*
+ * Колбэк перебора пакетов индекса
+ * Ненулевое возвращаемое значение прерывает перебор.
+ */
+typedef int (*IndexPackageFunc)(const char *name, const char *summary, void *user_data);
+
+/*
+ * Колбэк перебора записей индекса
+ * dirname - каталог с завершающим '/', строки действительны только до возврата
+ * Ненулевое возвращаемое значение прерывает перебор.
+ */
+typedef int (*IndexEntryFunc)(const char *dirname, const char *basename, const char *package, void *user_data);
+
+/*
+ * Отображает файл сегмента и проверяет заголовок без проверки актуальности
+ * Возвращает 0 при успехе, -1 если сегмент отсутствует или поврежден
+ */
+int index_segment_open(IndexSegment *segment, const char *path);
+
+/* Освобождает отображение сегмента */
+void index_segment_close(IndexSegment *segment);
+
+/*
+ * Декодирует все блоки и таблицы сегмента, сверяет контрольные суммы и
+ * проверяет порядок записей, номера пакетов и списки триграмм; заполняет report
+ * Возвращает 0 если нарушений нет, -1 если они найдены
+ */
+int index_segment_verify(const IndexSegment *segment, IndexReport *report);
+
+/*
+ * Открывает сегменты индекса из каталога path для всех файлов pkglist из pkglist_dir
+ * Пока идет перестройка или действует index_pin, открывается прежнее
+ * поколение: устаревшие сегменты используются, файлы без сегмента пропускаются
+ * Открытые сегменты не меняются до index_close, даже если их заменила перестройка
+ * Возвращает 0 при успехе, -1 если какой-то сегмент отсутствует, поврежден или устарел
+ */
+int index_open(CommandIndex *index, const char *path, const char *pkglist_dir);
+
+/* Освобождает отображения всех сегментов */
+void index_close(CommandIndex *index);
+
+/*
+ * Ищет пакет, содержащий файл с именем command_name; при совпадении
+ * в нескольких сегментах побеждает первый файл pkglist, как при сканировании
+ * Имя и описание пакета указывают в отображение индекса и действительны
+ * до index_close, путь собирается в arena
+ * Возвращает 1 если пакет найден, 0 если нет
+ */
+int index_lookup(const CommandIndex *index, const char *command_name, Arena *arena, PackageInfo *result);
+
+/*
+ * Перебирает пакеты, имя которых содержит подстроку pattern
+ * Пакеты перебираются по сегментам, внутри сегмента - в порядке имени;
+ * пакет из нескольких файлов pkglist передается колбэку несколько раз
+ */
+void index_find_packages(const CommandIndex *index, const char *pattern,
+                         IndexPackageFunc func, void *user_data);
+
+/*
+ * Перебирает записи всех сегментов в порядке имени файла
+ * (при равных именах - в порядке обхода pkglist)
+ * Возвращает 0 после полного или прерванного перебора, -1 если блок поврежден
+ */
+int index_foreach_entry(const CommandIndex *index, IndexEntryFunc func, void *user_data);
+
+/*
+ * Отмечает, что файлы pkglist сейчас изменятся (apt-get update): до
+ * следующей перестройки, но не дольше INDEX_PIN_TIMEOUT секунд,
+ * index_open открывает уже опубликованное поколение сегментов
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+int index_pin(const char *path);
+
+/*
+ * Обновляет сегменты индекса в каталоге path по файлам pkglist из pkglist_dir:
+ * перестраивает сегменты измененных файлов и удаляет сегменты удаленных
+ * Сегмент записывается на диск и публикуется атомарным переименованием;
+ * одновременные перестройки выполняются по очереди
+ * В rebuilt (если не NULL) записывается количество перестроенных сегментов
+ * Возвращает общее количество записей или -1 при ошибке
+ */
+long index_rebuild(const char *path, const char *pkglist_dir, int *rebuilt);
+
+#endif /* CNF_INDEX_H */
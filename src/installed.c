@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common.h"
+#include "installed.h"
+#include "stats.h"
+#include "util.h"
+
+/* Сигнатура файла кеша списка установленных пакетов */
+#define INSTALLED_CACHE_MAGIC "CNF-INSTALLED 1"
+
+/* Функция сравнения указателей на имена для qsort */
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/*
+ * Разбивает буфер на строки и строит отсортированный набор без повторов
+ * Буфер переходит во владение набора
+ */
+static int set_from_buffer(InstalledSet *set, char *buffer) {
+    size_t lines = 0;
+    for (const char *ptr = buffer; *ptr; ptr++) {
+        if (*ptr == '\n') {
+            lines++;
+        }
+    }
+
+    const char **names = malloc((lines + 1) * sizeof(*names));
+    if (names == NULL) {
+        free(buffer);
+        return -1;
+    }
+
+    size_t count = 0;
+    char *line = buffer;
+    while (*line) {
+        char *end = strchr(line, '\n');
+        if (end != NULL) {
+            *end = '\0';
+        }
+        if (*line) {
+            names[count++] = line;
+        }
+        if (end == NULL) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    // Несколько версий одного пакета дают повторяющиеся имена
+    qsort(names, count, sizeof(*names), compare_names);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || strcmp(names[unique - 1], names[i]) != 0) {
+            names[unique++] = names[i];
+        }
+    }
+
+    set->buffer = buffer;
+    set->names = names;
+    set->count = unique;
+    return 0;
+}
+
+/* Загружает набор из текстового файла со списком имен */
+static int load_list(InstalledSet *set, const char *source) {
+    char *buffer = read_file(source, NULL);
+    if (buffer == NULL) {
+        return -1;
+    }
+    return set_from_buffer(set, buffer);
+}
+
+/*
+ * Читает кеш списка, если он построен для текущего состояния той же базы rpm
+ * Кеш: строка-сигнатура со временем изменения и каталогом базы, затем имена
+ * по одному в строке
+ */
+static int load_rpm_cache(InstalledSet *set, const char *cache_path, const char *rpmdb_dir,
+                          int64_t rpmdb_mtime) {
+    char *buffer = read_file(cache_path, NULL);
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    char expected[MAX_PATH_LEN + 64];
+    snprintf(expected, sizeof(expected), INSTALLED_CACHE_MAGIC " %" PRId64 " %s\n", rpmdb_mtime, rpmdb_dir);
+    size_t header_len = strlen(expected);
+    if (strncmp(buffer, expected, header_len) != 0) {
+        free(buffer);
+        return -1;
+    }
+
+    // Сдвигаем имена в начало буфера, чтобы он целиком принадлежал набору
+    memmove(buffer, buffer + header_len, strlen(buffer + header_len) + 1);
+    return set_from_buffer(set, buffer);
+}
+
+/* Сохраняет отсортированный набор в кеш */
+static void save_rpm_cache(const InstalledSet *set, const char *cache_path, const char *rpmdb_dir,
+                           int64_t rpmdb_mtime) {
+    size_t size = strlen(rpmdb_dir) + 64;
+    for (size_t i = 0; i < set->count; i++) {
+        size += strlen(set->names[i]) + 1;
+    }
+
+    char *data = malloc(size);
+    if (data == NULL) {
+        return;
+    }
+
+    size_t len = snprintf(data, size, INSTALLED_CACHE_MAGIC " %" PRId64 " %s\n", rpmdb_mtime, rpmdb_dir);
+    for (size_t i = 0; i < set->count; i++) {
+        size_t name_len = strlen(set->names[i]);
+        memcpy(data + len, set->names[i], name_len);
+        data[len + name_len] = '\n';
+        len += name_len + 1;
+    }
+
+    write_file_atomic(cache_path, data, len);
+    free(data);
+}
+
+/*
+ * Загружает набор одним вызовом rpm -qa с кешированием по времени изменения базы
+ * Опрашивается та же база source, по которой проверяется кеш
+ */
+static int load_rpm(InstalledSet *set, const char *source) {
+    char cmd[MAX_CMD_LEN];
+    int needed = snprintf(cmd, sizeof(cmd), "rpm --dbpath \"%s\" -qa --qf '%%{NAME}\\n' 2>/dev/null", source);
+    if (needed >= (int)sizeof(cmd)) {
+        return -1;
+    }
+
+    int64_t rpmdb_mtime = dir_tree_mtime_ns(source);
+    char cache_path[MAX_PATH_LEN];
+    int have_cache = rpmdb_mtime >= 0 &&
+                     user_cache_path("installed", cache_path, sizeof(cache_path)) == 0;
+
+    if (have_cache && load_rpm_cache(set, cache_path, source, rpmdb_mtime) == 0) {
+        return 0;
+    }
+
+    FILE *fp = popen(cmd, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    stats_count(STATS_SUBPROCESSES, 1);
+
+    size_t len = 0;
+    size_t cap = 64 * 1024;
+    char *buffer = malloc(cap);
+    size_t got;
+    while (buffer != NULL && (got = fread(buffer + len, 1, cap - len - 1, fp)) > 0) {
+        len += got;
+        if (cap - len - 1 == 0) {
+            char *grown = realloc(buffer, cap * 2);
+            if (grown == NULL) {
+                free(buffer);
+                buffer = NULL;
+                break;
+            }
+            buffer = grown;
+            cap *= 2;
+        }
+    }
+    int status = pclose(fp);
+    stats_count(STATS_BYTES_READ, len);
+
+    if (buffer == NULL) {
+        return -1;
+    }
+    if (status != 0) {
+        free(buffer);
+        return -1;
+    }
+    buffer[len] = '\0';
+    if (set_from_buffer(set, buffer) != 0) {
+        return -1;
+    }
+
+    if (have_cache) {
+        save_rpm_cache(set, cache_path, source, rpmdb_mtime);
+    }
+    return 0;
+}
+
+const InstalledBackend installed_backend_rpm = { "rpm", load_rpm };
+const InstalledBackend installed_backend_list = { "list", load_list };
+
+/*
+ * Загружает набор через выбранный источник
+ * При ошибке набор остается пустым
+ */
+int installed_set_load(InstalledSet *set, const InstalledBackend *backend, const char *source) {
+    memset(set, 0, sizeof(*set));
+    if (backend->load(set, source) != 0) {
+        memset(set, 0, sizeof(*set));
+        return -1;
+    }
+    return 0;
+}
+
+/* Проверяет наличие пакета в наборе двоичным поиском */
+int installed_set_contains(const InstalledSet *set, const char *package_name) {
+    if (set->count == 0) {
+        return 0;
+    }
+    return bsearch(&package_name, set->names, set->count, sizeof(*set->names), compare_names) != NULL;
+}
+
+/* Освобождает набор */
+void installed_set_free(InstalledSet *set) {
+    free(set->buffer);
+    free(set->names);
+    memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,49 @@
+#ifndef CNF_INSTALLED_H
+#define CNF_INSTALLED_H
+
+#include <stddef.h>
+
+/* Каталог базы данных rpm */
+#ifndef RPMDB_DIR
+#define RPMDB_DIR "/var/lib/rpm"
+#endif
+
+/* Отсортированный набор имен установленных пакетов */
+typedef struct {
+    char *buffer;        // Имена, разделенные нулями
+    const char **names;  // Отсортированные указатели на имена
+    size_t count;        // Количество имен
+} InstalledSet;
+
+/*
+ * Источник сведений об установленных пакетах
+ * load заполняет набор по source и возвращает 0 при успехе, -1 при ошибке
+ */
+typedef struct {
+    const char *name;
+    int (*load)(InstalledSet *set, const char *source);
+} InstalledBackend;
+
+/*
+ * База rpm: один вызов rpm -qa на все проверки
+ * Список кешируется в каталоге пользователя и обновляется при изменении базы
+ * source - каталог базы rpm
+ */
+extern const InstalledBackend installed_backend_rpm;
+
+/* Текстовый файл со списком имен пакетов по одному в строке; source - путь к файлу */
+extern const InstalledBackend installed_backend_list;
+
+/*
+ * Загружает набор через выбранный источник
+ * При ошибке набор остается пустым
+ */
+int installed_set_load(InstalledSet *set, const InstalledBackend *backend, const char *source);
+
+/* Проверяет наличие пакета в наборе двоичным поиском */
+int installed_set_contains(const InstalledSet *set, const char *package_name);
+
+/* Освобождает набор */
+void installed_set_free(InstalledSet *set);
+
+#endif /* CNF_INSTALLED_H */
@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "layout.h"
+
+/* Позиция символа в таблице раскладки */
+#define K(code_point) [(code_point) - LAYOUT_CYRILLIC_FIRST]
+
+/* Клавиши, одинаковые во всех поддерживаемых раскладках ЙЦУКЕН */
+#define COMMON_KEYS \
+    K(0x0430) = 'f', K(0x0431) = ',', K(0x0432) = 'd', K(0x0433) = 'u',  /* а б в г */ \
+    K(0x0434) = 'l', K(0x0435) = 't', K(0x0436) = ';', K(0x0437) = 'p',  /* д е ж з */ \
+    K(0x0439) = 'q', K(0x043A) = 'r', K(0x043B) = 'k', K(0x043C) = 'v',  /* й к л м */ \
+    K(0x043D) = 'y', K(0x043E) = 'j', K(0x043F) = 'g', K(0x0440) = 'h',  /* н о п р */ \
+    K(0x0441) = 'c', K(0x0442) = 'n', K(0x0443) = 'e', K(0x0444) = 'a',  /* с т у ф */ \
+    K(0x0445) = '[', K(0x0446) = 'w', K(0x0447) = 'x', K(0x0448) = 'i',  /* х ц ч ш */ \
+    K(0x044C) = 'm', K(0x044E) = '.', K(0x044F) = 'z',                   /* ь ю я */ \
+    /* Заглавные буквы */ \
+    K(0x0410) = 'F', K(0x0411) = '<', K(0x0412) = 'D', K(0x0413) = 'U',  /* А Б В Г */ \
+    K(0x0414) = 'L', K(0x0415) = 'T', K(0x0416) = ':', K(0x0417) = 'P',  /* Д Е Ж З */ \
+    K(0x0419) = 'Q', K(0x041A) = 'R', K(0x041B) = 'K', K(0x041C) = 'V',  /* Й К Л М */ \
+    K(0x041D) = 'Y', K(0x041E) = 'J', K(0x041F) = 'G', K(0x0420) = 'H',  /* Н О П Р */ \
+    K(0x0421) = 'C', K(0x0422) = 'N', K(0x0423) = 'E', K(0x0424) = 'A',  /* С Т У Ф */ \
+    K(0x0425) = '{', K(0x0426) = 'W', K(0x0427) = 'X', K(0x0428) = 'I',  /* Х Ц Ч Ш */ \
+    K(0x042C) = 'M', K(0x042E) = '>', K(0x042F) = 'Z'                    /* Ь Ю Я */
+
+/* Русская раскладка */
+static const unsigned char keys_ru[LAYOUT_CYRILLIC_SIZE] = {
+    COMMON_KEYS,
+    K(0x0438) = 'b', K(0x0449) = 'o', K(0x044A) = ']', K(0x044B) = 's',  /* и щ ъ ы */
+    K(0x044D) = '\'', K(0x0451) = '`',                                   /* э ё */
+    K(0x0418) = 'B', K(0x0429) = 'O', K(0x042A) = '}', K(0x042B) = 'S',  /* И Щ Ъ Ы */
+    K(0x042D) = '"', K(0x0401) = '~',                                    /* Э Ё */
+};
+
+/* Украинская раскладка */
+static const unsigned char keys_uk[LAYOUT_CYRILLIC_SIZE] = {
+    COMMON_KEYS,
+    K(0x0438) = 'b', K(0x0449) = 'o', K(0x0457) = ']', K(0x0456) = 's',  /* и щ ї і */
+    K(0x0454) = '\'', K(0x0491) = '\\',                                  /* є ґ */
+    K(0x0418) = 'B', K(0x0429) = 'O', K(0x0407) = '}', K(0x0406) = 'S',  /* И Щ Ї І */
+    K(0x0404) = '"', K(0x0490) = '|',                                    /* Є Ґ */
+};
+
+/* Белорусская раскладка */
+static const unsigned char keys_be[LAYOUT_CYRILLIC_SIZE] = {
+    COMMON_KEYS,
+    K(0x0456) = 'b', K(0x045E) = 'o', K(0x044B) = 's',                   /* і ў ы */
+    K(0x044D) = '\'', K(0x0451) = '`',                                   /* э ё */
+    K(0x0406) = 'B', K(0x040E) = 'O', K(0x042B) = 'S',                   /* І Ў Ы */
+    K(0x042D) = '"', K(0x0401) = '~',                                    /* Э Ё */
+};
+
+/* Казахская раскладка: русская с казахскими буквами в ряду цифр */
+static const unsigned char keys_kk[LAYOUT_CYRILLIC_SIZE] = {
+    COMMON_KEYS,
+    K(0x0438) = 'b', K(0x0449) = 'o', K(0x044A) = ']', K(0x044B) = 's',  /* и щ ъ ы */
+    K(0x044D) = '\'', K(0x0451) = '`',                                   /* э ё */
+    K(0x0418) = 'B', K(0x0429) = 'O', K(0x042A) = '}', K(0x042B) = 'S',  /* И Щ Ъ Ы */
+    K(0x042D) = '"', K(0x0401) = '~',                                    /* Э Ё */
+    K(0x04D9) = '2', K(0x0456) = '3', K(0x04A3) = '4', K(0x0493) = '5',  /* ә і ң ғ */
+    K(0x04AF) = '8', K(0x04B1) = '9', K(0x049B) = '0', K(0x04E9) = '-',  /* ү ұ қ ө */
+    K(0x04BB) = '=',                                                     /* һ */
+    K(0x04D8) = '@', K(0x0406) = '#', K(0x04A2) = '$', K(0x0492) = '%',  /* Ә І Ң Ғ */
+    K(0x04AE) = '*', K(0x04B0) = '(', K(0x049A) = ')', K(0x04E8) = '_',  /* Ү Ұ Қ Ө */
+    K(0x04BA) = '+',                                                     /* Һ */
+};
+
+static const KeyboardLayout layout_ru = { "ru", keys_ru };
+static const KeyboardLayout layout_uk = { "uk", keys_uk };
+static const KeyboardLayout layout_be = { "be", keys_be };
+static const KeyboardLayout layout_kk = { "kk", keys_kk };
+
+/* Поддерживаемые раскладки в порядке предпочтения, список завершается NULL */
+const KeyboardLayout *const keyboard_layouts[] = {
+    &layout_ru, &layout_uk, &layout_be, &layout_kk, NULL
+};
+
+/*
+ * Декодирует один символ UTF-8
+ * Возвращает длину символа в байтах; некорректная последовательность
+ * считается одним байтом со значением этого байта
+ */
+int utf8_decode(const char *str, uint32_t *code_point) {
+    const unsigned char *s = (const unsigned char *)str;
+    int len;
+    uint32_t value;
+
+    if (s[0] < 0x80) {
+        *code_point = s[0];
+        return 1;
+    } else if ((s[0] & 0xE0) == 0xC0) {
+        len = 2;
+        value = s[0] & 0x1F;
+    } else if ((s[0] & 0xF0) == 0xE0) {
+        len = 3;
+        value = s[0] & 0x0F;
+    } else if ((s[0] & 0xF8) == 0xF0) {
+        len = 4;
+        value = s[0] & 0x07;
+    } else {
+        *code_point = s[0];
+        return 1;
+    }
+
+    for (int i = 1; i < len; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *code_point = s[0];
+            return 1;
+        }
+        value = (value << 6) | (s[i] & 0x3F);
+    }
+    *code_point = value;
+    return len;
+}
+
+/* Возвращает латинский символ клавиши или 0, если символа нет в раскладке */
+static unsigned char layout_key(const KeyboardLayout *layout, uint32_t code_point) {
+    uint32_t offset = code_point - LAYOUT_CYRILLIC_FIRST;
+    return offset < LAYOUT_CYRILLIC_SIZE ? layout->keys[offset] : 0;
+}
+
+/*
+ * Преобразует строку, набранную в раскладке layout, в латинские символы тех же клавиш
+ * Возвращает 0 при успехе, -1 если в строке есть символ не из этой раскладки
+ */
+int layout_convert(const KeyboardLayout *layout, const char *input, char *output, size_t size) {
+    size_t out = 0;
+
+    for (const char *ptr = input; *ptr; ) {
+        uint32_t code_point;
+        int len = utf8_decode(ptr, &code_point);
+        unsigned char key = code_point < 0x80 ? (unsigned char)code_point : layout_key(layout, code_point);
+        if (key == 0 || out + 1 >= size) {
+            return -1;
+        }
+        output[out++] = (char)key;
+        ptr += len;
+    }
+
+    output[out] = '\0';
+    return 0;
+}
+
+/* Добавляет вариант, если его еще нет среди собранных */
+static int add_candidate(char candidates[][MAX_INPUT_LEN + 1], int *count, const char *candidate) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(candidates[i], candidate) == 0) {
+            return 0;
+        }
+    }
+    strcpy(candidates[(*count)++], candidate);
+    return 1;
+}
+
+/*
+ * Собирает варианты команды, набранной не в той раскладке: сначала
+ * преобразования целиком в каждой раскладке, затем смешанные строки,
+ * где разные символы взяты из разных раскладок
+ * Варианты не повторяются и отличаются от исходной строки
+ * Возвращает количество вариантов (0, если преобразовывать нечего)
+ */
+int layout_candidates(const char *input, char candidates[][MAX_INPUT_LEN + 1], int max_candidates) {
+    // Для каждого символа - различные клавиши во всех раскладках
+    enum { MAX_LAYOUTS = 8 };
+    unsigned char options[MAX_INPUT_LEN][MAX_LAYOUTS];
+    int option_count[MAX_INPUT_LEN];
+    int length = 0;
+    int converted = 0;
+
+    for (const char *ptr = input; *ptr; ) {
+        uint32_t code_point;
+        int len = utf8_decode(ptr, &code_point);
+        ptr += len;
+        if (length == MAX_INPUT_LEN) {
+            return 0;
+        }
+
+        option_count[length] = 0;
+        if (code_point < 0x80) {
+            options[length][option_count[length]++] = (unsigned char)code_point;
+        } else {
+            for (int l = 0; l < MAX_LAYOUTS && keyboard_layouts[l] != NULL; l++) {
+                unsigned char key = layout_key(keyboard_layouts[l], code_point);
+                if (key != 0 && memchr(options[length], key, option_count[length]) == NULL) {
+                    options[length][option_count[length]++] = key;
+                }
+            }
+            // Символ не набирается ни в одной раскладке: это не ошибка раскладки
+            if (option_count[length] == 0) {
+                return 0;
+            }
+            converted = 1;
+        }
+        length++;
+    }
+    if (!converted) {
+        return 0;
+    }
+
+    int count = 0;
+    char buffer[MAX_INPUT_LEN + 1];
+
+    // Строка целиком в одной раскладке - самый вероятный случай
+    for (int l = 0; keyboard_layouts[l] != NULL && count < max_candidates; l++) {
+        if (layout_convert(keyboard_layouts[l], input, buffer, sizeof(buffer)) == 0) {
+            add_candidate(candidates, &count, buffer);
+        }
+    }
+
+    // Смешанные варианты перебираем как счетчик по выбору клавиши для каждого символа
+    int choice[MAX_INPUT_LEN] = {0};
+    while (count < max_candidates) {
+        for (int i = 0; i < length; i++) {
+            buffer[i] = (char)options[i][choice[i]];
+        }
+        buffer[length] = '\0';
+        add_candidate(candidates, &count, buffer);
+
+        int pos = length - 1;
+        while (pos >= 0 && ++choice[pos] == option_count[pos]) {
+            choice[pos--] = 0;
+        }
+        if (pos < 0) {
+            break;
+        }
+    }
+
+    return count;
+}
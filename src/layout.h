@@ -0,0 +1,50 @@
+#ifndef CNF_LAYOUT_H
+#define CNF_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* Наибольшее число вариантов преобразования одной команды */
+#define LAYOUT_MAX_CANDIDATES 8
+
+/* Кириллический блок Unicode, по которому индексируются таблицы раскладок */
+#define LAYOUT_CYRILLIC_FIRST 0x0400
+#define LAYOUT_CYRILLIC_SIZE  0x100
+
+/*
+ * Раскладка клавиатуры: для каждого символа кириллического блока -
+ * латинский символ той же клавиши, 0 если символа в раскладке нет
+ */
+typedef struct {
+    const char *name;                                // Название раскладки
+    const unsigned char *keys;                       // Таблица по коду символа
+} KeyboardLayout;
+
+/* Поддерживаемые раскладки в порядке предпочтения, список завершается NULL */
+extern const KeyboardLayout *const keyboard_layouts[];
+
+/*
+ * Декодирует один символ UTF-8
+ * Возвращает длину символа в байтах; некорректная последовательность
+ * считается одним байтом со значением этого байта
+ */
+int utf8_decode(const char *str, uint32_t *code_point);
+
+/*
+ * Преобразует строку, набранную в раскладке layout, в латинские символы тех же клавиш
+ * Возвращает 0 при успехе, -1 если в строке есть символ не из этой раскладки
+ */
+int layout_convert(const KeyboardLayout *layout, const char *input, char *output, size_t size);
+
+/*
+ * Собирает варианты команды, набранной не в той раскладке: сначала
+ * преобразования целиком в каждой раскладке, затем смешанные строки,
+ * где разные символы взяты из разных раскладок
+ * Варианты не повторяются и отличаются от исходной строки
+ * Возвращает количество вариантов (0, если преобразовывать нечего)
+ */
+int layout_candidates(const char *input, char candidates[][MAX_INPUT_LEN + 1], int max_candidates);
+
+#endif /* CNF_LAYOUT_H */
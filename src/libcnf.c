@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+
+#include "cnf.h"
+#include "common.h"
+#include "lookup.h"
+
+/* Параметры поиска, читаются из окружения при первом вызове */
+static LookupOptions options;
+static int initialized = 0;
+
+/* Читает окружение и подключает переводы при первом вызове */
+static void ensure_initialized(void) {
+    if (!initialized) {
+        bindtextdomain(GETTEXT_PACKAGE, "/usr/share/locale/");
+        lookup_init(&options);
+        initialized = 1;
+    }
+}
+
+/* Задает PATH для проверок, если его передала оболочка */
+static void use_path(const char *path_env) {
+    ensure_initialized();
+    if (path_env != NULL) {
+        lookup_set_path(path_env);
+    }
+}
+
+int cnf_api_version(void) {
+    return CNF_API_VERSION;
+}
+
+void cnf_prepare(const char *path_env) {
+    use_path(path_env);
+    lookup_prepare();
+}
+
+int cnf_quick_lookup(const char *command, const char *path_env, FILE *out,
+                     char *exec_name, size_t exec_size) {
+    exec_name[0] = '\0';
+    if (strlen(command) > MAX_INPUT_LEN) {
+        return -1;
+    }
+    use_path(path_env);
+    switch (lookup_quick(command, out, exec_name, exec_size)) {
+    case LOOKUP_EXEC:
+        return CNF_LOOKUP_EXEC;
+    case LOOKUP_DONE:
+        return CNF_LOOKUP_DONE;
+    case LOOKUP_SEARCH:
+        break;
+    }
+    return CNF_LOOKUP_SEARCH;
+}
+
+int cnf_lookup(const char *command, const char *path_env, FILE *out,
+               char *exec_name, size_t exec_size) {
+    if (strlen(command) > MAX_INPUT_LEN) {
+        fprintf(out, "Input command too long\n");
+        exec_name[0] = '\0';
+        return 1;
+    }
+    use_path(path_env);
+    return lookup_command(command, &options, out, exec_name, exec_size);
+}
+
+void cnf_release(void) {
+    lookup_release_index();
+    lookup_release_installed();
+}
@@ -0,0 +1,753 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+#include <locale.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "common.h"
+#include "lookup.h"
+#include "index.h"
+#include "search.h"
+#include "installed.h"
+#include "pathcache.h"
+#include "util.h"
+#include "typo.h"
+#include "layout.h"
+#include "stats.h"
+#include "answers.h"
+
+/* Пути к данным: значения по умолчанию можно заменить переменными окружения */
+static LookupPaths paths = { PKGLIST_DIR, INDEX_PATH, TYPO_PATH, RPMDB_DIR };
+
+/* Возвращает значение переменной окружения или fallback, если она не задана */
+static const char *env_or_default(const char *name, const char *fallback) {
+    const char *value = getenv(name);
+    return value != NULL && value[0] != '\0' ? value : fallback;
+}
+
+/*
+ * Читает пути к данным, PATH и параметры поиска из окружения
+ * Значения, которые не удалось разобрать, остаются по умолчанию
+ */
+void lookup_init(LookupOptions *options) {
+    paths.pkglist_dir = env_or_default("CNF_PKGLIST_DIR", PKGLIST_DIR);
+    paths.index_path = env_or_default("CNF_INDEX_PATH", INDEX_PATH);
+    paths.typo_path = env_or_default("CNF_TYPO_PATH", TYPO_PATH);
+    paths.rpmdb_dir = env_or_default("CNF_RPMDB_DIR", RPMDB_DIR);
+    lookup_set_path(env_or_default("PATH", ""));
+
+    // Число потоков сканирования и время на ответ можно задать переменными окружения
+    LookupOptions defaults = { 0, 0, 1, 1 };
+    *options = defaults;
+    const char *threads_env = getenv("CNF_THREADS");
+    if (threads_env != NULL) {
+        options->threads = atoi(threads_env);
+    }
+    const char *budget_env = getenv("CNF_BUDGET");
+    if (budget_env != NULL && lookup_parse_budget(budget_env) >= 0) {
+        options->budget_ms = lookup_parse_budget(budget_env);
+    }
+    if (getenv("CNF_NO_ANSWER_CACHE") != NULL) {
+        options->answer_cache = 0;
+    }
+
+    // Статистику по этапам можно включить переменной окружения
+    const char *stats_env = getenv("CNF_STATS");
+    if (stats_env != NULL) {
+        lookup_enable_stats(stats_env);
+    }
+}
+
+/* Возвращает текущие пути к данным */
+const LookupPaths *lookup_paths(void) {
+    return &paths;
+}
+
+/* Сколько пакетов с похожими именами показывается */
+#define SIMILAR_SHOWN 3
+
+/* Список системных каталогов для поиска */
+static const char *const system_dirs[] = {
+    "/bin", "/sbin", "/usr/bin", "/usr/sbin", 
+    "/usr/local/bin", "/usr/local/sbin", NULL
+};
+
+/* PATH, в котором ищутся команды: свой или присланный оболочкой */
+static char *lookup_path = NULL;
+
+/* Кеш содержимого каталогов, заполняется при первой проверке */
+static PathCache path_cache;
+static char *path_cache_env = NULL;
+static int path_cache_loaded = 0;
+
+/*
+ * Заполняет кеш каталогов PATH и системных каталогов
+ * Содержимое неизменившихся каталогов берется из кеша пользователя,
+ * если он не отключен переменной CNF_NO_PATH_CACHE
+ */
+static PathCache *get_path_cache(void) {
+    if (!path_cache_loaded) {
+        char persist_path[MAX_PATH_LEN];
+        int persist = getenv("CNF_NO_PATH_CACHE") == NULL &&
+                      user_cache_path("path", persist_path, sizeof(persist_path)) == 0;
+
+        path_cache_init(&path_cache, lookup_path != NULL ? lookup_path : "", system_dirs,
+                        persist ? persist_path : NULL);
+        path_cache_save(&path_cache);
+        free(path_cache_env);
+        path_cache_env = lookup_path != NULL ? strdup(lookup_path) : NULL;
+        path_cache_loaded = 1;
+    }
+    return &path_cache;
+}
+
+/*
+ * Задает PATH для следующих проверок
+ * Кеш каталогов сбрасывается, если PATH другой или какой-то каталог изменился
+ */
+void lookup_set_path(const char *path_env) {
+    if (lookup_path == NULL || strcmp(lookup_path, path_env) != 0) {
+        free(lookup_path);
+        lookup_path = strdup(path_env);
+    }
+    if (path_cache_loaded &&
+        (path_cache_env == NULL || lookup_path == NULL || strcmp(path_cache_env, lookup_path) != 0 ||
+         !path_cache_is_current(&path_cache))) {
+        path_cache_free(&path_cache);
+        path_cache_loaded = 0;
+    }
+}
+
+/* Читает каталоги PATH заранее, до первой проверки */
+void lookup_prepare(void) {
+    get_path_cache();
+}
+
+/* 
+ * Проверяет существование команды в путях PATH
+ * Возвращает 1 если команда найдена, 0 если нет
+ */
+int command_exists_in_path(const char *cmd) {
+    StatsPhase previous = stats_enter(STATS_PHASE_PATH);
+    int exists = path_cache_has_executable(get_path_cache(), cmd);
+    stats_leave(previous);
+    return exists;
+}
+
+/* 
+ * Проверяет существование команды в системных каталогах
+ * Каталоги PATH уже проверены command_exists_in_path, поэтому
+ * отдельный запуск which не нужен
+ */
+int command_exists_in_system_bin(const char *cmd) {
+    StatsPhase previous = stats_enter(STATS_PHASE_SYSTEM);
+    int exists = path_cache_has_system_file(get_path_cache(), cmd);
+    stats_leave(previous);
+    return exists;
+}
+
+/*
+ * Пути к индексу и дереву опечаток в кеше пользователя: их строят
+ * резидентный режим и фоновое обновление, когда системные устарели
+ * Возвращает 0 при успехе, -1 если кеш недоступен
+ */
+int lookup_user_index_paths(char *index_buf, char *typo_buf, size_t size) {
+    if (user_cache_path("index", index_buf, size) != 0 ||
+        user_cache_path("typo", typo_buf, size) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Индекс команд и дерево опечаток, открываются при первом обращении */
+static CommandIndex command_index;
+static int command_index_state = 0;  // 0 - не открыт, 1 - открыт, -1 - нет актуального
+static char opened_typo_path[MAX_PATH_LEN];  // Дерево, построенное вместе с открытым индексом
+static TypoTree typo_tree;
+static int typo_tree_state = 0;
+
+/*
+ * Открывает индекс, построенный по текущим pkglist: системный, а если он
+ * устарел - копию в кеше пользователя; в typo_buf записывается путь к
+ * дереву опечаток, построенному вместе с ним
+ * Возвращает 0 при успехе, -1 если актуального индекса нет
+ */
+static int open_current_index(CommandIndex *index, char *typo_buf, size_t size) {
+    char user_index[MAX_PATH_LEN];
+    if (index_open(index, paths.index_path, paths.pkglist_dir) == 0) {
+        snprintf(typo_buf, size, "%s", paths.typo_path);
+        return 0;
+    }
+    if (lookup_user_index_paths(user_index, typo_buf, size) == 0 &&
+        index_open(index, user_index, paths.pkglist_dir) == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+/* Возвращает индекс, если он построен по текущим pkglist, иначе NULL */
+const CommandIndex *lookup_index(void) {
+    if (command_index_state == 0) {
+        command_index_state = open_current_index(&command_index, opened_typo_path,
+                                                 sizeof(opened_typo_path)) == 0 ? 1 : -1;
+    }
+    return command_index_state > 0 ? &command_index : NULL;
+}
+
+/* Возвращает дерево опечаток, если оно построено по актуальному индексу, иначе NULL */
+static const TypoTree *get_typo_tree(void) {
+    if (typo_tree_state == 0) {
+        const CommandIndex *index = lookup_index();
+        typo_tree_state = index != NULL &&
+            typo_tree_open(&typo_tree, opened_typo_path, index->source_stamp) == 0 ? 1 : -1;
+    }
+    return typo_tree_state > 0 ? &typo_tree : NULL;
+}
+
+/* Закрывает индекс и дерево опечаток; следующее обращение откроет их заново */
+void lookup_release_index(void) {
+    if (typo_tree_state > 0) {
+        typo_tree_close(&typo_tree);
+    }
+    if (command_index_state > 0) {
+        index_close(&command_index);
+    }
+    typo_tree_state = 0;
+    command_index_state = 0;
+}
+
+/*
+ * Переключает поиск на актуальный индекс
+ * Прежние данные закрываются только после того, как новый индекс открыт
+ * Возвращает 0 при успехе, -1 если актуального индекса нет
+ */
+int lookup_switch_index(void) {
+    CommandIndex index;
+    char typo[MAX_PATH_LEN];
+    if (open_current_index(&index, typo, sizeof(typo)) != 0) {
+        return -1;
+    }
+    lookup_release_index();
+    command_index = index;
+    command_index_state = 1;
+    snprintf(opened_typo_path, sizeof(opened_typo_path), "%s", typo);
+    return 0;
+}
+
+/* Состояние перебора исполняемых файлов PATH при поиске опечаток */
+typedef struct {
+    const TypoPattern *pattern;
+    TypoResults *results;
+} TypoPathScan;
+
+/*
+ * Проверяет имя из каталога PATH как вариант исправления
+ * Право на исполнение проверяется только у близких по написанию имен
+ */
+static void check_path_typo(const char *name, void *user_data) {
+    TypoPathScan *scan = user_data;
+    TypoResults near;
+    typo_results_init(&near, 1, scan->results->max_distance);
+    typo_check_name(scan->pattern, &near, name, NULL);
+    if (near.count > 0 && path_cache_has_executable(get_path_cache(), name)) {
+        typo_results_offer(scan->results, name, NULL, near.items[0].distance);
+    }
+}
+
+/*
+ * Подбирает команды с похожим написанием среди исполняемых файлов PATH
+ * и команд из базы пакетов (BK-дерево строится вместе с индексом)
+ * scanned - варианты, собранные обходом pkglist (пусто, если ответ дал индекс):
+ * без них при отсутствующем или устаревшем дереве команды пакетов не предлагались бы
+ * Дерево просматривается не дольше budget_ms; если оно не просмотрено
+ * целиком, *truncated выставляется в 1
+ * Возвращает количество вариантов
+ */
+static int find_typo_suggestions(const char *cmd, TypoResults *results, const TypoResults *scanned,
+                                 double budget_ms, int *truncated) {
+    TypoPattern pattern;
+    typo_pattern_init(&pattern, cmd);
+    typo_results_init(results, 3, typo_max_distance(pattern.length));
+    if (results->max_distance == 0) {
+        return 0;
+    }
+
+    // Сначала установленные команды: при равном расстоянии они предпочтительнее
+    TypoPathScan scan = { &pattern, results };
+    path_cache_foreach_name(get_path_cache(), check_path_typo, &scan);
+
+    for (int i = 0; scanned != NULL && i < scanned->count; i++) {
+        typo_results_offer(results, scanned->items[i].name, scanned->items[i].package,
+                           scanned->items[i].distance);
+    }
+
+    const TypoTree *tree = get_typo_tree();
+    if (tree != NULL && (budget_ms <= 0 || !typo_tree_search(tree, &pattern, results, budget_ms))) {
+        *truncated = 1;
+    }
+
+    return results->count;
+}
+
+/* Снимок установленных пакетов, загружается при первой проверке */
+static InstalledSet installed_packages;
+static int installed_packages_loaded = 0;
+
+/* 
+ * Проверяет установлен ли пакет в системе
+ * Все проверки обслуживаются одним снимком базы rpm (или списком из
+ * файла CNF_INSTALLED_LIST) без запуска rpm на каждый пакет
+ */
+int package_is_installed(const char *package_name) {
+    StatsPhase previous = stats_enter(STATS_PHASE_INSTALLED);
+    if (!installed_packages_loaded) {
+        const char *list = getenv("CNF_INSTALLED_LIST");
+        if (list != NULL) {
+            installed_set_load(&installed_packages, &installed_backend_list, list);
+        } else {
+            installed_set_load(&installed_packages, &installed_backend_rpm, paths.rpmdb_dir);
+        }
+        installed_packages_loaded = 1;
+    }
+    int installed = installed_set_contains(&installed_packages, package_name);
+    stats_leave(previous);
+    return installed;
+}
+
+/* Забывает снимок установленных пакетов; следующая проверка загрузит его заново */
+void lookup_release_installed(void) {
+    if (installed_packages_loaded) {
+        installed_set_free(&installed_packages);
+        installed_packages_loaded = 0;
+    }
+}
+
+/* Файл журнала статистики (NULL - вывод в stderr) */
+static const char *stats_log = NULL;
+
+/* Выводит статистику запуска, если ее сбор включен */
+void lookup_report_stats(const char *command, const char *result) {
+    stats_report(stats_log, command, result);
+}
+
+/*
+ * Включает статистику по значению --stats= или CNF_STATS:
+ * пустое значение, "1" или "stderr" - вывод в stderr, иначе путь к журналу
+ */
+void lookup_enable_stats(const char *value) {
+    stats_log = (value[0] == '\0' || strcmp(value, "1") == 0 || strcmp(value, "stderr") == 0) ? NULL : value;
+    stats_enable();
+}
+
+/*
+ * Разбирает длительность "50ms" или "50" (миллисекунды)
+ * Возвращает число миллисекунд или -1 при неверном значении
+ */
+int lookup_parse_budget(const char *value) {
+    char *end;
+    long ms = strtol(value, &end, 10);
+    if (end == value || ms < 0 || ms > 60000 || (*end != '\0' && strcmp(end, "ms") != 0)) {
+        return -1;
+    }
+    return (int)ms;
+}
+
+/*
+ * Запускает в фоне построение индекса в кеше пользователя, чтобы следующий
+ * запуск ответил из индекса; одновременно работает не больше одного процесса
+ * С wait_lock процесс запускается и при занятой блокировке и дожидается ее:
+ * резидентной программе нужен процесс, завершения которого можно ждать
+ * Возвращает идентификатор процесса или 0, если процесс не запущен
+ */
+pid_t lookup_start_rebuild(int wait_lock) {
+    char user_index[MAX_PATH_LEN];
+    char user_typo[MAX_PATH_LEN];
+    char lock_path[MAX_PATH_LEN];
+    if (lookup_user_index_paths(user_index, user_typo, sizeof(user_index)) != 0 ||
+        user_cache_path("index.lock", lock_path, sizeof(lock_path)) != 0) {
+        return 0;
+    }
+
+    // Блокировку держит дочерний процесс, пока не закончит
+    int lock = open(lock_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+    if (lock < 0) {
+        return 0;
+    }
+    if (!wait_lock && flock(lock, LOCK_EX | LOCK_NB) != 0) {
+        close(lock);
+        return 0;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Оболочка не должна ждать фоновый процесс: отвязываемся от терминала и вывода
+        setsid();
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd > STDERR_FILENO) {
+                close(null_fd);
+            }
+        }
+        if (wait_lock) {
+            // Пока блокировка была занята, копию мог достроить другой процесс
+            CommandIndex current;
+            if (flock(lock, LOCK_EX) != 0 || index_open(&current, user_index, paths.pkglist_dir) == 0) {
+                _exit(0);
+            }
+        }
+        if (index_rebuild(user_index, paths.pkglist_dir, NULL) >= 0) {
+            typo_tree_rebuild(user_typo, user_index, paths.pkglist_dir);
+        }
+        _exit(0);
+    }
+    close(lock);
+    return pid > 0 ? pid : 0;
+}
+
+/* Команда и ее варианты в других раскладках */
+typedef struct {
+    char original_cmd[MAX_INPUT_LEN + 1];
+    char candidates[LAYOUT_MAX_CANDIDATES][MAX_INPUT_LEN + 1];
+    int candidate_count;
+} LookupNames;
+
+/*
+ * Быстрые проверки: варианты раскладки, PATH и системные каталоги
+ * Ничего не запускает и не читает базу пакетов
+ */
+static LookupStage quick_checks(LookupNames *names, FILE *out, char *exec_name, size_t exec_size) {
+    const char *original_cmd = names->original_cmd;
+    char (*candidates)[MAX_INPUT_LEN + 1] = names->candidates;
+
+    // Варианты команды, набранной не в той раскладке (автокоррекция раскладки)
+    StatsPhase previous = stats_enter(STATS_PHASE_LAYOUT);
+    int candidate_count = layout_candidates(original_cmd, candidates, LAYOUT_MAX_CANDIDATES);
+    names->candidate_count = candidate_count;
+    stats_leave(previous);
+
+    // Если один из вариантов существует - выполняем его
+    for (int i = 0; i < candidate_count; i++) {
+        if (command_exists_in_path(candidates[i])) {
+            fprintf(out, "Auto-correcting '%s' to '%s' and executing:\n", original_cmd, candidates[i]);
+            snprintf(exec_name, exec_size, "%s", candidates[i]);
+            lookup_report_stats(original_cmd, "exec-layout");
+            return LOOKUP_EXEC;
+        }
+    }
+
+    // Пытаемся выполнить оригинальную команду
+    if (command_exists_in_path(original_cmd)) {
+        snprintf(exec_name, exec_size, "%s", original_cmd);
+        lookup_report_stats(original_cmd, "exec");
+        return LOOKUP_EXEC;
+    }
+
+    // Проверяем существование команды в системных каталогах
+    if (command_exists_in_system_bin(original_cmd)) {
+        fprintf(out, "%s: %s\n", original_cmd, _("Command found in system directories but not in your PATH"));
+        fprintf(out, "%s 'su - -c \"%s\"'\n", _("Try running as root:"), original_cmd);
+        lookup_report_stats(original_cmd, "system");
+        return LOOKUP_DONE;
+    }
+    // Проверяем варианты команды в системных каталогах
+    for (int i = 0; i < candidate_count; i++) {
+        if (command_exists_in_system_bin(candidates[i])) {
+            fprintf(out, "%s '%s'?\n", _("Did you mean"), candidates[i]);
+            fprintf(out, "%s 'su - -c \"%s\"'\n", _("Try running as root:"), candidates[i]);
+            lookup_report_stats(original_cmd, "system-layout");
+            return LOOKUP_DONE;
+        }
+    }
+    return LOOKUP_SEARCH;
+}
+
+/* Копирует команду для проверок, обрезая ее до MAX_INPUT_LEN */
+static void lookup_names_init(LookupNames *names, const char *command) {
+    strncpy(names->original_cmd, command, MAX_INPUT_LEN);
+    names->original_cmd[MAX_INPUT_LEN] = '\0';
+    names->candidate_count = 0;
+}
+
+/*
+ * Выполняет только быстрые проверки и пишет подсказку в out
+ * LOOKUP_EXEC - команду exec_name нужно выполнить, LOOKUP_DONE - ответ выведен,
+ * LOOKUP_SEARCH - ответ требует поиска по базе пакетов
+ */
+LookupStage lookup_quick(const char *command, FILE *out, char *exec_name, size_t exec_size) {
+    LookupNames names;
+    exec_name[0] = '\0';
+    lookup_names_init(&names, command);
+    return quick_checks(&names, out, exec_name, exec_size);
+}
+
+/*
+ * Состояние, от которого зависит ответ: PATH и время изменения его
+ * каталогов, системные каталоги, pkglist, индексы, база rpm и язык сообщений
+ * Возвращает 0 при успехе, -1 если ответ нельзя кешировать (в PATH есть
+ * относительные каталоги, зависящие от текущего каталога)
+ */
+static int answer_state(uint64_t *state) {
+    const char *path_env = lookup_path != NULL ? lookup_path : "";
+    uint64_t hash = answer_state_string(ANSWER_STATE_INIT, path_env);
+    for (const char *dir = path_env; ; ) {
+        const char *end = strchr(dir, ':');
+        size_t len = end != NULL ? (size_t)(end - dir) : strlen(dir);
+        char dir_path[MAX_PATH_LEN];
+        if (len == 0 || dir[0] != '/' || len >= sizeof(dir_path)) {
+            return -1;
+        }
+        memcpy(dir_path, dir, len);
+        dir_path[len] = '\0';
+        hash = answer_state_number(hash, path_mtime_ns(dir_path));
+        if (end == NULL) {
+            break;
+        }
+        dir = end + 1;
+    }
+    for (int i = 0; system_dirs[i] != NULL; i++) {
+        hash = answer_state_number(hash, path_mtime_ns(system_dirs[i]));
+    }
+
+    // Перевод подсказок
+    hash = answer_state_string(hash, setlocale(LC_MESSAGES, NULL));
+    hash = answer_state_string(hash, getenv("LANGUAGE"));
+
+    // База пакетов: сами pkglist и построенные по ним индексы и деревья опечаток
+    hash = answer_state_string(hash, paths.pkglist_dir);
+    hash = answer_state_number(hash, dir_tree_mtime_ns(paths.pkglist_dir));
+    hash = answer_state_string(hash, paths.index_path);
+    hash = answer_state_number(hash, path_mtime_ns(paths.index_path));
+    hash = answer_state_string(hash, paths.typo_path);
+    hash = answer_state_number(hash, path_mtime_ns(paths.typo_path));
+    char user_index[MAX_PATH_LEN];
+    char user_typo[MAX_PATH_LEN];
+    if (lookup_user_index_paths(user_index, user_typo, sizeof(user_index)) == 0) {
+        hash = answer_state_number(hash, path_mtime_ns(user_index));
+        hash = answer_state_number(hash, path_mtime_ns(user_typo));
+    }
+
+    // Установленные пакеты
+    const char *list = getenv("CNF_INSTALLED_LIST");
+    if (list != NULL) {
+        hash = answer_state_string(hash, list);
+        hash = answer_state_number(hash, path_mtime_ns(list));
+    } else {
+        hash = answer_state_string(hash, paths.rpmdb_dir);
+        hash = answer_state_number(hash, dir_tree_mtime_ns(paths.rpmdb_dir));
+    }
+
+    *state = hash;
+    return 0;
+}
+
+/*
+ * Ищет команду без кеша ответов и пишет подсказку в out
+ * В *cacheable записывается 1, если ответ полный, не требует выполнения
+ * команды и не зависит от права на исполнение файлов PATH, то есть при
+ * том же состоянии повторится без изменений
+ */
+static int lookup_answer(const char *command, const LookupOptions *options, FILE *out,
+                         char *exec_name, size_t exec_size, int *cacheable) {
+    *cacheable = 0;
+    // Право на исполнение в состояние ответа не входит: chmod не меняет
+    // время изменения каталога. Ответ, при котором имя из PATH оказалось
+    // неисполняемым, не запоминается
+    size_t exec_denied = get_path_cache()->exec_denied;
+    int64_t deadline_ns = options->budget_ms > 0 ? monotonic_ns() + (int64_t)options->budget_ms * 1000000 : 0;
+
+    LookupNames names;
+    lookup_names_init(&names, command);
+    switch (quick_checks(&names, out, exec_name, exec_size)) {
+    case LOOKUP_EXEC:
+        return 0;
+    case LOOKUP_DONE:
+        *cacheable = get_path_cache()->exec_denied == exec_denied;
+        return 127;
+    case LOOKUP_SEARCH:
+        break;
+    }
+    const char *original_cmd = names.original_cmd;
+    char (*candidates)[MAX_INPUT_LEN + 1] = names.candidates;
+    int candidate_count = names.candidate_count;
+
+    fflush(out);
+
+    // Основное имя - первый вариант раскладки, если он есть, иначе сама команда;
+    // остальные варианты проверяются тем же поиском
+    const char *converted_cmd = candidate_count > 0 ? candidates[0] : original_cmd;
+    const char *alternatives[LAYOUT_MAX_CANDIDATES];
+    for (int i = 1; i < candidate_count; i++) {
+        alternatives[i - 1] = candidates[i];
+    }
+
+    // Поиск пакета с командой и похожих пакетов за один проход по базе
+    // Без актуального индекса имена команд для исправления опечатки
+    // собираются тем же обходом
+    TypoPattern typo_pattern;
+    typo_pattern_init(&typo_pattern, converted_cmd);
+    SearchResult search_result;
+    StatsPhase previous = stats_enter(STATS_PHASE_SEARCH);
+    const CommandIndex *index = lookup_index();
+    SearchQuery query = { .command_name = converted_cmd, .pattern = converted_cmd, .similar_on_miss_only = 1,
+                          .pkglist_dir = paths.pkglist_dir, .threads = options->threads,
+                          .alternatives = alternatives,
+                          .alternative_count = candidate_count > 0 ? candidate_count - 1 : 0,
+                          .index = index, .deadline_ns = deadline_ns, .similar_limit = SIMILAR_SHOWN,
+                          .typo_pattern = &typo_pattern };
+    int found = search_packages(&query, &search_result);
+    stats_leave(previous);
+    int truncated = search_result.truncated;
+    int typo_truncated = 0;
+    int path_typos = 0;
+
+    if (found) {
+        PackageInfo *package_info = &search_result.exact;
+        if (package_is_installed(package_info->package_name)) {
+            // Пакет установлен, но команда не найдена
+            fprintf(out, "%s\n", _("Package is already installed but command not found."));
+            fprintf(out, "%s: %s\n", _("Package"), package_info->package_name);
+            fprintf(out, "%s: %s\n", _("Binary path"), package_info->binary_path);
+            fprintf(out, "%s: %s\n", _("Description"), package_info->description);
+        } else {
+            // Предлагаем установить пакет
+            fprintf(out, "%s:\n", _("The program can be installed using"));
+            fprintf(out, "su - -c 'apt-get install %s'\n", package_info->package_name);
+            fprintf(out, "%s: %s\n", _("Description"), package_info->description);
+        }
+    } else {
+        // Варианты исправления опечатки в имени команды
+        // Дерево опечаток просматривается в пределах оставшегося времени
+        double typo_budget_ms = TYPO_DEFAULT_BUDGET_MS;
+        if (deadline_ns != 0) {
+            double remaining_ms = (deadline_ns - monotonic_ns()) / 1e6;
+            if (remaining_ms < typo_budget_ms) {
+                typo_budget_ms = remaining_ms;
+            }
+        }
+        TypoResults typos;
+        previous = stats_enter(STATS_PHASE_TYPO);
+        int typo_count = find_typo_suggestions(converted_cmd, &typos, &search_result.typos,
+                                               typo_budget_ms, &typo_truncated);
+        stats_leave(previous);
+        // Без --budget недосмотренное дерево опечаток не делает ответ неполным:
+        // пакеты проверены все, а предел TYPO_DEFAULT_BUDGET_MS был и раньше
+        if (typo_truncated && options->budget_ms > 0) {
+            truncated = 1;
+        }
+        for (int i = 0; i < typo_count; i++) {
+            if (typos.items[i].package[0] == '\0') {
+                fprintf(out, "%s '%s'?\n", _("Did you mean"), typos.items[i].name);
+                path_typos = 1;
+            } else {
+                fprintf(out, "%s '%s'? [%s: %s]\n", _("Did you mean"), typos.items[i].name,
+                       _("Package"), typos.items[i].package);
+            }
+        }
+
+        // Показываем пакеты с похожими именами
+        fprintf(out, "%s\n", _("Perhaps you were looking for:"));
+        
+        PackageInfo *similar_results = search_result.similar;
+        int result_count = (search_result.similar_count < SIMILAR_SHOWN) ? search_result.similar_count : SIMILAR_SHOWN;
+        
+        if (result_count > 0) {
+            for (int i = 0; i < result_count; i++) {
+                if (package_is_installed(similar_results[i].package_name)) {
+                    fprintf(out, "%s [%s]\n", similar_results[i].package_name, _("already installed"));
+                } else {
+                    fprintf(out, "%s - %s\n", similar_results[i].package_name, similar_results[i].description);
+                }
+            }
+        } else {
+            // Если похожих пакетов не найдено
+            fprintf(out, "%s 'apt-cache search %s'\n", _("Try:"), converted_cmd);
+        }
+    }
+
+    // Неполный ответ: следующий запуск будет быстрее, если индекс построится в фоне
+    if (truncated) {
+        fprintf(out, "%s\n", _("Search truncated: not all packages were checked in time."));
+        if (search_result.truncated && options->warm_cache && lookup_start_rebuild(0)) {
+            fprintf(out, "%s\n", _("The package index is being rebuilt in the background."));
+        }
+        search_result_free(&search_result);
+        lookup_report_stats(original_cmd, found ? "package-truncated" : "miss-truncated");
+        return 127;
+    }
+
+    search_result_free(&search_result);
+    lookup_report_stats(original_cmd, found ? "package" : "miss");
+    // Варианты из дерева опечаток, найденные за ограниченное время, могут
+    // отличаться от запуска к запуску, а варианты из PATH перестают быть
+    // верными после chmod -x
+    *cacheable = !typo_truncated && !path_typos && get_path_cache()->exec_denied == exec_denied;
+    return 127;
+}
+
+/*
+ * Ищет команду и пишет подсказку в out
+ * Быстрые проверки (раскладка, PATH, системные каталоги, индекс) выполняются
+ * всегда, а сканирование pkglist и поиск опечаток прекращаются по истечении
+ * options->budget_ms с пометкой о неполном ответе
+ * Полные ответы, в том числе "пакет не найден", сохраняются в кеше
+ * пользователя и повторяются без поиска, пока не изменится их состояние
+ * Если команду нужно выполнить, ее имя записывается в exec_name и возвращается 0,
+ * иначе exec_name остается пустым и возвращается код завершения
+ */
+int lookup_command(const char *command, const LookupOptions *options, FILE *out,
+                   char *exec_name, size_t exec_size) {
+    exec_name[0] = '\0';
+    int cacheable;
+    char cache_path[MAX_PATH_LEN];
+    uint64_t state;
+    if (!options->answer_cache || answer_state(&state) != 0 ||
+        user_cache_path("answers", cache_path, sizeof(cache_path)) != 0) {
+        return lookup_answer(command, options, out, exec_name, exec_size, &cacheable);
+    }
+
+    // Ключ - команда в том виде, в каком ее проверяет поиск
+    LookupNames names;
+    lookup_names_init(&names, command);
+    size_t len;
+    int code;
+    char *text = answer_cache_get(cache_path, state, names.original_cmd, &code, &len);
+    if (text != NULL) {
+        fwrite(text, 1, len, out);
+        free(text);
+        lookup_report_stats(names.original_cmd, "cached");
+        return code;
+    }
+
+    // Ответ собирается в памяти, чтобы сохранить его вместе с выводом
+    char *captured = NULL;
+    size_t captured_len = 0;
+    FILE *capture = open_memstream(&captured, &captured_len);
+    if (capture == NULL) {
+        return lookup_answer(command, options, out, exec_name, exec_size, &cacheable);
+    }
+    code = lookup_answer(command, options, capture, exec_name, exec_size, &cacheable);
+    if (fclose(capture) != 0) {
+        cacheable = 0;
+    }
+    if (captured != NULL) {
+        fwrite(captured, 1, captured_len, out);
+        if (cacheable) {
+            answer_cache_put(cache_path, state, names.original_cmd, code, captured, captured_len);
+        }
+    }
+    free(captured);
+    return code;
+}
+
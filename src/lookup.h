@@ -0,0 +1,122 @@
+#ifndef CNF_LOOKUP_H
+#define CNF_LOOKUP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "index.h"
+
+/* Пути к данным */
+typedef struct {
+    const char *pkglist_dir;  // Каталог pkglist
+    const char *index_path;   // Системный индекс команд
+    const char *typo_path;    // Системное дерево опечаток
+    const char *rpmdb_dir;    // База rpm
+} LookupPaths;
+
+/* Параметры поиска */
+typedef struct {
+    int threads;       // Потоков сканирования pkglist (0 - по числу процессоров)
+    int budget_ms;     // Время на ответ (0 - без ограничения)
+    int warm_cache;    // Перестраивать индекс в фоне после прерванного поиска
+    int answer_cache;  // Повторять сохраненные ответы из кеша пользователя
+} LookupOptions;
+
+/* Результат быстрых проверок */
+typedef enum {
+    LOOKUP_EXEC,    // Команду нужно выполнить
+    LOOKUP_DONE,    // Ответ выведен
+    LOOKUP_SEARCH,  // Нужен поиск по базе пакетов
+} LookupStage;
+
+/*
+ * Читает пути к данным, PATH и параметры поиска из окружения
+ * (CNF_PKGLIST_DIR, CNF_INDEX_PATH, CNF_TYPO_PATH, CNF_RPMDB_DIR,
+ * CNF_THREADS, CNF_BUDGET, CNF_STATS, CNF_NO_ANSWER_CACHE)
+ */
+void lookup_init(LookupOptions *options);
+
+/* Возвращает текущие пути к данным */
+const LookupPaths *lookup_paths(void);
+
+/*
+ * Задает PATH для следующих проверок
+ * Кеш каталогов сбрасывается, если PATH другой или какой-то каталог изменился
+ */
+void lookup_set_path(const char *path_env);
+
+/* Читает каталоги PATH заранее, до первой проверки */
+void lookup_prepare(void);
+
+/* Проверяет существование команды в путях PATH */
+int command_exists_in_path(const char *cmd);
+
+/* Проверяет существование команды в системных каталогах */
+int command_exists_in_system_bin(const char *cmd);
+
+/* Проверяет установлен ли пакет в системе */
+int package_is_installed(const char *package_name);
+
+/*
+ * Пути к индексу и дереву опечаток в кеше пользователя
+ * Возвращает 0 при успехе, -1 если кеш недоступен
+ */
+int lookup_user_index_paths(char *index_buf, char *typo_buf, size_t size);
+
+/* Возвращает индекс, если он построен по текущим pkglist, иначе NULL */
+const CommandIndex *lookup_index(void);
+
+/* Закрывает индекс и дерево опечаток; следующее обращение откроет их заново */
+void lookup_release_index(void);
+
+/*
+ * Переключает поиск на актуальный индекс; прежний закрывается
+ * только после того, как новый открыт
+ * Возвращает 0 при успехе, -1 если актуального индекса нет
+ */
+int lookup_switch_index(void);
+
+/*
+ * Запускает в фоне построение индекса в кеше пользователя
+ * С wait_lock процесс дожидается блокировки, занятой другим построением
+ * Возвращает идентификатор процесса или 0, если процесс не запущен
+ */
+pid_t lookup_start_rebuild(int wait_lock);
+
+/* Забывает снимок установленных пакетов; следующая проверка загрузит его заново */
+void lookup_release_installed(void);
+
+/*
+ * Включает статистику по значению --stats= или CNF_STATS:
+ * пустое значение, "1" или "stderr" - вывод в stderr, иначе путь к журналу
+ */
+void lookup_enable_stats(const char *value);
+
+/* Выводит статистику запуска, если ее сбор включен */
+void lookup_report_stats(const char *command, const char *result);
+
+/*
+ * Разбирает длительность "50ms" или "50" (миллисекунды)
+ * Возвращает число миллисекунд или -1 при неверном значении
+ */
+int lookup_parse_budget(const char *value);
+
+/*
+ * Выполняет только проверки, не требующие базы пакетов: раскладку,
+ * PATH и системные каталоги; при LOOKUP_EXEC имя команды записывается
+ * в exec_name, при LOOKUP_DONE подсказка уже выведена в out
+ */
+LookupStage lookup_quick(const char *command, FILE *out, char *exec_name, size_t exec_size);
+
+/*
+ * Ищет команду и пишет подсказку в out
+ * Полные ответы без выполнения команды запоминаются в кеше пользователя
+ * до изменения PATH, его каталогов, pkglist, индексов или базы rpm
+ * Если команду нужно выполнить, ее имя записывается в exec_name и возвращается 0,
+ * иначе exec_name остается пустым и возвращается код завершения
+ */
+int lookup_command(const char *command, const LookupOptions *options, FILE *out,
+                   char *exec_name, size_t exec_size);
+
+#endif /* CNF_LOOKUP_H */
@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "pathcache.h"
+#include "util.h"
+
+/* Сигнатура файла кеша каталогов */
+#define PATH_CACHE_MAGIC "CNF-PATH 2"
+
+/* Хеш FNV-1a */
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Добавляет имя в каталог (таблица строится позже) */
+static int dir_add_entry(PathDir *dir, const char *name, size_t len) {
+    if (dir->entries_len + len + 1 > dir->entries_cap) {
+        size_t cap = dir->entries_cap ? dir->entries_cap * 2 : 16384;
+        while (cap < dir->entries_len + len + 1) {
+            cap *= 2;
+        }
+        char *entries = realloc(dir->entries, cap);
+        if (entries == NULL) {
+            return -1;
+        }
+        dir->entries = entries;
+        dir->entries_cap = cap;
+    }
+
+    char *entry = dir->entries + dir->entries_len;
+    memcpy(entry, name, len);
+    entry[len] = '\0';
+    dir->entries_len += len + 1;
+    return 0;
+}
+
+/* Строит хеш-таблицу по накопленным записям */
+static int dir_build_table(PathDir *dir) {
+    size_t count = 0;
+    for (size_t pos = 0; pos < dir->entries_len; pos += strlen(dir->entries + pos) + 1) {
+        count++;
+    }
+
+    size_t slot_count = 16;
+    while (slot_count < count * 2) {
+        slot_count *= 2;
+    }
+
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        return -1;
+    }
+
+    for (size_t pos = 0; pos < dir->entries_len; pos += strlen(dir->entries + pos) + 1) {
+        size_t slot = hash_name(dir->entries + pos) & (slot_count - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = (uint32_t)pos + 1;
+    }
+
+    free(dir->slots);
+    dir->slots = slots;
+    dir->slot_count = slot_count;
+    return 0;
+}
+
+/* Проверяет, есть ли имя name в каталоге */
+static int dir_lookup(const PathDir *dir, const char *name) {
+    if (dir->slot_count == 0) {
+        return 0;
+    }
+
+    size_t slot = hash_name(name) & (dir->slot_count - 1);
+    while (dir->slots[slot] != 0) {
+        const char *entry = dir->entries + dir->slots[slot] - 1;
+        if (strcmp(entry, name) == 0) {
+            return 1;
+        }
+        slot = (slot + 1) & (dir->slot_count - 1);
+    }
+    return 0;
+}
+
+/*
+ * Проверяет, что name в каталоге - обычный файл, который можно исполнить
+ * Права проверяются при каждом запросе, а не берутся из кеша: chmod и
+ * замена цели символической ссылки не меняют время изменения каталога
+ */
+static int dir_entry_is_executable(const PathDir *dir, const char *name) {
+    char path[MAX_PATH_LEN];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir->path, name) >= sizeof(path)) {
+        return 0;
+    }
+
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && faccessat(AT_FDCWD, path, X_OK, AT_EACCESS) == 0;
+}
+
+/* Читает содержимое каталога */
+static int dir_scan(PathDir *dir) {
+    dir->entries_len = 0;
+
+    // Отсутствующий каталог дает пустую таблицу и не сохраняется
+    DIR *handle = opendir(dir->path);
+    if (handle == NULL) {
+        return dir_build_table(dir);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        if (entry->d_name[0] == '.' && (entry->d_name[1] == '\0' ||
+            (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+            continue;
+        }
+        if (dir_add_entry(dir, entry->d_name, strlen(entry->d_name)) != 0) {
+            closedir(handle);
+            return -1;
+        }
+    }
+
+    closedir(handle);
+    dir->dirty = dir->mtime >= 0;
+    return dir_build_table(dir);
+}
+
+/* Находит каталог в кеше по пути */
+static PathDir *cache_find_dir(PathCache *cache, const char *path) {
+    for (size_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->dirs[i].path, path) == 0) {
+            return &cache->dirs[i];
+        }
+    }
+    return NULL;
+}
+
+/* Добавляет каталог в кеш или возвращает уже добавленный */
+static PathDir *cache_add_dir(PathCache *cache, const char *path, size_t *cap) {
+    PathDir *dir = cache_find_dir(cache, path);
+    if (dir != NULL) {
+        return dir;
+    }
+
+    if (cache->count == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 16;
+        PathDir *dirs = realloc(cache->dirs, new_cap * sizeof(PathDir));
+        if (dirs == NULL) {
+            return NULL;
+        }
+        cache->dirs = dirs;
+        *cap = new_cap;
+    }
+
+    dir = &cache->dirs[cache->count];
+    memset(dir, 0, sizeof(*dir));
+    dir->path = strdup(path);
+    if (dir->path == NULL) {
+        return NULL;
+    }
+    dir->mtime = path_mtime_ns(path);
+    cache->count++;
+    return dir;
+}
+
+/* Возвращает начало блоков сохраненного кеша после строки-сигнатуры или NULL */
+static char *persisted_body(char *buffer) {
+    char *end = strchr(buffer, '\n');
+    if (end == NULL || (size_t)(end - buffer) != strlen(PATH_CACHE_MAGIC) ||
+        strncmp(buffer, PATH_CACHE_MAGIC, end - buffer) != 0) {
+        return NULL;
+    }
+    return end + 1;
+}
+
+/*
+ * Заполняет каталоги из сохраненного кеша, если их время изменения совпадает
+ * Формат: строка-сигнатура, затем блоки "D <mtime> <каталог>" и строки "N <имя>"
+ * Права на исполнение не сохраняются: chmod не меняет время изменения каталога
+ */
+static void cache_load_persisted(PathCache *cache) {
+    char *buffer = read_file(cache->persist_path, NULL);
+    if (buffer == NULL) {
+        return;
+    }
+
+    char *body = persisted_body(buffer);
+    if (body == NULL) {
+        free(buffer);
+        return;
+    }
+
+    PathDir *current = NULL;
+    char *end;
+    for (char *line = body; *line; line = end + 1) {
+        end = strchr(line, '\n');
+        if (end == NULL) {
+            break;
+        }
+        *end = '\0';
+
+        if (line[0] == 'D' && line[1] == ' ') {
+            // Заголовок блока каталога: используем только совпавшие по времени
+            char *path = NULL;
+            int64_t mtime = strtoll(line + 2, &path, 10);
+            current = NULL;
+            if (path != NULL && *path == ' ') {
+                PathDir *dir = cache_find_dir(cache, path + 1);
+                if (dir != NULL && dir->mtime >= 0 && dir->mtime == mtime && !dir->cached) {
+                    dir->cached = 1;
+                    current = dir;
+                }
+            }
+        } else if (current != NULL && line[0] == 'N' && line[1] == ' ') {
+            dir_add_entry(current, line + 2, end - line - 2);
+        }
+    }
+
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->dirs[i].cached && dir_build_table(&cache->dirs[i]) != 0) {
+            cache->dirs[i].cached = 0;
+            cache->dirs[i].entries_len = 0;
+        }
+    }
+    free(buffer);
+}
+
+/*
+ * Заполняет кеш каталогами из path_env и system_dirs (список завершен NULL)
+ * Каталоги, не изменившиеся с прошлого сохранения в persist_path, берутся
+ * из файла без чтения каталога; persist_path может быть NULL
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+int path_cache_init(PathCache *cache, const char *path_env,
+                    const char *const *system_dirs, const char *persist_path) {
+    memset(cache, 0, sizeof(*cache));
+    if (persist_path != NULL) {
+        snprintf(cache->persist_path, sizeof(cache->persist_path), "%s", persist_path);
+    }
+
+    size_t cap = 0;
+    if (path_env != NULL) {
+        char *path_copy = strdup(path_env); // Копируем PATH для безопасного разбора
+        if (path_copy == NULL) {
+            return -1;
+        }
+        for (char *dir = strtok(path_copy, ":"); dir != NULL; dir = strtok(NULL, ":")) {
+            PathDir *entry = cache_add_dir(cache, dir, &cap);
+            if (entry == NULL) {
+                free(path_copy);
+                return -1;
+            }
+            entry->in_path = 1;
+        }
+        free(path_copy);
+    }
+
+    for (int i = 0; system_dirs != NULL && system_dirs[i] != NULL; i++) {
+        PathDir *entry = cache_add_dir(cache, system_dirs[i], &cap);
+        if (entry == NULL) {
+            return -1;
+        }
+        entry->system = 1;
+    }
+
+    if (cache->persist_path[0] != '\0') {
+        cache_load_persisted(cache);
+    }
+
+    // Каталоги без актуальной сохраненной копии читаем заново
+    for (size_t i = 0; i < cache->count; i++) {
+        if (!cache->dirs[i].cached && dir_scan(&cache->dirs[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Проверяет, есть ли исполняемый файл name в каталогах PATH
+ * Права проверяются только у найденных в кеше имен; отказы считаются в
+ * exec_denied, чтобы зависящие от них ответы не запоминались
+ */
+int path_cache_has_executable(PathCache *cache, const char *name) {
+    for (size_t i = 0; i < cache->count; i++) {
+        const PathDir *dir = &cache->dirs[i];
+        if (!dir->in_path || !dir_lookup(dir, name)) {
+            continue;
+        }
+        if (dir_entry_is_executable(dir, name)) {
+            return 1;
+        }
+        cache->exec_denied++;
+    }
+    return 0;
+}
+
+/* Проверяет, есть ли файл name в системных каталогах */
+int path_cache_has_system_file(const PathCache *cache, const char *name) {
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->dirs[i].system && dir_lookup(&cache->dirs[i], name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Вызывает func для каждого имени из каталогов PATH
+ * Право на исполнение не проверяется: проверять его стоит только у
+ * отобранных имен через path_cache_has_executable
+ */
+void path_cache_foreach_name(const PathCache *cache,
+                             void (*func)(const char *name, void *user_data),
+                             void *user_data) {
+    for (size_t i = 0; i < cache->count; i++) {
+        const PathDir *dir = &cache->dirs[i];
+        if (!dir->in_path) {
+            continue;
+        }
+        for (size_t pos = 0; pos < dir->entries_len; pos += strlen(dir->entries + pos) + 1) {
+            func(dir->entries + pos, user_data);
+        }
+    }
+}
+
+/* Проверяет, что ни один каталог кеша не изменился с момента чтения */
+int path_cache_is_current(const PathCache *cache) {
+    for (size_t i = 0; i < cache->count; i++) {
+        if (path_mtime_ns(cache->dirs[i].path) != cache->dirs[i].mtime) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Дописывает в data блоки прежнего файла кеша для каталогов, которых нет в
+ * cache, если их время изменения не изменилось
+ * Возвращает новую длину data
+ */
+static size_t append_persisted_dirs(PathCache *cache, const char *body, char *data, size_t len) {
+    int keep = 0;
+    for (const char *line = body; *line; ) {
+        const char *end = strchr(line, '\n');
+        if (end == NULL) {
+            break;
+        }
+
+        if (line[0] == 'D' && line[1] == ' ') {
+            char *path_start = NULL;
+            int64_t mtime = strtoll(line + 2, &path_start, 10);
+            char path[MAX_PATH_LEN];
+            size_t path_len = path_start != NULL && *path_start == ' ' ? (size_t)(end - path_start - 1) : 0;
+            keep = 0;
+            if (path_len > 0 && path_len < sizeof(path)) {
+                memcpy(path, path_start + 1, path_len);
+                path[path_len] = '\0';
+                keep = path[0] == '/' && cache_find_dir(cache, path) == NULL && path_mtime_ns(path) == mtime;
+            }
+        }
+        if (keep) {
+            memcpy(data + len, line, end - line + 1);
+            len += end - line + 1;
+        }
+        line = end + 1;
+    }
+    return len;
+}
+
+/*
+ * Сохраняет кеш, если какие-то каталоги были перечитаны
+ * Неизменившиеся каталоги из прежнего файла, которых нет в cache (другой
+ * PATH), остаются в файле
+ * Возвращает 0 при успехе или если сохранять нечего
+ */
+int path_cache_save(PathCache *cache) {
+    int dirty = 0;
+    size_t size = strlen(PATH_CACHE_MAGIC) + 1;
+    for (size_t i = 0; i < cache->count; i++) {
+        dirty |= cache->dirs[i].dirty;
+        // Каждое имя занимает не меньше двух байт, поэтому префиксу "N " хватает удвоения
+        size += strlen(cache->dirs[i].path) + 32 + 2 * cache->dirs[i].entries_len;
+    }
+    if (!dirty || cache->persist_path[0] == '\0') {
+        return 0;
+    }
+
+    // Оболочки с разными PATH пишут в один файл: их каталоги сохраняются,
+    // пока не изменились, иначе каждая оболочка вытесняла бы каталоги другой
+    size_t old_size = 0;
+    char *old = read_file(cache->persist_path, &old_size);
+    const char *old_body = old != NULL ? persisted_body(old) : NULL;
+    size += old_body != NULL ? old_size : 0;
+
+    char *data = malloc(size);
+    if (data == NULL) {
+        free(old);
+        return -1;
+    }
+
+    size_t len = snprintf(data, size, "%s\n", PATH_CACHE_MAGIC);
+    for (size_t i = 0; i < cache->count; i++) {
+        const PathDir *dir = &cache->dirs[i];
+        // Относительные каталоги зависят от текущего каталога и не сохраняются
+        if (dir->path[0] != '/' || dir->mtime < 0 || strchr(dir->path, '\n') != NULL) {
+            continue;
+        }
+
+        len += snprintf(data + len, size - len, "D %" PRId64 " %s\n", dir->mtime, dir->path);
+        for (size_t pos = 0; pos < dir->entries_len; ) {
+            size_t entry_len = strlen(dir->entries + pos);
+            if (memchr(dir->entries + pos, '\n', entry_len) == NULL) {
+                data[len] = 'N';
+                data[len + 1] = ' ';
+                memcpy(data + len + 2, dir->entries + pos, entry_len);
+                data[len + entry_len + 2] = '\n';
+                len += entry_len + 3;
+            }
+            pos += entry_len + 1;
+        }
+    }
+    if (old_body != NULL) {
+        len = append_persisted_dirs(cache, old_body, data, len);
+    }
+
+    int rc = write_file_atomic(cache->persist_path, data, len);
+    free(old);
+    free(data);
+    return rc;
+}
+
+/* Освобождает кеш */
+void path_cache_free(PathCache *cache) {
+    for (size_t i = 0; i < cache->count; i++) {
+        free(cache->dirs[i].path);
+        free(cache->dirs[i].entries);
+        free(cache->dirs[i].slots);
+    }
+    free(cache->dirs);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,73 @@
+#ifndef CNF_PATHCACHE_H
+#define CNF_PATHCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* Содержимое одного каталога: хеш-набор имен */
+typedef struct {
+    char *path;           // Путь к каталогу
+    int64_t mtime;        // Время изменения каталога на момент чтения
+    int in_path;          // Каталог входит в PATH
+    int system;           // Системный каталог
+    char *entries;        // Имена "<имя>\0" подряд
+    size_t entries_len;
+    size_t entries_cap;
+    uint32_t *slots;      // Хеш-таблица смещений записей (+1, 0 - пусто)
+    size_t slot_count;    // Размер таблицы, степень двойки
+    int cached;           // Записи взяты из сохраненного кеша
+    int dirty;            // Каталог перечитан и кеш нужно сохранить
+} PathDir;
+
+/* Кеш содержимого каталогов PATH и системных каталогов */
+typedef struct {
+    PathDir *dirs;
+    size_t count;
+    char persist_path[MAX_PATH_LEN];  // Файл кеша пользователя ("" - не сохранять)
+    size_t exec_denied;   // Сколько раз имя из кеша оказалось неисполняемым
+} PathCache;
+
+/*
+ * Заполняет кеш каталогами из path_env и system_dirs (список завершен NULL)
+ * Каталоги, не изменившиеся с прошлого сохранения в persist_path, берутся
+ * из файла без чтения каталога; persist_path может быть NULL
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+int path_cache_init(PathCache *cache, const char *path_env,
+                    const char *const *system_dirs, const char *persist_path);
+
+/*
+ * Проверяет, есть ли исполняемый файл name в каталогах PATH
+ * Кеш хранит только имена; право на исполнение проверяется при вызове,
+ * отказы считаются в exec_denied
+ */
+int path_cache_has_executable(PathCache *cache, const char *name);
+
+/* Проверяет, есть ли файл name в системных каталогах */
+int path_cache_has_system_file(const PathCache *cache, const char *name);
+
+/*
+ * Вызывает func для каждого имени из каталогов PATH без проверки права на
+ * исполнение (ее стоит делать только для отобранных имен)
+ */
+void path_cache_foreach_name(const PathCache *cache,
+                             void (*func)(const char *name, void *user_data),
+                             void *user_data);
+
+/* Проверяет, что ни один каталог кеша не изменился с момента чтения */
+int path_cache_is_current(const PathCache *cache);
+
+/*
+ * Сохраняет кеш, если какие-то каталоги были перечитаны
+ * Неизменившиеся каталоги из прежнего файла, которых нет в cache (другой
+ * PATH), остаются в файле
+ * Возвращает 0 при успехе или если сохранять нечего
+ */
+int path_cache_save(PathCache *cache);
+
+/* Освобождает кеш */
+void path_cache_free(PathCache *cache);
+
+#endif /* CNF_PATHCACHE_H */
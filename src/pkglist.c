@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "pkglist.h"
+#include "stats.h"
+
+/* Сигнатура заголовка RPM */
+static const unsigned char header_magic[4] = { 0x8e, 0xad, 0xe8, 0x01 };
+
+/* Ограничения размеров заголовка, как в rpmlib */
+#define HEADER_MAX_TAGS  0xffff
+#define HEADER_MAX_DATA  0x10000000
+
+/* Проверяет, является ли файл каталога apt списком пакетов */
+int is_pkglist_file(const char *name) {
+    return strstr(name, "pkglist.") != NULL;
+}
+
+/* Собирает полный путь файла строки pkglist в буфер */
+void pkglist_row_path(const PkglistRow *row, char *buf, size_t size) {
+    snprintf(buf, size, "%.*s%s", (int)row->dirname_len, row->dirname, row->basename);
+}
+
+/* Читает 32-битное число в сетевом порядке байт */
+static uint32_t read_be32(const unsigned char *ptr) {
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) |
+           ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
+}
+
+/*
+ * Находит данные тега заданного типа без копирования
+ * Возвращает 0 при успехе, -1 если тега нет или он выходит за границы заголовка
+ */
+int pkglist_header_tag(const PkglistHeader *header, uint32_t tag, uint32_t type,
+                       const char **data, uint32_t *count, uint32_t *size) {
+    for (uint32_t i = 0; i < header->index_count; i++) {
+        const unsigned char *entry = header->index + i * 16;
+        if (read_be32(entry) != tag) {
+            continue;
+        }
+
+        uint32_t entry_type = read_be32(entry + 4);
+        uint32_t offset = read_be32(entry + 8);
+        uint32_t entry_count = read_be32(entry + 12);
+        if (entry_type != type || offset >= header->data_size) {
+            return -1;
+        }
+
+        const char *start = header->data + offset;
+        const char *end = header->data + header->data_size;
+        const char *ptr = start;
+        if (type == RPM_INT32_TYPE) {
+            if (entry_count > (header->data_size - offset) / 4) {
+                return -1;
+            }
+            ptr += (size_t)entry_count * 4;
+        } else {
+            // Строковые типы: count строк подряд, каждая завершена нулем
+            uint32_t strings = (type == RPM_STRING_TYPE) ? 1 : entry_count;
+            for (uint32_t n = 0; n < strings; n++) {
+                const char *nul = memchr(ptr, '\0', end - ptr);
+                if (nul == NULL) {
+                    return -1;
+                }
+                ptr = nul + 1;
+            }
+        }
+
+        *data = start;
+        *count = entry_count;
+        if (size != NULL) {
+            *size = (uint32_t)(ptr - start);
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Возвращает строковое значение тега (для массивов - первый элемент)
+ * или NULL, если тега нет или он поврежден
+ */
+const char *pkglist_header_string(const PkglistHeader *header, uint32_t tag) {
+    static const uint32_t types[] = { RPM_STRING_TYPE, RPM_I18NSTRING_TYPE, RPM_STRING_ARRAY_TYPE };
+    const char *data;
+    uint32_t count;
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (pkglist_header_tag(header, tag, types[i], &data, &count, NULL) == 0 && count > 0) {
+            return data;
+        }
+    }
+    return NULL;
+}
+
+/* Рабочий буфер каталогов для сжатого списка файлов */
+typedef struct {
+    const char **names;
+    uint32_t *lengths;
+    uint32_t cap;
+} DirTable;
+
+/*
+ * Обходит файлы одного заголовка
+ * Возвращает 1 если обход прерван колбэком, 0 если нет, -1 при нехватке памяти
+ */
+static int walk_header_files(const PkglistHeader *header, DirTable *dirs,
+                             PkglistRowFunc func, void *user_data) {
+    PkglistRow row;
+    row.package = pkglist_header_string(header, RPMTAG_NAME);
+    if (row.package == NULL) {
+        return 0;
+    }
+    row.summary = pkglist_header_string(header, RPMTAG_SUMMARY);
+    if (row.summary == NULL) {
+        row.summary = "";
+    }
+
+    const char *basenames, *dirnames, *dirindexes;
+    uint32_t base_count, dir_count, index_count;
+
+    if (pkglist_header_tag(header, RPMTAG_BASENAMES, RPM_STRING_ARRAY_TYPE, &basenames, &base_count, NULL) == 0 &&
+        pkglist_header_tag(header, RPMTAG_DIRNAMES, RPM_STRING_ARRAY_TYPE, &dirnames, &dir_count, NULL) == 0 &&
+        pkglist_header_tag(header, RPMTAG_DIRINDEXES, RPM_INT32_TYPE, &dirindexes, &index_count, NULL) == 0 &&
+        index_count == base_count) {
+        // Сжатый список: BASENAMES[i] лежит в DIRNAMES[DIRINDEXES[i]]
+        if (dir_count > dirs->cap) {
+            const char **names = realloc(dirs->names, dir_count * sizeof(*names));
+            if (names == NULL) {
+                return -1;
+            }
+            dirs->names = names;
+            uint32_t *lengths = realloc(dirs->lengths, dir_count * sizeof(*lengths));
+            if (lengths == NULL) {
+                return -1;
+            }
+            dirs->lengths = lengths;
+            dirs->cap = dir_count;
+        }
+        for (uint32_t i = 0; i < dir_count; i++) {
+            size_t len = strlen(dirnames);
+            dirs->names[i] = dirnames;
+            dirs->lengths[i] = (uint32_t)len;
+            dirnames += len + 1;
+        }
+
+        const char *base = basenames;
+        for (uint32_t i = 0; i < base_count; i++) {
+            uint32_t dir_index = read_be32((const unsigned char *)dirindexes + i * 4);
+            row.basename = base;
+            base += strlen(base) + 1;
+            if (dir_index >= dir_count) {
+                continue;
+            }
+            row.dirname = dirs->names[dir_index];
+            row.dirname_len = dirs->lengths[dir_index];
+            if (func(&row, user_data)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Старый формат: полные пути в OLDFILENAMES
+    const char *filenames;
+    uint32_t file_count;
+    if (pkglist_header_tag(header, RPMTAG_OLDFILENAMES, RPM_STRING_ARRAY_TYPE, &filenames, &file_count, NULL) == 0) {
+        const char *path = filenames;
+        for (uint32_t i = 0; i < file_count; i++) {
+            size_t len = strlen(path);
+            const char *slash = strrchr(path, '/');
+            if (slash != NULL) {
+                row.dirname = path;
+                row.dirname_len = slash + 1 - path;
+                row.basename = slash + 1;
+                if (func(&row, user_data)) {
+                    return 1;
+                }
+            }
+            path += len + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Разбирает заголовок, начинающийся с позиции pos
+ * Возвращает позицию следующего заголовка или 0, если заголовок поврежден
+ */
+static size_t parse_header(const PkglistMap *map, size_t pos, PkglistHeader *header) {
+    const unsigned char *bytes = map->map;
+    size_t size = map->size;
+
+    // Сигнатура необязательна: apt-rpm пишет заголовки как с ней, так и без нее
+    if (size - pos >= 8 && memcmp(bytes + pos, header_magic, sizeof(header_magic)) == 0) {
+        pos += 8;
+    }
+    if (size - pos < 8) {
+        return 0;
+    }
+
+    uint32_t index_count = read_be32(bytes + pos);
+    uint32_t data_size = read_be32(bytes + pos + 4);
+    if (index_count == 0 || index_count > HEADER_MAX_TAGS || data_size > HEADER_MAX_DATA ||
+        (uint64_t)index_count * 16 + data_size > size - pos - 8) {
+        return 0; // Поврежденный или неизвестный формат
+    }
+
+    header->index = bytes + pos + 8;
+    header->index_count = index_count;
+    header->data = (const char *)header->index + (size_t)index_count * 16;
+    header->data_size = data_size;
+    return pos + 8 + (size_t)index_count * 16 + data_size;
+}
+
+/*
+ * Отображает файл pkglist в память
+ * Возвращает 0 при успехе, -1 если файл недоступен или пуст
+ */
+int pkglist_map_open(const char *filepath, PkglistMap *map) {
+    map->map = NULL;
+    map->size = 0;
+
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return -1;
+    }
+    madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+    map->map = ptr;
+    map->size = st.st_size;
+    return 0;
+}
+
+/* Освобождает отображение файла pkglist */
+void pkglist_map_close(PkglistMap *map) {
+    if (map->map != NULL) {
+        munmap(map->map, map->size);
+    }
+    map->map = NULL;
+    map->size = 0;
+}
+
+/*
+ * Находит начало первого заголовка, расположенного не раньше target,
+ * двигаясь от известного начала заголовка start
+ * Возвращает размер файла, если такого заголовка нет или формат не распознан
+ */
+size_t pkglist_header_boundary(const PkglistMap *map, size_t start, size_t target) {
+    size_t pos = start;
+    while (pos < target && pos < map->size) {
+        PkglistHeader header;
+        size_t next = parse_header(map, pos, &header);
+        if (next == 0) {
+            return map->size;
+        }
+        pos = next;
+    }
+    return pos < map->size ? pos : map->size;
+}
+
+/* Колбэк обхода со счетчиком строк для статистики */
+typedef struct {
+    PkglistRowFunc func;
+    void *user_data;
+    uint64_t rows;
+} RowCounter;
+
+static int count_row(const PkglistRow *row, void *user_data) {
+    RowCounter *counter = user_data;
+    counter->rows++;
+    return counter->func(row, counter->user_data);
+}
+
+/*
+ * Обходит файлы пакетов из заголовков, начинающихся в диапазоне [start, end)
+ * start должен указывать на начало заголовка
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца,
+ * -1 если в диапазоне нет ни одного распознанного заголовка
+ */
+int pkglist_walk(const PkglistMap *map, size_t start, size_t end,
+                 PkglistRowFunc func, void *user_data) {
+    size_t pos = start;
+    int headers = 0;
+    int result = 0;
+    DirTable dirs = { NULL, NULL, 0 };
+
+    // Строки считаем через промежуточный колбэк только при сборе статистики
+    RowCounter counter = { func, user_data, 0 };
+    if (stats_enabled()) {
+        func = count_row;
+        user_data = &counter;
+    }
+
+    while (pos < end) {
+        PkglistHeader header;
+        size_t next = parse_header(map, pos, &header);
+        if (next == 0) {
+            break;
+        }
+        pos = next;
+        headers++;
+
+        result = walk_header_files(&header, &dirs, func, user_data);
+        if (result != 0) {
+            break;
+        }
+    }
+
+    free(dirs.names);
+    free(dirs.lengths);
+    stats_count(STATS_ROWS_PARSED, counter.rows);
+    stats_count(STATS_BYTES_READ, pos - start);
+
+    // Диапазон без единого распознанного заголовка считаем чужим форматом;
+    // после первого заголовка повторный обход через pkglist-query дал бы дубликаты
+    if (headers == 0) {
+        return -1;
+    }
+    return result < 0 ? 0 : result;
+}
+
+/*
+ * Обходит все файлы пакетов одного pkglist, разбирая заголовки RPM напрямую
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца,
+ * -1 если файл недоступен или не является набором заголовков RPM
+ */
+int pkglist_read_file(const char *filepath, PkglistRowFunc func, void *user_data) {
+    PkglistMap map;
+    if (pkglist_map_open(filepath, &map) != 0) {
+        return -1;
+    }
+
+    int result = pkglist_walk(&map, 0, map.size, func, user_data);
+    pkglist_map_close(&map);
+    return result;
+}
+
+/*
+ * Обходит все строки FILENAMES одного файла pkglist через pkglist-query
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца, -1 при ошибке
+ */
+int pkglist_query_file(const char *filepath, PkglistRowFunc func, void *user_data) {
+    // Формируем команду для запроса информации о пакете
+    char cmd[MAX_CMD_LEN];
+    int needed = snprintf(cmd, sizeof(cmd),
+             "pkglist-query \"[%%{FILENAMES}\\t%%{NAME}\\t%%{SUMMARY}\\n]\" \"%s\" 2>/dev/null",
+             filepath);
+
+    if (needed >= (int)sizeof(cmd)) {
+        return -1; // Пропускаем если команда слишком длинная
+    }
+
+    // Выполняем команду и читаем вывод
+    FILE *fp = popen(cmd, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    stats_count(STATS_SUBPROCESSES, 1);
+
+    int stopped = 0;
+    char line[MAX_CMD_LEN];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        stats_count(STATS_BYTES_READ, strlen(line));
+        stats_count(STATS_ROWS_PARSED, 1);
+
+        // Разбираем строку: путь, имя пакета, описание
+        char *path = strtok(line, "\t");
+        char *package = strtok(NULL, "\t");
+        char *description = strtok(NULL, "\n");
+
+        if (path != NULL && package != NULL && description != NULL) {
+            // Отделяем имя файла от каталога
+            char *filename = strrchr(path, '/');
+            if (filename == NULL) {
+                continue;
+            }
+
+            PkglistRow row = { path, filename + 1 - path, filename + 1, package, description };
+            if (func(&row, user_data)) {
+                stopped = 1;
+                break;
+            }
+        }
+    }
+    pclose(fp);
+
+    return stopped;
+}
+
+/*
+ * Обходит файл pkglist встроенным разборщиком,
+ * а если формат не распознан - через pkglist-query
+ */
+int pkglist_scan_file(const char *filepath, PkglistRowFunc func, void *user_data) {
+    int result = pkglist_read_file(filepath, func, user_data);
+    if (result < 0) {
+        result = pkglist_query_file(filepath, func, user_data);
+    }
+    return result;
+}
@@ -0,0 +1,117 @@
+#ifndef CNF_PKGLIST_H
+#define CNF_PKGLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Теги заголовка RPM, используемые при поиске */
+#define RPMTAG_NAME          1000
+#define RPMTAG_SUMMARY       1004
+#define RPMTAG_OLDFILENAMES  1027
+#define RPMTAG_DIRINDEXES    1116
+#define RPMTAG_BASENAMES     1117
+#define RPMTAG_DIRNAMES      1118
+
+/* Типы данных заголовка RPM */
+#define RPM_INT32_TYPE         4
+#define RPM_STRING_TYPE        6
+#define RPM_STRING_ARRAY_TYPE  8
+#define RPM_I18NSTRING_TYPE    9
+
+/*
+ * Строка pkglist: один файл пакета
+ * Все указатели ссылаются на данные источника и действительны только внутри колбэка
+ */
+typedef struct {
+    const char *dirname;   // Каталог файла с завершающим '/', не завершен нулем
+    size_t dirname_len;    // Длина каталога
+    const char *basename;  // Имя файла
+    const char *package;   // Имя пакета
+    const char *summary;   // Описание пакета
+} PkglistRow;
+
+/*
+ * Колбэк для обхода строк pkglist
+ * Ненулевое возвращаемое значение прерывает обход.
+ */
+typedef int (*PkglistRowFunc)(const PkglistRow *row, void *user_data);
+
+/* Заголовок RPM внутри отображенного файла pkglist */
+typedef struct {
+    const unsigned char *index;  // Таблица тегов (по 16 байт на тег)
+    uint32_t index_count;        // Количество тегов
+    const char *data;            // Область данных
+    uint32_t data_size;          // Размер области данных
+} PkglistHeader;
+
+/* Файл pkglist, отображенный в память */
+typedef struct {
+    void *map;    // Начало отображения
+    size_t size;  // Размер файла
+} PkglistMap;
+
+/* Проверяет, является ли файл каталога apt списком пакетов */
+int is_pkglist_file(const char *name);
+
+/* Собирает полный путь файла строки pkglist в буфер */
+void pkglist_row_path(const PkglistRow *row, char *buf, size_t size);
+
+/*
+ * Возвращает строковое значение тега (для массивов - первый элемент)
+ * или NULL, если тега нет или он поврежден
+ */
+const char *pkglist_header_string(const PkglistHeader *header, uint32_t tag);
+
+/*
+ * Находит данные тега заданного типа без копирования
+ * Возвращает 0 при успехе, -1 если тега нет или он выходит за границы заголовка
+ */
+int pkglist_header_tag(const PkglistHeader *header, uint32_t tag, uint32_t type,
+                       const char **data, uint32_t *count, uint32_t *size);
+
+/*
+ * Отображает файл pkglist в память
+ * Возвращает 0 при успехе, -1 если файл недоступен или пуст
+ */
+int pkglist_map_open(const char *filepath, PkglistMap *map);
+
+/* Освобождает отображение файла pkglist */
+void pkglist_map_close(PkglistMap *map);
+
+/*
+ * Находит начало первого заголовка, расположенного не раньше target,
+ * двигаясь от известного начала заголовка start
+ * Позволяет делить большой файл на независимо обходимые части
+ * Возвращает размер файла, если такого заголовка нет или формат не распознан
+ */
+size_t pkglist_header_boundary(const PkglistMap *map, size_t start, size_t target);
+
+/*
+ * Обходит файлы пакетов из заголовков, начинающихся в диапазоне [start, end)
+ * start должен указывать на начало заголовка
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца,
+ * -1 если в диапазоне нет ни одного распознанного заголовка
+ */
+int pkglist_walk(const PkglistMap *map, size_t start, size_t end,
+                 PkglistRowFunc func, void *user_data);
+
+/*
+ * Обходит все файлы пакетов одного pkglist, разбирая заголовки RPM напрямую
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца,
+ * -1 если файл недоступен или не является набором заголовков RPM
+ */
+int pkglist_read_file(const char *filepath, PkglistRowFunc func, void *user_data);
+
+/*
+ * Обходит все строки FILENAMES одного файла pkglist через pkglist-query
+ * Возвращает 1 если обход прерван колбэком, 0 если дошли до конца, -1 при ошибке
+ */
+int pkglist_query_file(const char *filepath, PkglistRowFunc func, void *user_data);
+
+/*
+ * Обходит файл pkglist встроенным разборщиком,
+ * а если формат не распознан - через pkglist-query
+ */
+int pkglist_scan_file(const char *filepath, PkglistRowFunc func, void *user_data);
+
+#endif /* CNF_PKGLIST_H */
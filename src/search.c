@@ -0,0 +1,991 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "search.h"
+#include "pkglist.h"
+#include "index.h"
+#include "arena.h"
+#include "stats.h"
+#include "util.h"
+
+/* Сравнивает имена пакетов: сначала по длине, затем по алфавиту */
+static int compare_names(const char *a, const char *b) {
+    size_t len_a = strlen(a);
+    size_t len_b = strlen(b);
+
+    // Сначала сравниваем по длине имени
+    if (len_a != len_b) {
+        return len_a < len_b ? -1 : 1;
+    }
+
+    // При равной длине - по алфавиту
+    return strcmp(a, b);
+}
+
+/* 
+ * Функция сравнения для qsort
+ * Сравнивает пакеты по длине имени, затем по алфавиту
+ */
+int compare_package_by_name_length(const void *a, const void *b) {
+    const PackageInfo *pkg_a = (const PackageInfo *)a;
+    const PackageInfo *pkg_b = (const PackageInfo *)b;
+    return compare_names(pkg_a->package_name, pkg_b->package_name);
+}
+
+/*
+ * Найденный пакет до сборки PackageInfo
+ * Строки указывают в источник (отображение pkglist, индекс) или в арену
+ * единицы; путь хранится частями и собирается только для ответа
+ */
+typedef struct {
+    const char *package_name;  // Имя пакета
+    const char *description;   // Описание пакета
+    const char *dirname;       // Каталог файла с завершающим '/', не завершен нулем (NULL - нет)
+    size_t dirname_len;        // Длина каталога
+    const char *basename;      // Имя файла или весь путь, если каталога нет
+} Candidate;
+
+/* Кандидат из строки pkglist; строки остаются в источнике строки */
+static Candidate candidate_from_row(const PkglistRow *row) {
+    Candidate candidate = { row->package, row->summary, row->dirname, row->dirname_len, row->basename };
+    return candidate;
+}
+
+/* Копирует строку в арену и учитывает копию в статистике */
+static char *copy_string(Arena *arena, const char *str, size_t len) {
+    stats_count(STATS_COPIES, 1);
+    stats_count(STATS_BYTES_COPIED, len + 1);
+    return arena_strndup(arena, str, len);
+}
+
+/* Собирает путь кандидата; путь без каталога не копируется */
+static const char *candidate_path(const Candidate *candidate, Arena *arena) {
+    if (candidate->dirname == NULL) {
+        return candidate->basename;
+    }
+    size_t base_len = strlen(candidate->basename);
+    char *path = copy_string(arena, candidate->dirname, candidate->dirname_len + base_len);
+    if (path != NULL) {
+        memcpy(path + candidate->dirname_len, candidate->basename, base_len + 1);
+    }
+    return path;
+}
+
+/*
+ * Переносит строки кандидата в арену: источник строки pkglist-query
+ * живет только до следующей строки
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+static int candidate_keep(Candidate *candidate, Arena *arena) {
+    const char *path = candidate_path(candidate, arena);
+    const char *name = copy_string(arena, candidate->package_name, strlen(candidate->package_name));
+    const char *description = copy_string(arena, candidate->description, strlen(candidate->description));
+    if (path == NULL || name == NULL || description == NULL) {
+        return -1;
+    }
+    candidate->package_name = name;
+    candidate->description = description;
+    candidate->dirname = NULL;
+    candidate->dirname_len = 0;
+    candidate->basename = path;
+    return 0;
+}
+
+/*
+ * Заполняет PackageInfo ответа; копируется только путь, собираемый из частей
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+static int candidate_finish(const Candidate *candidate, Arena *arena, PackageInfo *info) {
+    info->package_name = candidate->package_name;
+    info->description = candidate->description;
+    info->binary_path = candidate_path(candidate, arena);
+    return info->binary_path != NULL ? 0 : -1;
+}
+
+/*
+ * Набор лучших пакетов с похожими именами
+ * Куча хранит номера записей, в корне худший по compare_package_by_name_length;
+ * записи не перемещаются, поэтому хеш-таблица имен ссылается на них по номеру
+ * Без ограничения limit набор принимает все подходящие пакеты
+ */
+typedef struct {
+    Candidate *items;    // Записи
+    int *heap;           // Номера записей в порядке кучи
+    int count;           // Количество принятых пакетов
+    int cap;             // Выделено записей
+    int limit;           // Наибольшее количество пакетов (0 - без ограничения)
+    int *slots;          // Хеш-таблица: номер записи + 1, 0 - пусто
+    size_t slot_count;   // Размер таблицы, степень двойки, больше 2 * count
+} SimilarTop;
+
+/* Хеш FNV-1a */
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Инициализирует пустой набор лучших пакетов */
+static void similar_top_init(SimilarTop *top, int limit) {
+    memset(top, 0, sizeof(*top));
+    top->limit = limit > 0 ? limit : 0;
+}
+
+/* Освобождает набор лучших пакетов */
+static void similar_top_free(SimilarTop *top) {
+    free(top->items);
+    free(top->heap);
+    free(top->slots);
+    similar_top_init(top, top->limit);
+}
+
+/* Находит ячейку хеш-таблицы с именем или пустую ячейку, где оно должно быть */
+static size_t similar_top_slot(const SimilarTop *top, const char *name) {
+    size_t mask = top->slot_count - 1;
+    size_t pos = hash_name(name) & mask;
+    while (top->slots[pos] != 0 && strcmp(top->items[top->slots[pos] - 1].package_name, name) != 0) {
+        pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+/* Удаляет имя из хеш-таблицы со сдвигом следующих ячеек цепочки */
+static void similar_top_unlink(SimilarTop *top, const char *name) {
+    size_t mask = top->slot_count - 1;
+    size_t hole = similar_top_slot(top, name);
+    if (top->slots[hole] == 0) {
+        return;
+    }
+    top->slots[hole] = 0;
+
+    size_t pos = hole;
+    for (;;) {
+        pos = (pos + 1) & mask;
+        if (top->slots[pos] == 0) {
+            break;
+        }
+        // Ячейку можно перенести в дыру, если дыра лежит на пути от ее исходной позиции
+        size_t home = hash_name(top->items[top->slots[pos] - 1].package_name) & mask;
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            top->slots[hole] = top->slots[pos];
+            top->slots[pos] = 0;
+            hole = pos;
+        }
+    }
+}
+
+/*
+ * Готовит место для еще одной записи: расширяет массивы и хеш-таблицу
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+static int similar_top_reserve(SimilarTop *top) {
+    if (top->count == top->cap) {
+        int new_cap = top->cap ? top->cap * 2 : 16;
+        if (top->limit > 0 && new_cap > top->limit) {
+            new_cap = top->limit;
+        }
+        Candidate *items = realloc(top->items, new_cap * sizeof(Candidate));
+        if (items == NULL) {
+            return -1;
+        }
+        top->items = items;
+        int *heap = realloc(top->heap, new_cap * sizeof(int));
+        if (heap == NULL) {
+            return -1;
+        }
+        top->heap = heap;
+        top->cap = new_cap;
+    }
+
+    if ((size_t)(top->count + 1) * 2 <= top->slot_count) {
+        return 0;
+    }
+    size_t slot_count = top->slot_count ? top->slot_count * 2 : 32;
+    int *slots = calloc(slot_count, sizeof(int));
+    if (slots == NULL) {
+        return -1;
+    }
+    free(top->slots);
+    top->slots = slots;
+    top->slot_count = slot_count;
+    for (int item = 0; item < top->count; item++) {
+        top->slots[similar_top_slot(top, top->items[item].package_name)] = item + 1;
+    }
+    return 0;
+}
+
+/* Сравнивает элементы кучи: худший пакет должен оказаться в корне */
+static int similar_top_worse(const SimilarTop *top, int a, int b) {
+    return compare_names(top->items[top->heap[a]].package_name, top->items[top->heap[b]].package_name) > 0;
+}
+
+/* Восстанавливает кучу, опуская элемент из позиции pos */
+static void similar_top_sift_down(SimilarTop *top, int pos) {
+    for (;;) {
+        int worst = pos;
+        int left = 2 * pos + 1;
+        int right = left + 1;
+        if (left < top->count && similar_top_worse(top, left, worst)) {
+            worst = left;
+        }
+        if (right < top->count && similar_top_worse(top, right, worst)) {
+            worst = right;
+        }
+        if (worst == pos) {
+            break;
+        }
+        int tmp = top->heap[pos]; top->heap[pos] = top->heap[worst]; top->heap[worst] = tmp;
+        pos = worst;
+    }
+}
+
+/* Восстанавливает кучу, поднимая элемент из позиции pos */
+static void similar_top_sift_up(SimilarTop *top, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!similar_top_worse(top, pos, parent)) {
+            break;
+        }
+        int tmp = top->heap[pos]; top->heap[pos] = top->heap[parent]; top->heap[parent] = tmp;
+        pos = parent;
+    }
+}
+
+/*
+ * Предлагает пакет в набор лучших; строки кандидата не копируются
+ * Повторы отсекаются хеш-таблицей: уже вытесненное имя хуже корня
+ * кучи и не пройдет снова, поэтому хранить нужно только текущие имена
+ * Возвращает принятую запись или NULL, если пакет не принят
+ */
+static Candidate *similar_top_offer(SimilarTop *top, const Candidate *candidate) {
+    int item;
+    if (top->limit == 0 || top->count < top->limit) {
+        if (top->slot_count > 0 && top->slots[similar_top_slot(top, candidate->package_name)] != 0) {
+            return NULL;
+        }
+        if (similar_top_reserve(top) != 0) {
+            return NULL;
+        }
+        item = top->count;
+        top->heap[top->count++] = item;
+        top->items[item] = *candidate;
+        similar_top_sift_up(top, top->count - 1);
+    } else {
+        // Набор полон: новый пакет должен быть лучше худшего из принятых
+        item = top->heap[0];
+        if (compare_names(candidate->package_name, top->items[item].package_name) >= 0 ||
+            top->slots[similar_top_slot(top, candidate->package_name)] != 0) {
+            return NULL;
+        }
+        similar_top_unlink(top, top->items[item].package_name);
+        top->items[item] = *candidate;
+        similar_top_sift_down(top, 0);
+    }
+
+    top->slots[similar_top_slot(top, top->items[item].package_name)] = item + 1;
+    return &top->items[item];
+}
+
+/*
+ * Таблица имен пакетного поиска: открытая адресация по хешу имени
+ * Повторяющиеся имена занимают одну ячейку
+ */
+typedef struct {
+    const char *const *names;  // Имена команд запроса
+    int *slots;                // Номер имени или -1
+    size_t mask;               // Размер таблицы - 1 (степень двойки)
+} BatchTable;
+
+/* Находит ячейку таблицы с именем или пустую ячейку, где оно должно быть */
+static size_t batch_table_slot(const BatchTable *table, const char *name) {
+    size_t pos = hash_name(name) & table->mask;
+    while (table->slots[pos] >= 0 && strcmp(table->names[table->slots[pos]], name) != 0) {
+        pos = (pos + 1) & table->mask;
+    }
+    return pos;
+}
+
+/*
+ * Заполняет таблицу именами; canonical[i] получает номер первого
+ * вхождения имени names[i]
+ * Возвращает 0 при успехе, -1 при нехватке памяти
+ */
+static int batch_table_init(BatchTable *table, const char *const *names, int count, int *canonical) {
+    size_t size = 16;
+    while (size < (size_t)count * 2) {
+        size *= 2;
+    }
+    table->names = names;
+    table->mask = size - 1;
+    table->slots = malloc(size * sizeof(int));
+    if (table->slots == NULL) {
+        return -1;
+    }
+    memset(table->slots, 0xff, size * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        size_t pos = batch_table_slot(table, names[i]);
+        if (table->slots[pos] < 0) {
+            table->slots[pos] = i;
+        }
+        canonical[i] = table->slots[pos];
+    }
+    return 0;
+}
+
+/* Пакет, найденный в единице работы для одного имени пакетного поиска */
+typedef struct {
+    int name;           // Номер имени в запросе
+    Candidate package;  // Первый пакет единицы с этой командой
+} BatchHit;
+
+/*
+ * Единица работы: файл pkglist или часть большого файла
+ * Каждая единица копит свои результаты, объединение идет в порядке единиц
+ */
+typedef struct {
+    char filepath[MAX_PATH_LEN];  // Путь к файлу pkglist
+    int map_index;                // Отображение файла в ScanJob (-1 - только pkglist-query)
+    size_t start;                 // Начало диапазона заголовков
+    size_t end;                   // Конец диапазона заголовков
+    int whole_file;               // Диапазон покрывает весь файл
+    int exact_name;               // Лучшее найденное имя команды (-1 - не найдено)
+    Candidate exact;              // Пакет с командой
+    SimilarTop similar;           // Лучшие пакеты с похожими именами
+    TypoResults typos;            // Похожие имена команд
+    Arena arena;                  // Копии строк pkglist-query, которые живут только до следующей строки
+    BatchHit *hits;               // Найденные имена пакетного поиска
+    int hit_count;
+    int hit_cap;
+    unsigned char *hit_seen;      // Имена, уже найденные в этой единице
+} ScanUnit;
+
+/* Общее состояние параллельного сканирования */
+typedef struct {
+    const char *names[SEARCH_MAX_NAMES];  // Варианты имени команды в порядке предпочтения
+    int name_count;            // 0, если точный ответ уже известен
+    const char *pattern;       // NULL, если похожие не нужны
+    const TypoPattern *typo_pattern;  // NULL, если варианты исправления не нужны
+    int stop_on_exact;         // Прекратить обход после точного совпадения
+    ScanUnit *units;
+    int unit_count;
+    PkglistMap *maps;          // Отображения файлов, общие для их частей
+    int map_count;
+    atomic_int next_unit;      // Следующая необработанная единица
+    atomic_int exact_key;      // Лучшее совпадение: номер имени * unit_count + номер единицы
+    int64_t deadline_ns;       // Срок обхода (0 - без ограничения)
+    atomic_int cancelled;      // Срок истек, все потоки прекращают обход
+    const BatchTable *batch;   // Пакетный поиск вместо names и pattern (NULL - нет)
+    int batch_count;           // Количество имен пакетного поиска
+    int similar_limit;         // Наибольшее количество похожих пакетов (0 - без ограничения)
+} ScanJob;
+
+/* Состояние обхода одной единицы */
+typedef struct {
+    ScanJob *job;
+    ScanUnit *unit;
+    int unit_index;
+    unsigned rows;             // Строки с последней проверки срока
+    int transient;             // Строки источника временные (pkglist-query) и копируются в арену единицы
+} ScanState;
+
+/* Проверяет, можно ли прекратить обход единицы */
+static int scan_complete(const ScanState *state) {
+    ScanJob *job = state->job;
+    const ScanUnit *unit = state->unit;
+
+    if (atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+        return 1;
+    }
+    // Пакетному поиску нужны все единицы целиком
+    if (job->batch != NULL) {
+        return 0;
+    }
+
+    // Совпадение основного имени в более ранней единице делает эту единицу ненужной;
+    // такой ключ меньше номера единицы только для имени с номером 0
+    if (job->stop_on_exact && state->unit_index > atomic_load_explicit(&job->exact_key, memory_order_relaxed)) {
+        return 1;
+    }
+    if (unit->exact_name == 0 && job->stop_on_exact) {
+        return 1;
+    }
+
+    // Лучшие похожие пакеты известны только после обхода всей единицы
+    int exact_done = job->name_count == 0 || unit->exact_name == 0;
+    int similar_done = job->pattern == NULL;
+    return exact_done && similar_done;
+}
+
+/* Запоминает первый в единице пакет для имени пакетного поиска */
+static void batch_match_row(ScanState *state, const PkglistRow *row) {
+    ScanJob *job = state->job;
+    ScanUnit *unit = state->unit;
+    const BatchTable *table = job->batch;
+    int name = table->slots[batch_table_slot(table, row->basename)];
+    if (name < 0) {
+        return;
+    }
+    if (unit->hit_seen == NULL) {
+        unit->hit_seen = calloc(job->batch_count, 1);
+        if (unit->hit_seen == NULL) {
+            return;
+        }
+    }
+    if (unit->hit_seen[name]) {
+        return;
+    }
+    if (unit->hit_count == unit->hit_cap) {
+        int new_cap = unit->hit_cap ? unit->hit_cap * 2 : 16;
+        BatchHit *hits = realloc(unit->hits, new_cap * sizeof(BatchHit));
+        if (hits == NULL) {
+            return;
+        }
+        unit->hits = hits;
+        unit->hit_cap = new_cap;
+    }
+    BatchHit *hit = &unit->hits[unit->hit_count];
+    hit->name = name;
+    hit->package = candidate_from_row(row);
+    if (state->transient && candidate_keep(&hit->package, &unit->arena) != 0) {
+        return;
+    }
+    unit->hit_count++;
+    unit->hit_seen[name] = 1;
+}
+
+/* Проверяет строку на точное совпадение с командой и похожие имена пакетов */
+static void match_row(ScanState *state, const PkglistRow *row) {
+    ScanJob *job = state->job;
+    ScanUnit *unit = state->unit;
+
+    // Точное совпадение имени файла с командой или с более предпочтительным
+    // вариантом, чем уже найденный в этой единице
+    int limit = unit->exact_name < 0 ? job->name_count : unit->exact_name;
+    for (int i = 0; i < limit; i++) {
+        if (strcmp(row->basename, job->names[i]) != 0) {
+            continue;
+        }
+        Candidate exact = candidate_from_row(row);
+        if (state->transient && candidate_keep(&exact, &unit->arena) != 0) {
+            break;
+        }
+        unit->exact = exact;
+        unit->exact_name = i;
+
+        // Сообщаем остальным потокам, что более поздние единицы не нужны
+        int key = i * job->unit_count + state->unit_index;
+        int current = atomic_load(&job->exact_key);
+        while (key < current &&
+               !atomic_compare_exchange_weak(&job->exact_key, &current, key)) {
+        }
+        break;
+    }
+
+    // Пакеты, содержащие pattern в имени
+    if (job->pattern != NULL && strstr(row->package, job->pattern) != NULL) {
+        Candidate candidate = candidate_from_row(row);
+        Candidate *kept = similar_top_offer(&unit->similar, &candidate);
+        if (kept != NULL && state->transient) {
+            candidate_keep(kept, &unit->arena);
+        }
+    }
+
+    // Имена команд из каталогов bin/sbin - варианты исправления на случай,
+    // если дерева опечаток нет или оно построено по старому индексу
+    if (job->typo_pattern != NULL && row->dirname_len >= 4 &&
+        memcmp(row->dirname + row->dirname_len - 4, "bin/", 4) == 0) {
+        typo_check_name(job->typo_pattern, &unit->typos, row->basename, row->package);
+    }
+}
+
+/* Колбэк обхода pkglist: проверяет все классы кандидатов в одной строке */
+static int scan_row(const PkglistRow *row, void *user_data) {
+    ScanState *state = user_data;
+    ScanJob *job = state->job;
+
+    if (job->batch != NULL) {
+        batch_match_row(state, row);
+    } else {
+        match_row(state, row);
+    }
+
+    // Часы опрашиваются не на каждой строке
+    if (job->deadline_ns != 0 && ++state->rows == SEARCH_DEADLINE_ROWS) {
+        state->rows = 0;
+        if (monotonic_ns() >= job->deadline_ns) {
+            atomic_store_explicit(&job->cancelled, 1, memory_order_relaxed);
+        }
+    }
+
+    return scan_complete(state);
+}
+
+/* Обходит одну единицу работы */
+static void scan_unit(ScanJob *job, int unit_index) {
+    ScanUnit *unit = &job->units[unit_index];
+    ScanState state = { job, unit, unit_index, 0, 0 };
+
+    if (scan_complete(&state)) {
+        return;
+    }
+
+    // Строки отображенного файла живут вместе с отображением
+    int result = -1;
+    if (unit->map_index >= 0) {
+        result = pkglist_walk(&job->maps[unit->map_index], unit->start, unit->end, scan_row, &state);
+    }
+    // Нераспознанный формат читаем через pkglist-query целиком
+    if (result < 0 && unit->whole_file) {
+        state.transient = 1;
+        pkglist_query_file(unit->filepath, scan_row, &state);
+    }
+}
+
+/* Поток сканирования: забирает единицы работы по порядку */
+static void *scan_worker(void *arg) {
+    ScanJob *job = arg;
+
+    while (!atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+        int unit_index = atomic_fetch_add(&job->next_unit, 1);
+        if (unit_index >= job->unit_count) {
+            break;
+        }
+        scan_unit(job, unit_index);
+    }
+    return NULL;
+}
+
+/* Определяет число потоков сканирования */
+static int scan_thread_count(int requested) {
+    if (requested <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cpus > 0 ? (int)cpus : 1;
+    }
+    return requested > SEARCH_MAX_THREADS ? SEARCH_MAX_THREADS : requested;
+}
+
+/* Добавляет единицу работы в задание */
+static ScanUnit *job_add_unit(ScanJob *job, int *cap) {
+    if (job->unit_count == *cap) {
+        int new_cap = *cap ? *cap * 2 : 16;
+        ScanUnit *units = realloc(job->units, new_cap * sizeof(ScanUnit));
+        if (units == NULL) {
+            return NULL;
+        }
+        job->units = units;
+        *cap = new_cap;
+    }
+    ScanUnit *unit = &job->units[job->unit_count++];
+    memset(unit, 0, sizeof(*unit));
+    unit->exact_name = -1;
+    similar_top_init(&unit->similar, job->similar_limit);
+    arena_init(&unit->arena);
+    typo_results_init(&unit->typos, TYPO_MAX_SUGGESTIONS,
+                      job->typo_pattern != NULL ? typo_max_distance(job->typo_pattern->length) : 0);
+    return unit;
+}
+
+/*
+ * Составляет список единиц работы в порядке каталога
+ * Большие файлы при нескольких потоках делятся по границам заголовков
+ */
+static int job_collect_units(ScanJob *job, const char *pkglist_dir, int threads) {
+    DIR *dir = opendir(pkglist_dir);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    int unit_cap = 0;
+    int map_cap = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_pkglist_file(entry->d_name)) {
+            continue;
+        }
+
+        char filepath[MAX_PATH_LEN];
+        snprintf(filepath, sizeof(filepath), "%s/%s", pkglist_dir, entry->d_name);
+
+        if (job->map_count == map_cap) {
+            int new_cap = map_cap ? map_cap * 2 : 16;
+            PkglistMap *maps = realloc(job->maps, new_cap * sizeof(PkglistMap));
+            if (maps == NULL) {
+                break;
+            }
+            job->maps = maps;
+            map_cap = new_cap;
+        }
+        int map_index = -1;
+        PkglistMap *map = &job->maps[job->map_count];
+        if (pkglist_map_open(filepath, map) == 0) {
+            map_index = job->map_count++;
+        } else {
+            map = NULL;
+        }
+
+        // Число частей файла: не больше числа потоков и не мельче SEARCH_CHUNK_SIZE
+        size_t chunks = 1;
+        if (map != NULL && threads > 1 && map->size >= 2 * (size_t)SEARCH_CHUNK_SIZE) {
+            chunks = map->size / SEARCH_CHUNK_SIZE;
+            if (chunks > (size_t)threads) {
+                chunks = threads;
+            }
+        }
+
+        size_t start = 0;
+        for (size_t i = 0; i < chunks; i++) {
+            size_t end = (i + 1 == chunks) ? (map != NULL ? map->size : 0)
+                                           : pkglist_header_boundary(map, start, map->size / chunks * (i + 1));
+            if (i > 0 && start >= end) {
+                break;
+            }
+
+            ScanUnit *unit = job_add_unit(job, &unit_cap);
+            if (unit == NULL) {
+                break;
+            }
+            snprintf(unit->filepath, sizeof(unit->filepath), "%s", filepath);
+            unit->map_index = map_index;
+            unit->start = start;
+            unit->end = end;
+            unit->whole_file = (chunks == 1);
+            start = end;
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+/*
+ * Объединяет результаты единиц в порядке каталога
+ * Повторяющийся в нескольких репозиториях пакет берется из первого
+ */
+static void job_merge(ScanJob *job, SimilarTop *similar, SearchResult *result) {
+    int exact_key = atomic_load(&job->exact_key);
+    int exact_unit = INT_MAX;
+    if (job->name_count > 0 && exact_key != INT_MAX) {
+        exact_unit = exact_key % job->unit_count;
+        if (candidate_finish(&job->units[exact_unit].exact, &result->arena, &result->exact) == 0) {
+            result->exact_index = exact_key / job->unit_count;
+            result->found = 1;
+        }
+    }
+
+    for (int i = 0; i < job->unit_count; i++) {
+        // После точного совпадения последовательный обход остановился бы
+        if (job->stop_on_exact && i > exact_unit) {
+            break;
+        }
+
+        const SimilarTop *top = &job->units[i].similar;
+        for (int j = 0; j < top->count; j++) {
+            similar_top_offer(similar, &top->items[top->heap[j]]);
+        }
+    }
+
+    // Одно имя в нескольких пакетах предлагается с первым по порядку каталога
+    for (int i = 0; i < job->unit_count; i++) {
+        const TypoResults *typos = &job->units[i].typos;
+        for (int j = 0; j < typos->count; j++) {
+            typo_results_offer(&result->typos, typos->items[j].name, typos->items[j].package,
+                               typos->items[j].distance);
+        }
+    }
+}
+
+/*
+ * Обходит все единицы работы каталога pkglist_dir
+ * Возвращает 0 при успехе, -1 если каталог недоступен
+ */
+static int job_run(ScanJob *job, const char *pkglist_dir, int requested_threads) {
+    int threads = scan_thread_count(requested_threads);
+    if (job->deadline_ns != 0 && monotonic_ns() >= job->deadline_ns) {
+        atomic_store(&job->cancelled, 1);
+    }
+
+    if (job_collect_units(job, pkglist_dir, threads) != 0) {
+        return -1;
+    }
+    if (threads > job->unit_count) {
+        threads = job->unit_count;
+    }
+
+    pthread_t workers[SEARCH_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, scan_worker, job) == 0) {
+            started++;
+        }
+    }
+    // Текущий поток тоже сканирует; при одном потоке обход последовательный
+    scan_worker(job);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    return 0;
+}
+
+/* Отображения файлов pkglist, переданные арене результата */
+typedef struct {
+    PkglistMap *maps;
+    int count;
+} MapSet;
+
+/* Закрывает отображения, переданные арене */
+static void release_maps(void *resource) {
+    MapSet *set = resource;
+    for (int i = 0; i < set->count; i++) {
+        pkglist_map_close(&set->maps[i]);
+    }
+    free(set->maps);
+}
+
+/*
+ * Передает арене результата отображения файлов и арены единиц,
+ * на которые ссылаются найденные пакеты
+ * Возвращает 0 при успехе, -1 при нехватке памяти (задание не изменено)
+ */
+static int job_keep(ScanJob *job, Arena *arena) {
+    if (job->map_count > 0) {
+        MapSet *set = arena_alloc(arena, sizeof(MapSet));
+        if (set == NULL || arena_defer(arena, release_maps, set) != 0) {
+            return -1;
+        }
+        set->maps = job->maps;
+        set->count = job->map_count;
+        job->maps = NULL;
+        job->map_count = 0;
+    }
+    for (int i = 0; i < job->unit_count; i++) {
+        arena_adopt(arena, &job->units[i].arena);
+    }
+    return 0;
+}
+
+/* Освобождает единицы работы и отображения файлов, не переданные результату */
+static void job_free(ScanJob *job) {
+    for (int i = 0; i < job->unit_count; i++) {
+        similar_top_free(&job->units[i].similar);
+        free(job->units[i].hits);
+        free(job->units[i].hit_seen);
+        arena_free(&job->units[i].arena);
+    }
+    free(job->units);
+    for (int i = 0; i < job->map_count; i++) {
+        pkglist_map_close(&job->maps[i]);
+    }
+    free(job->maps);
+}
+
+/* Закрывает индекс, переданный арене */
+static void release_index(void *resource) {
+    index_close(resource);
+}
+
+/*
+ * Открывает индекс на время жизни арены
+ * Возвращает индекс или NULL, если он не актуален
+ */
+static const CommandIndex *open_index(Arena *arena, const char *index_path, const char *pkglist_dir) {
+    CommandIndex *index = arena_alloc(arena, sizeof(CommandIndex));
+    if (index == NULL || index_open(index, index_path, pkglist_dir) != 0) {
+        return NULL;
+    }
+    if (arena_defer(arena, release_index, index) != 0) {
+        index_close(index);
+        return NULL;
+    }
+    return index;
+}
+
+/* Колбэк перебора пакетов индекса: предлагает пакет в набор лучших */
+static int offer_index_package(const char *name, const char *summary, void *user_data) {
+    Candidate candidate = { name, summary, NULL, 0, "" };
+    similar_top_offer(user_data, &candidate);
+    return 0;
+}
+
+/*
+ * Ищет пакет с командой и пакеты с похожими именами за один проход по базе
+ * Варианты имени команды проверяются тем же проходом; если найдено несколько,
+ * выбирается первый по порядку предпочтения
+ * Если индекс актуален, оба ответа берутся из него
+ * Файлы pkglist сканируются параллельно, результат совпадает с последовательным
+ * обходом в порядке каталога; похожие пакеты - первые similar_limit
+ * из всех подходящих по compare_package_by_name_length, без повторов
+ * Строки ответа не копируются: отображения файлов и индекса переходят
+ * в арену результата
+ * Если задан typo_pattern, в typos собираются похожие имена команд из
+ * просмотренных строк; при промахе без актуального индекса просмотрены все
+ * Возвращает 1 если пакет с командой найден, 0 если нет
+ */
+int search_packages(const SearchQuery *query, SearchResult *result) {
+    result->found = 0;
+    result->exact_index = 0;
+    result->similar = NULL;
+    result->similar_count = 0;
+    typo_results_init(&result->typos, TYPO_MAX_SUGGESTIONS,
+                      query->typo_pattern != NULL ? typo_max_distance(query->typo_pattern->length) : 0);
+    result->truncated = 0;
+    arena_init(&result->arena);
+
+    ScanJob job;
+    memset(&job, 0, sizeof(job));
+    if (query->command_name != NULL) {
+        job.names[job.name_count++] = query->command_name;
+        for (int i = 0; i < query->alternative_count && job.name_count < SEARCH_MAX_NAMES; i++) {
+            job.names[job.name_count++] = query->alternatives[i];
+        }
+    }
+    job.pattern = query->pattern;
+    job.typo_pattern = result->typos.max_distance > 0 ? query->typo_pattern : NULL;
+    job.stop_on_exact = query->similar_on_miss_only;
+    atomic_init(&job.next_unit, 0);
+    atomic_init(&job.exact_key, INT_MAX);
+    job.deadline_ns = query->deadline_ns;
+    atomic_init(&job.cancelled, 0);
+    job.similar_limit = query->similar_limit;
+
+    SimilarTop similar;
+    similar_top_init(&similar, query->similar_limit);
+
+    // Актуальный индекс дает окончательный ответ на оба запроса;
+    // похожие имена находятся по триграммам без обхода всех пакетов
+    const CommandIndex *index = query->index;
+    if (index == NULL && (job.name_count > 0 || query->pattern != NULL) && query->index_path != NULL) {
+        index = open_index(&result->arena, query->index_path, query->pkglist_dir);
+    }
+    if (index != NULL) {
+        for (int i = 0; i < job.name_count; i++) {
+            if (index_lookup(index, job.names[i], &result->arena, &result->exact)) {
+                result->found = 1;
+                result->exact_index = i;
+                break;
+            }
+        }
+        job.name_count = 0;
+        if (query->pattern != NULL && !(result->found && query->similar_on_miss_only)) {
+            index_find_packages(index, query->pattern, offer_index_package, &similar);
+        }
+        job.pattern = NULL;
+    }
+
+    // Остальные классы кандидатов собираем одним обходом всех файлов pkglist
+    if (job.name_count > 0 || job.pattern != NULL) {
+        if (job_run(&job, query->pkglist_dir, query->threads) == 0 && job_keep(&job, &result->arena) == 0) {
+            job_merge(&job, &similar, result);
+            result->truncated = atomic_load(&job.cancelled);
+        }
+        job_free(&job);
+    }
+
+    // Сортируем отобранные похожие пакеты по длине имени
+    if (!(result->found && query->similar_on_miss_only) && similar.count > 0) {
+        result->similar = arena_alloc(&result->arena, similar.count * sizeof(PackageInfo));
+        for (int i = 0; result->similar != NULL && i < similar.count; i++) {
+            if (candidate_finish(&similar.items[similar.heap[i]], &result->arena,
+                                 &result->similar[result->similar_count]) == 0) {
+                result->similar_count++;
+            }
+        }
+        qsort(result->similar, result->similar_count, sizeof(PackageInfo), compare_package_by_name_length);
+    }
+    similar_top_free(&similar);
+
+    return result->found;
+}
+
+/* Освобождает строки и отображения результата поиска */
+void search_result_free(SearchResult *result) {
+    arena_free(&result->arena);
+    result->similar = NULL;
+    result->similar_count = 0;
+    result->found = 0;
+}
+
+/*
+ * Ищет пакеты для набора команд за один проход по базе
+ * Для каждого имени берется тот же пакет, что дал бы search_packages:
+ * из актуального индекса или первый в порядке каталога
+ * Строки пакетов указывают в индекс или отображения pkglist, переданные arena
+ * Возвращает количество найденных имен или -1 при ошибке
+ */
+int search_batch(const BatchQuery *query, BatchResult *results, Arena *arena) {
+    for (int i = 0; i < query->count; i++) {
+        results[i].found = 0;
+    }
+    if (query->count <= 0) {
+        return 0;
+    }
+
+    int *canonical = malloc(query->count * sizeof(int));
+    BatchTable table;
+    if (canonical == NULL || batch_table_init(&table, query->names, query->count, canonical) != 0) {
+        free(canonical);
+        return -1;
+    }
+
+    const CommandIndex *index = query->index;
+    if (index == NULL && query->index_path != NULL) {
+        index = open_index(arena, query->index_path, query->pkglist_dir);
+    }
+
+    int rc = 0;
+    if (index != NULL) {
+        for (int i = 0; i < query->count; i++) {
+            if (canonical[i] == i) {
+                results[i].found = index_lookup(index, query->names[i], arena, &results[i].package);
+            }
+        }
+    } else {
+        // Один обход всех pkglist: каждое имя файла проверяется по таблице имен
+        ScanJob job;
+        memset(&job, 0, sizeof(job));
+        atomic_init(&job.next_unit, 0);
+        atomic_init(&job.exact_key, INT_MAX);
+        atomic_init(&job.cancelled, 0);
+        job.batch = &table;
+        job.batch_count = query->count;
+
+        if (job_run(&job, query->pkglist_dir, query->threads) == 0 && job_keep(&job, arena) == 0) {
+            // Первая по порядку каталога единица с именем дает ответ
+            for (int i = 0; i < job.unit_count; i++) {
+                const ScanUnit *unit = &job.units[i];
+                for (int j = 0; j < unit->hit_count; j++) {
+                    BatchResult *result = &results[unit->hits[j].name];
+                    if (!result->found && candidate_finish(&unit->hits[j].package, arena, &result->package) == 0) {
+                        result->found = 1;
+                    }
+                }
+            }
+        } else {
+            rc = -1;
+        }
+        job_free(&job);
+    }
+
+    // Повторы имени получают ответ первого вхождения
+    int found = 0;
+    for (int i = 0; i < query->count; i++) {
+        if (canonical[i] != i) {
+            results[i] = results[canonical[i]];
+        }
+        results[i].first = canonical[i];
+        found += results[i].found;
+    }
+    free(table.slots);
+    free(canonical);
+    return rc < 0 ? -1 : found;
+}
@@ -0,0 +1,108 @@
+#ifndef CNF_SEARCH_H
+#define CNF_SEARCH_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "index.h"
+#include "typo.h"
+#include "arena.h"
+
+/* Наибольшее число потоков сканирования */
+#define SEARCH_MAX_THREADS 16
+
+/* Наибольшее число имен команды, проверяемых одним поиском */
+#define SEARCH_MAX_NAMES 16
+
+/* Файлы pkglist больше этого размера делятся на части между потоками */
+#define SEARCH_CHUNK_SIZE (8 * 1024 * 1024)
+
+/* Через сколько строк pkglist проверяется срок поиска */
+#define SEARCH_DEADLINE_ROWS 1024
+
+/* Параметры поиска по базе пакетов */
+typedef struct {
+    const char *command_name;  // Имя команды для точного поиска по FILENAMES
+    const char *pattern;       // Подстрока имени пакета для похожих (NULL - не искать)
+    int similar_on_miss_only;  // Похожие нужны только если команда не найдена
+    const char *pkglist_dir;   // Каталог с файлами pkglist
+    const char *index_path;    // Индекс команд (NULL - всегда сканировать)
+    int threads;               // Число потоков (0 - по числу процессоров, 1 - последовательно)
+    const char *const *alternatives;  // Другие варианты имени команды в порядке предпочтения
+    int alternative_count;            // Количество вариантов
+    const CommandIndex *index;        // Уже открытый актуальный индекс (NULL - открыть index_path)
+    int64_t deadline_ns;              // Время monotonic_ns, после которого обход прекращается (0 - нет)
+    int similar_limit;                // Сколько лучших похожих пакетов вернуть (0 - все)
+    const TypoPattern *typo_pattern;  // Образец для вариантов исправления при обходе (NULL - не нужны)
+} SearchQuery;
+
+/*
+ * Результаты поиска, собранные за один проход
+ * Строки пакетов указывают в отображенные pkglist и индекс, которыми владеет
+ * arena; все освобождается одним вызовом search_result_free
+ */
+typedef struct {
+    int found;              // Найден ли пакет с командой
+    int exact_index;        // Найденное имя: 0 - command_name, i - alternatives[i - 1]
+    PackageInfo exact;      // Пакет, содержащий команду
+    PackageInfo *similar;   // Лучшие пакеты с похожими именами (из индекса - с пустым путем)
+    int similar_count;      // Количество похожих пакетов
+    TypoResults typos;      // Команды из bin/sbin, похожие на typo_pattern
+    int truncated;          // Обход прерван по deadline_ns, ответ неполный
+    Arena arena;            // Память и отображения, на которые ссылается результат
+} SearchResult;
+
+/* Параметры поиска пакетов для набора команд */
+typedef struct {
+    const char *const *names;   // Имена команд (повторы допустимы)
+    int count;                  // Количество имен
+    const char *pkglist_dir;    // Каталог с файлами pkglist
+    const char *index_path;     // Индекс команд (NULL - всегда сканировать)
+    const CommandIndex *index;  // Уже открытый актуальный индекс (NULL - открыть index_path)
+    int threads;                // Число потоков (0 - по числу процессоров, 1 - последовательно)
+} BatchQuery;
+
+/* Результат поиска одной команды из набора */
+typedef struct {
+    int found;            // Найден ли пакет с командой
+    int first;            // Номер первого вхождения того же имени в запросе
+    PackageInfo package;  // Пакет, содержащий команду
+} BatchResult;
+
+/*
+ * Функция сравнения для qsort
+ * Сравнивает пакеты по длине имени, затем по алфавиту
+ */
+int compare_package_by_name_length(const void *a, const void *b);
+
+/*
+ * Ищет пакет с командой и пакеты с похожими именами за один проход по базе
+ * Варианты имени команды проверяются тем же проходом; если найдено несколько,
+ * выбирается первый по порядку предпочтения
+ * Если индекс актуален, оба ответа берутся из него
+ * Файлы pkglist сканируются параллельно, результат совпадает с последовательным
+ * обходом в порядке каталога; похожие пакеты - первые similar_limit
+ * из всех подходящих по compare_package_by_name_length, без повторов
+ * Если задан typo_pattern, в typos собираются похожие имена команд из
+ * просмотренных строк; при промахе без актуального индекса просмотрены все
+ * Если задан deadline_ns, обход прекращается по его истечении и выставляется
+ * truncated: найденное к этому моменту возвращается как есть
+ * Результат освобождается search_result_free, даже если ничего не найдено
+ * Возвращает 1 если пакет с командой найден, 0 если нет
+ */
+int search_packages(const SearchQuery *query, SearchResult *result);
+
+/* Освобождает строки и отображения результата поиска */
+void search_result_free(SearchResult *result);
+
+/*
+ * Ищет пакеты для набора команд за один проход по базе
+ * Для каждого имени берется тот же пакет, что дал бы search_packages:
+ * из актуального индекса или первый в порядке каталога
+ * results - массив из query->count элементов; строки пакетов живут,
+ * пока не освобождена arena
+ * Возвращает количество найденных имен или -1 при ошибке
+ */
+int search_batch(const BatchQuery *query, BatchResult *results, Arena *arena);
+
+#endif /* CNF_SEARCH_H */
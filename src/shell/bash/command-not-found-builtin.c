@@ -0,0 +1,101 @@
+/*
+ * Встроенная команда bash command_not_found: поиск внутри оболочки
+ * через libcommand-not-found без запуска command-not-found
+ * Загружается командой enable -f command_not_found.so command_not_found
+ */
+#include <config.h>
+#include <stdio.h>
+
+#include "loadables.h"
+
+// Путь относительно файла: в каталогах заголовков bash есть свой common.h,
+// каталог src программы нельзя добавлять в пути поиска
+#include "../../cnf.h"
+
+/* Переменная, в которую записывается команда для выполнения */
+#define EXEC_VARIABLE "CNF_EXEC"
+
+int command_not_found_builtin(WORD_LIST *list) {
+    int quick = 0;
+    int opt;
+    reset_internal_getopt();
+    while ((opt = internal_getopt(list, "q")) != -1) {
+        switch (opt) {
+        case 'q':
+            quick = 1;
+            break;
+        CASE_HELPOPT;
+        default:
+            builtin_usage();
+            return EX_USAGE;
+        }
+    }
+    list = loptend;
+    if (list == NULL || list->next != NULL) {
+        builtin_usage();
+        return EX_USAGE;
+    }
+
+    const char *command = list->word->word;
+    const char *path_env = get_string_value("PATH");
+    char exec_name[256];
+    int code;
+    if (quick) {
+        switch (cnf_quick_lookup(command, path_env, stdout, exec_name, sizeof(exec_name))) {
+        case CNF_LOOKUP_EXEC:
+            code = 0;
+            break;
+        case CNF_LOOKUP_DONE:
+            code = 127;
+            break;
+        default:
+            code = 1;
+            break;
+        }
+    } else {
+        code = cnf_lookup(command, path_env, stdout, exec_name, sizeof(exec_name));
+    }
+    fflush(stdout);
+
+    if (code == 0 && exec_name[0] != '\0') {
+        bind_variable(EXEC_VARIABLE, exec_name, 0);
+    }
+    return code;
+}
+
+/* Кеш каталогов PATH читается при загрузке и достается дочерним процессам готовым */
+int command_not_found_builtin_load(char *name) {
+    (void)name;
+    cnf_prepare(get_string_value("PATH"));
+    return 1;
+}
+
+void command_not_found_builtin_unload(char *name) {
+    (void)name;
+    cnf_release();
+}
+
+char *command_not_found_doc[] = {
+    "Suggest packages for a command that was not found.",
+    "",
+    "Prints the same hints as command-not-found COMMAND without starting it.",
+    "If a mistyped command should be run instead, its name is stored in",
+    "CNF_EXEC and the status is 0.",
+    "",
+    "Options:",
+    "  -q\tonly check the keyboard layout, PATH and system directories;",
+    "    \treturn 1 if the package database has to be searched",
+    "",
+    "Exit Status:",
+    "Returns 127 if the command is not available, 0 if CNF_EXEC is set.",
+    (char *)NULL
+};
+
+struct builtin command_not_found_struct = {
+    "command_not_found",
+    command_not_found_builtin,
+    BUILTIN_ENABLED,
+    command_not_found_doc,
+    "command_not_found [-q] command",
+    0
+};
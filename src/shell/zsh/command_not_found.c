@@ -0,0 +1,106 @@
+/*
+ * Модуль zsh command_not_found: поиск внутри оболочки через
+ * libcommand-not-found без запуска command-not-found
+ * Собирается в дереве исходников zsh (см. README), загружается
+ * командой zmodload command_not_found
+ */
+#include "command_not_found.mdh"
+#include "command_not_found.pro"
+
+#include <command-not-found/cnf.h>
+
+/* Переменная, в которую записывается команда для выполнения */
+#define EXEC_VARIABLE "CNF_EXEC"
+
+/*
+ * command_not_found [-q] command
+ * Коды возврата те же, что у встроенной команды bash
+ */
+static int
+bin_command_not_found(UNUSED(char *nam), char **args, Options ops, UNUSED(int func))
+{
+    char *path_env = getsparam("PATH");
+    char exec_name[256];
+    int code;
+
+    if (OPT_ISSET(ops, 'q')) {
+        switch (cnf_quick_lookup(args[0], path_env, stdout, exec_name, sizeof(exec_name))) {
+        case CNF_LOOKUP_EXEC:
+            code = 0;
+            break;
+        case CNF_LOOKUP_DONE:
+            code = 127;
+            break;
+        default:
+            code = 1;
+            break;
+        }
+    } else {
+        code = cnf_lookup(args[0], path_env, stdout, exec_name, sizeof(exec_name));
+    }
+    fflush(stdout);
+
+    if (code == 0 && exec_name[0] != '\0') {
+        setsparam(EXEC_VARIABLE, ztrdup(exec_name));
+    }
+    return code;
+}
+
+static struct builtin bintab[] = {
+    BUILTIN("command_not_found", 0, bin_command_not_found, 1, 1, 0, "q", NULL),
+};
+
+static struct features module_features = {
+    bintab, sizeof(bintab) / sizeof(*bintab),
+    NULL, 0,
+    NULL, 0,
+    NULL, 0,
+    0
+};
+
+/**/
+int
+setup_(UNUSED(Module m))
+{
+    return 0;
+}
+
+/**/
+int
+features_(Module m, char ***features)
+{
+    *features = featuresarray(m, &module_features);
+    return 0;
+}
+
+/**/
+int
+enables_(Module m, int **enables)
+{
+    return handlefeatures(m, &module_features, enables);
+}
+
+/* Кеш каталогов PATH читается при загрузке и достается дочерним процессам готовым */
+
+/**/
+int
+boot_(UNUSED(Module m))
+{
+    cnf_prepare(getsparam("PATH"));
+    return 0;
+}
+
+/**/
+int
+cleanup_(Module m)
+{
+    cnf_release();
+    return setfeatureenables(m, &module_features, NULL);
+}
+
+/**/
+int
+finish_(UNUSED(Module m))
+{
+    return 0;
+}
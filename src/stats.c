@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "stats.h"
+#include "util.h"
+
+/* Названия этапов в выводе */
+static const char *const phase_names[STATS_PHASE_COUNT] = {
+    "other", "layout", "path", "system", "search", "installed", "typo"
+};
+
+/* Названия счетчиков в выводе */
+static const char *const counter_names[STATS_COUNTER_COUNT] = {
+    "subprocesses", "bytes_read", "rows_parsed", "copies", "bytes_copied"
+};
+
+static int enabled = 0;
+static int64_t start_ns;                     // Время включения сбора
+static int64_t phase_start_ns;               // Начало текущего отрезка этапа
+static atomic_int current_phase;             // Читается потоками сканирования
+static int64_t phase_ns[STATS_PHASE_COUNT];  // Время этапов без вложенных
+static uint64_t phase_calls[STATS_PHASE_COUNT];
+static atomic_uint_fast64_t counters[STATS_PHASE_COUNT][STATS_COUNTER_COUNT];
+
+/* Относит время с начала отрезка к текущему этапу */
+static void stats_flush(int64_t now) {
+    phase_ns[atomic_load_explicit(&current_phase, memory_order_relaxed)] += now - phase_start_ns;
+    phase_start_ns = now;
+}
+
+/* Включает сбор статистики; до вызова все функции ничего не делают */
+void stats_enable(void) {
+    if (enabled) {
+        return;
+    }
+    start_ns = monotonic_ns();
+    phase_start_ns = start_ns;
+    atomic_store(&current_phase, STATS_PHASE_OTHER);
+    enabled = 1;
+}
+
+/* Обнуляет собранную статистику и начинает отсчет заново */
+void stats_reset(void) {
+    if (!enabled) {
+        return;
+    }
+    memset(phase_ns, 0, sizeof(phase_ns));
+    memset(phase_calls, 0, sizeof(phase_calls));
+    for (int phase = 0; phase < STATS_PHASE_COUNT; phase++) {
+        for (int counter = 0; counter < STATS_COUNTER_COUNT; counter++) {
+            atomic_store(&counters[phase][counter], 0);
+        }
+    }
+    start_ns = monotonic_ns();
+    phase_start_ns = start_ns;
+    atomic_store(&current_phase, STATS_PHASE_OTHER);
+}
+
+/* Проверяет, включен ли сбор статистики */
+int stats_enabled(void) {
+    return enabled;
+}
+
+/* Переходит к этапу phase; возвращает прежний этап для stats_leave */
+StatsPhase stats_enter(StatsPhase phase) {
+    if (!enabled) {
+        return STATS_PHASE_OTHER;
+    }
+    stats_flush(monotonic_ns());
+    StatsPhase previous = atomic_exchange_explicit(&current_phase, phase, memory_order_relaxed);
+    phase_calls[phase]++;
+    return previous;
+}
+
+/* Завершает текущий этап и возвращается к previous */
+void stats_leave(StatsPhase previous) {
+    if (!enabled) {
+        return;
+    }
+    stats_flush(monotonic_ns());
+    atomic_store_explicit(&current_phase, previous, memory_order_relaxed);
+}
+
+/* Добавляет value к счетчику текущего этапа (безопасно из нескольких потоков) */
+void stats_count(StatsCounter counter, uint64_t value) {
+    if (!enabled) {
+        return;
+    }
+    int phase = atomic_load_explicit(&current_phase, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters[phase][counter], value, memory_order_relaxed);
+}
+
+/* Дописывает строку в буфер, не выходя за его границы */
+__attribute__((format(printf, 4, 5)))
+static void append(char *buf, size_t size, size_t *len, const char *format, ...) {
+    if (*len >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buf + *len, size - *len, format, args);
+    va_end(args);
+    if (written > 0) {
+        *len += (size_t)written;
+    }
+}
+
+/* Дописывает строку в кавычках JSON */
+static void append_json_string(char *buf, size_t size, size_t *len, const char *str) {
+    append(buf, size, len, "\"");
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            append(buf, size, len, "\\%c", *p);
+        } else if (*p < 0x20) {
+            append(buf, size, len, "\\u%04x", *p);
+        } else {
+            append(buf, size, len, "%c", *p);
+        }
+    }
+    append(buf, size, len, "\"");
+}
+
+/*
+ * Выводит собранную статистику: в stderr, если log_path равен NULL,
+ * иначе дописывает одну строку JSON в файл log_path
+ * command и result попадают в запись как есть
+ */
+void stats_report(const char *log_path, const char *command, const char *result) {
+    if (!enabled) {
+        return;
+    }
+    int64_t now = monotonic_ns();
+    stats_flush(now);
+    double total_ms = (now - start_ns) / 1e6;
+
+    if (log_path == NULL) {
+        fprintf(stderr, "command-not-found stats: %s -> %s, total %.3f ms\n", command, result, total_ms);
+        for (int phase = 0; phase < STATS_PHASE_COUNT; phase++) {
+            fprintf(stderr, "  %-10s %9.3f ms  calls %-3llu", phase_names[phase], phase_ns[phase] / 1e6,
+                    (unsigned long long)phase_calls[phase]);
+            for (int counter = 0; counter < STATS_COUNTER_COUNT; counter++) {
+                fprintf(stderr, "  %s %llu", counter_names[counter],
+                        (unsigned long long)atomic_load(&counters[phase][counter]));
+            }
+            fprintf(stderr, "\n");
+        }
+        return;
+    }
+
+    // Запись собирается целиком и пишется одним вызовом: строки нескольких
+    // процессов в общем файле не перемешиваются
+    char buf[4096];
+    size_t len = 0;
+    append(buf, sizeof(buf), &len, "{\"time\":%lld,\"pid\":%ld,\"command\":",
+           (long long)time(NULL), (long)getpid());
+    append_json_string(buf, sizeof(buf), &len, command);
+    append(buf, sizeof(buf), &len, ",\"result\":");
+    append_json_string(buf, sizeof(buf), &len, result);
+    append(buf, sizeof(buf), &len, ",\"total_ms\":%.3f,\"phases\":{", total_ms);
+    for (int phase = 0; phase < STATS_PHASE_COUNT; phase++) {
+        append(buf, sizeof(buf), &len, "%s\"%s\":{\"ms\":%.3f,\"calls\":%llu", phase > 0 ? "," : "",
+               phase_names[phase], phase_ns[phase] / 1e6, (unsigned long long)phase_calls[phase]);
+        for (int counter = 0; counter < STATS_COUNTER_COUNT; counter++) {
+            append(buf, sizeof(buf), &len, ",\"%s\":%llu", counter_names[counter],
+                   (unsigned long long)atomic_load(&counters[phase][counter]));
+        }
+        append(buf, sizeof(buf), &len, "}");
+    }
+    append(buf, sizeof(buf), &len, "}}\n");
+    if (len >= sizeof(buf)) {
+        return;
+    }
+
+    int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    write_all(fd, buf, len);
+    close(fd);
+}
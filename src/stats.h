@@ -0,0 +1,56 @@
+#ifndef CNF_STATS_H
+#define CNF_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Этапы работы программы
+ * Время вложенного этапа не входит во время внешнего
+ */
+typedef enum {
+    STATS_PHASE_OTHER,      // Разбор параметров и вывод
+    STATS_PHASE_LAYOUT,     // Варианты раскладки
+    STATS_PHASE_PATH,       // Поиск в PATH
+    STATS_PHASE_SYSTEM,     // Поиск в системных каталогах
+    STATS_PHASE_SEARCH,     // Поиск по индексу и pkglist
+    STATS_PHASE_INSTALLED,  // Проверка установленных пакетов
+    STATS_PHASE_TYPO,       // Исправление опечаток
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+/* Счетчики, относимые к текущему этапу */
+typedef enum {
+    STATS_SUBPROCESSES,  // Запущенные процессы (pkglist-query, rpm)
+    STATS_BYTES_READ,    // Прочитанные байты файлов и вывода процессов
+    STATS_ROWS_PARSED,   // Разобранные строки pkglist
+    STATS_COPIES,        // Строки, скопированные в результаты поиска
+    STATS_BYTES_COPIED,  // Их размер
+    STATS_COUNTER_COUNT
+} StatsCounter;
+
+/* Включает сбор статистики; до вызова все функции ничего не делают */
+void stats_enable(void);
+
+/* Обнуляет собранную статистику и начинает отсчет заново */
+void stats_reset(void);
+
+/* Проверяет, включен ли сбор статистики */
+int stats_enabled(void);
+
+/* Переходит к этапу phase; возвращает прежний этап для stats_leave */
+StatsPhase stats_enter(StatsPhase phase);
+
+/* Завершает текущий этап и возвращается к previous */
+void stats_leave(StatsPhase previous);
+
+/* Добавляет value к счетчику текущего этапа (безопасно из нескольких потоков) */
+void stats_count(StatsCounter counter, uint64_t value);
+
+/*
+ * Выводит собранную статистику: в stderr, если log_path равен NULL,
+ * иначе дописывает одну строку JSON в файл log_path
+ * command и result попадают в запись как есть
+ */
+void stats_report(const char *log_path, const char *command, const char *result);
+
+#endif /* CNF_STATS_H */
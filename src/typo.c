@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "typo.h"
+#include "index.h"
+#include "util.h"
+
+/* Готовит образец для расчета расстояний */
+void typo_pattern_init(TypoPattern *pattern, const char *text) {
+    memset(pattern->peq, 0, sizeof(pattern->peq));
+    pattern->text = text;
+    pattern->length = strlen(text);
+
+    size_t bits = pattern->length < 64 ? pattern->length : 64;
+    for (size_t i = 0; i < bits; i++) {
+        pattern->peq[(unsigned char)text[i]] |= (uint64_t)1 << i;
+    }
+}
+
+/* Классический расчет по матрице для образцов длиннее 64 байт */
+static int distance_dp(const char *a, size_t len_a, const char *b, size_t len_b) {
+    int *rows = malloc(3 * (len_b + 1) * sizeof(int));
+    if (rows == NULL) {
+        return (int)(len_a > len_b ? len_a : len_b);
+    }
+    int *prev2 = rows, *prev = rows + len_b + 1, *cur = rows + 2 * (len_b + 1);
+
+    for (size_t j = 0; j <= len_b; j++) {
+        prev[j] = (int)j;
+    }
+    for (size_t i = 1; i <= len_a; i++) {
+        cur[0] = (int)i;
+        for (size_t j = 1; j <= len_b; j++) {
+            int cost = a[i - 1] != b[j - 1];
+            int best = prev[j - 1] + cost;
+            if (prev[j] + 1 < best) best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            // Перестановка соседних символов
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] && prev2[j - 2] + 1 < best) {
+                best = prev2[j - 2] + 1;
+            }
+            cur[j] = best;
+        }
+        int *tmp = prev2; prev2 = prev; prev = cur; cur = tmp;
+    }
+
+    int result = prev[len_b];
+    free(rows);
+    return result;
+}
+
+/*
+ * Битпараллельный расчет расстояния для образцов до 64 байт
+ * (алгоритм Майерса с расширением Хюрё для перестановок)
+ */
+static int bitparallel_distance(const TypoPattern *pattern, const char *text) {
+    size_t m = pattern->length;
+    uint64_t pv = ~(uint64_t)0;  // Положительные вертикальные разности
+    uint64_t mv = 0;             // Отрицательные вертикальные разности
+    uint64_t d0 = 0;             // Диагональные нули предыдущего столбца
+    uint64_t pm_prev = 0;        // Маска предыдущего символа текста
+    uint64_t last = (uint64_t)1 << (m - 1);
+    int score = (int)m;
+
+    for (const unsigned char *ptr = (const unsigned char *)text; *ptr; ptr++) {
+        uint64_t eq = pattern->peq[*ptr];
+        uint64_t tr = (((~d0) & eq) << 1) & pm_prev;
+        d0 = (((eq & pv) + pv) ^ pv) | eq | mv | tr;
+        uint64_t hp = mv | ~(d0 | pv);
+        uint64_t hn = pv & d0;
+
+        if (hp & last) {
+            score++;
+        } else if (hn & last) {
+            score--;
+        }
+
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        pv = hn | ~(d0 | hp);
+        mv = hp & d0;
+        pm_prev = eq;
+    }
+    return score;
+}
+
+/*
+ * Вычисляет расстояние Дамерау-Левенштейна (с ограниченными перестановками)
+ * между образцом и text; для образцов до 64 байт - битпараллельно
+ */
+int typo_distance(const TypoPattern *pattern, const char *text) {
+    if (pattern->length == 0) {
+        return (int)strlen(text);
+    }
+    if (pattern->length > 64) {
+        return distance_dp(pattern->text, pattern->length, text, strlen(text));
+    }
+    return bitparallel_distance(pattern, text);
+}
+
+/* Подбирает допустимое расстояние по длине введенной команды */
+int typo_max_distance(size_t length) {
+    if (length <= 2) {
+        return 0;
+    }
+    return length <= 4 ? 1 : 2;
+}
+
+/* Готовит набор лучших вариантов */
+void typo_results_init(TypoResults *results, int limit, int max_distance) {
+    results->count = 0;
+    results->limit = limit < TYPO_MAX_SUGGESTIONS ? limit : TYPO_MAX_SUGGESTIONS;
+    results->max_distance = max_distance;
+}
+
+/* Сравнивает варианты: ближе, затем по алфавиту */
+static int suggestion_less(int distance, const char *name, const TypoSuggestion *other) {
+    if (distance != other->distance) {
+        return distance < other->distance;
+    }
+    return strcmp(name, other->name) < 0;
+}
+
+/* Предлагает вариант; сохраняется, если он входит в лучшие */
+void typo_results_offer(TypoResults *results, const char *name, const char *package, int distance) {
+    if (distance <= 0 || distance > results->max_distance) {
+        return;
+    }
+
+    // Одно имя предлагается один раз; первым обычно предлагается вариант из PATH
+    for (int i = 0; i < results->count; i++) {
+        if (strcmp(results->items[i].name, name) == 0) {
+            return;
+        }
+    }
+
+    int pos = results->count;
+    while (pos > 0 && suggestion_less(distance, name, &results->items[pos - 1])) {
+        pos--;
+    }
+    if (pos >= results->limit) {
+        return;
+    }
+
+    int count = results->count < results->limit ? results->count + 1 : results->limit;
+    memmove(&results->items[pos + 1], &results->items[pos], (count - pos - 1) * sizeof(TypoSuggestion));
+
+    TypoSuggestion *item = &results->items[pos];
+    copy_field(item->name, name);
+    copy_field(item->package, package != NULL ? package : "");
+    item->distance = distance;
+    results->count = count;
+}
+
+/*
+ * Проверяет имя name и предлагает его как вариант
+ * Для перебора небольших наборов имен (например, исполняемых файлов PATH)
+ */
+void typo_check_name(const TypoPattern *pattern, TypoResults *results,
+                     const char *name, const char *package) {
+    // Разница длин - нижняя граница расстояния
+    size_t len = strlen(name);
+    size_t diff = len > pattern->length ? len - pattern->length : pattern->length - len;
+    if (diff > (size_t)results->max_distance) {
+        return;
+    }
+    typo_results_offer(results, name, package, typo_distance(pattern, name));
+}
+
+/* Узел BK-дерева при построении */
+typedef struct {
+    uint32_t name;          // Смещение имени
+    uint32_t package;       // Смещение пакета
+    uint32_t first_child;   // Первый потомок + 1 (0 - нет)
+    uint32_t next_sibling;  // Следующий брат + 1 (0 - нет)
+    uint16_t distance;      // Расстояние до родителя
+} BuildNode;
+
+/* Состояние построения BK-дерева */
+typedef struct {
+    BuildNode *nodes;
+    size_t count;
+    size_t cap;
+    char *strings;
+    size_t strings_len;
+    size_t strings_cap;
+} TreeBuilder;
+
+/* Добавляет строку в таблицу строк построителя */
+static int tree_add_string(TreeBuilder *builder, const char *str, uint32_t *offset) {
+    size_t len = strlen(str) + 1;
+    if (builder->strings_len + len > UINT32_MAX) {
+        return -1;
+    }
+    if (builder->strings_len + len > builder->strings_cap) {
+        size_t cap = builder->strings_cap ? builder->strings_cap * 2 : 1 << 20;
+        while (cap < builder->strings_len + len) {
+            cap *= 2;
+        }
+        char *strings = realloc(builder->strings, cap);
+        if (strings == NULL) {
+            return -1;
+        }
+        builder->strings = strings;
+        builder->strings_cap = cap;
+    }
+    memcpy(builder->strings + builder->strings_len, str, len);
+    *offset = (uint32_t)builder->strings_len;
+    builder->strings_len += len;
+    return 0;
+}
+
+/* Вставляет имя в BK-дерево; повторы пропускаются */
+static int tree_insert(TreeBuilder *builder, const char *name, const char *package) {
+    uint32_t parent = 0;
+    uint16_t distance = 0;
+
+    if (builder->count > 0) {
+        TypoPattern pattern;
+        typo_pattern_init(&pattern, name);
+
+        uint32_t node = 0;
+        for (;;) {
+            int d = typo_distance(&pattern, builder->strings + builder->nodes[node].name);
+            if (d == 0) {
+                return 0;
+            }
+            if (d > UINT16_MAX) {
+                d = UINT16_MAX;
+            }
+
+            // Ищем потомка на том же расстоянии
+            uint32_t child = builder->nodes[node].first_child;
+            while (child != 0 && builder->nodes[child - 1].distance != d) {
+                child = builder->nodes[child - 1].next_sibling;
+            }
+            if (child == 0) {
+                parent = node;
+                distance = (uint16_t)d;
+                break;
+            }
+            node = child - 1;
+        }
+    }
+
+    if (builder->count == builder->cap) {
+        size_t cap = builder->cap ? builder->cap * 2 : 65536;
+        BuildNode *nodes = realloc(builder->nodes, cap * sizeof(BuildNode));
+        if (nodes == NULL) {
+            return -1;
+        }
+        builder->nodes = nodes;
+        builder->cap = cap;
+    }
+
+    BuildNode *node = &builder->nodes[builder->count];
+    memset(node, 0, sizeof(*node));
+    if (tree_add_string(builder, name, &node->name) != 0 ||
+        tree_add_string(builder, package != NULL ? package : "", &node->package) != 0) {
+        return -1;
+    }
+    node->distance = distance;
+
+    if (builder->count > 0) {
+        node->next_sibling = builder->nodes[parent].first_child;
+        builder->nodes[parent].first_child = (uint32_t)builder->count + 1;
+    }
+    builder->count++;
+    return 0;
+}
+
+/* Узлы построителя для сортировки потомков по расстоянию */
+static const BuildNode *sort_nodes;
+
+static int compare_child_distance(const void *a, const void *b) {
+    uint16_t da = sort_nodes[*(const uint32_t *)a].distance;
+    uint16_t db = sort_nodes[*(const uint32_t *)b].distance;
+    return (da > db) - (da < db);
+}
+
+/*
+ * Раскладывает дерево в ширину так, что потомки каждого узла лежат подряд
+ * Возвращает массив узлов файла или NULL при нехватке памяти
+ */
+static TypoNode *tree_flatten(const TreeBuilder *builder) {
+    size_t count = builder->count;
+    TypoNode *nodes = calloc(count, sizeof(TypoNode));
+    uint32_t *order = malloc(count * sizeof(uint32_t));
+    if (nodes == NULL || order == NULL) {
+        free(nodes);
+        free(order);
+        return NULL;
+    }
+
+    order[0] = 0;
+    size_t tail = 1;
+    sort_nodes = builder->nodes;
+    for (size_t head = 0; head < count; head++) {
+        const BuildNode *source = &builder->nodes[order[head]];
+        TypoNode *node = &nodes[head];
+        node->name = source->name;
+        node->package = source->package;
+        node->distance = source->distance;
+        node->first_child = (uint32_t)tail;
+
+        size_t first = tail;
+        for (uint32_t child = source->first_child; child != 0; child = builder->nodes[child - 1].next_sibling) {
+            order[tail++] = child - 1;
+        }
+        qsort(order + first, tail - first, sizeof(uint32_t), compare_child_distance);
+        node->child_count = (uint16_t)(tail - first);
+    }
+    sort_nodes = NULL;
+
+    free(order);
+    return nodes;
+}
+
+/*
+ * Строит BK-дерево по произвольному набору имен
+ * packages может быть NULL; возвращает количество узлов или -1 при ошибке
+ */
+long typo_tree_write(const char *path, const char *const *names, const char *const *packages,
+                     size_t count, int64_t source_mtime) {
+    TreeBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+
+    long result = -1;
+    for (size_t i = 0; i < count; i++) {
+        if (tree_insert(&builder, names[i], packages != NULL ? packages[i] : NULL) != 0) {
+            goto out;
+        }
+    }
+    if (builder.count == 0 || builder.count > UINT32_MAX) {
+        goto out;
+    }
+
+    TypoNode *nodes = tree_flatten(&builder);
+    if (nodes == NULL) {
+        goto out;
+    }
+
+    TypoHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TYPO_MAGIC, sizeof(header.magic));
+    header.version = TYPO_VERSION;
+    header.node_count = (uint32_t)builder.count;
+    header.strings_offset = sizeof(TypoHeader) + builder.count * sizeof(TypoNode);
+    header.strings_size = builder.strings_len;
+    header.source_mtime = source_mtime;
+
+    size_t size = header.strings_offset + builder.strings_len;
+    char *data = malloc(size);
+    if (data != NULL) {
+        memcpy(data, &header, sizeof(header));
+        memcpy(data + sizeof(header), nodes, builder.count * sizeof(TypoNode));
+        memcpy(data + header.strings_offset, builder.strings, builder.strings_len);
+        if (write_file_atomic(path, data, size) == 0) {
+            result = (long)builder.count;
+        }
+        free(data);
+    }
+    free(nodes);
+
+out:
+    free(builder.nodes);
+    free(builder.strings);
+    return result;
+}
+
+/* Имена команд из индекса для построения дерева */
+typedef struct {
+    const char **names;     // Имена команд (в arena)
+    const char **packages;  // Имена пакетов (в отображении индекса)
+    size_t count;
+    Arena arena;
+    int failed;             // Нехватка памяти
+} TypoCommands;
+
+/* Колбэк перебора индекса: берет первую команду из bin для каждого имени */
+static int collect_command(const char *dirname, const char *basename, const char *package, void *user_data) {
+    TypoCommands *commands = user_data;
+    size_t dir_len = strlen(dirname);
+    if (dir_len < 4 || memcmp(dirname + dir_len - 4, "bin/", 4) != 0 || *basename == '\0') {
+        return 0;
+    }
+    // Записи отсортированы по имени: повтор имени идет сразу за первым
+    if (commands->count > 0 && strcmp(commands->names[commands->count - 1], basename) == 0) {
+        return 0;
+    }
+    const char *name = arena_strdup(&commands->arena, basename);
+    if (name == NULL) {
+        commands->failed = 1;
+        return 1;
+    }
+    commands->names[commands->count] = name;
+    commands->packages[commands->count] = package;
+    commands->count++;
+    return 0;
+}
+
+/*
+ * Строит BK-дерево по именам команд из каталогов bin/sbin актуального индекса
+ * Возвращает количество узлов или -1 при ошибке
+ */
+long typo_tree_rebuild(const char *path, const char *index_path, const char *pkglist_dir) {
+    CommandIndex index;
+    if (index_open(&index, index_path, pkglist_dir) != 0) {
+        return -1;
+    }
+
+    uint32_t entry_count = index.entry_count;
+    TypoCommands commands;
+    memset(&commands, 0, sizeof(commands));
+    arena_init(&commands.arena);
+    commands.names = malloc(entry_count * sizeof(*commands.names) + 1);
+    commands.packages = malloc(entry_count * sizeof(*commands.packages) + 1);
+    long result = -1;
+
+    if (commands.names != NULL && commands.packages != NULL &&
+        index_foreach_entry(&index, collect_command, &commands) == 0 && !commands.failed) {
+        const char **names = commands.names;
+        const char **packages = commands.packages;
+        size_t count = commands.count;
+
+        // Перемешивание порядка вставки делает BK-дерево сбалансированнее
+        srand(1);
+        for (size_t i = count; i > 1; i--) {
+            size_t j = (size_t)rand() % i;
+            const char *name = names[i - 1];
+            const char *package = packages[i - 1];
+            names[i - 1] = names[j];
+            packages[i - 1] = packages[j];
+            names[j] = name;
+            packages[j] = package;
+        }
+
+        result = typo_tree_write(path, names, packages, count, index.source_stamp);
+    }
+
+    free(commands.names);
+    free(commands.packages);
+    arena_free(&commands.arena);
+    index_close(&index);
+    return result;
+}
+
+/*
+ * Открывает BK-дерево; если source_mtime неотрицательно, дерево
+ * должно быть построено по тому же состоянию pkglist
+ * Возвращает 0 при успехе, -1 если дерево отсутствует, повреждено или устарело
+ */
+int typo_tree_open(TypoTree *tree, const char *path, int64_t source_mtime) {
+    memset(tree, 0, sizeof(*tree));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TypoHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    tree->map = map;
+    tree->size = st.st_size;
+    tree->header = map;
+
+    const TypoHeader *header = tree->header;
+    uint64_t nodes_end = sizeof(TypoHeader) + (uint64_t)header->node_count * sizeof(TypoNode);
+    if (memcmp(header->magic, TYPO_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TYPO_VERSION ||
+        header->node_count == 0 ||
+        nodes_end > tree->size ||
+        header->strings_offset < nodes_end ||
+        header->strings_size == 0 ||
+        header->strings_offset + header->strings_size > tree->size ||
+        (source_mtime >= 0 && header->source_mtime != source_mtime)) {
+        typo_tree_close(tree);
+        return -1;
+    }
+
+    tree->nodes = (const TypoNode *)((const char *)map + sizeof(TypoHeader));
+    tree->strings = (const char *)map + header->strings_offset;
+    if (tree->strings[header->strings_size - 1] != '\0') {
+        typo_tree_close(tree);
+        return -1;
+    }
+    return 0;
+}
+
+/* Освобождает отображение дерева */
+void typo_tree_close(TypoTree *tree) {
+    if (tree->map != NULL) {
+        munmap(tree->map, tree->size);
+    }
+    memset(tree, 0, sizeof(*tree));
+}
+
+/* Монотонное время в миллисекундах */
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Ищет в дереве имена не дальше results->max_distance от образца
+ * Поиск прекращается по истечении budget_ms миллисекунд
+ * Возвращает 1 если дерево просмотрено полностью, 0 если поиск прерван
+ */
+int typo_tree_search(const TypoTree *tree, const TypoPattern *pattern,
+                     TypoResults *results, double budget_ms) {
+    const TypoHeader *header = tree->header;
+    int radius = results->max_distance;
+    double deadline = monotonic_ms() + budget_ms;
+
+    size_t stack_cap = 1024;
+    uint32_t *stack = malloc(stack_cap * sizeof(uint32_t));
+    if (stack == NULL) {
+        return 0;
+    }
+
+    size_t depth = 0;
+    stack[depth++] = 0;
+    unsigned visited = 0;
+    int complete = 1;
+
+    while (depth > 0) {
+        // Время проверяем не на каждом узле
+        if ((++visited & 1023) == 0 && monotonic_ms() > deadline) {
+            complete = 0;
+            break;
+        }
+
+        const TypoNode *node = &tree->nodes[stack[--depth]];
+        if (node->name >= header->strings_size || node->package >= header->strings_size) {
+            continue;
+        }
+
+        const char *name = tree->strings + node->name;
+        int d = typo_distance(pattern, name);
+        typo_results_offer(results, name, tree->strings + node->package, d);
+
+        // Неравенство треугольника: нужны потомки на расстоянии [d - r, d + r]
+        // Для расстояния с перестановками оно выполняется не всегда, но
+        // исключения редки, а радиус k вдвое быстрее точного k + 1 по Левенштейну
+        for (uint32_t i = 0; i < node->child_count; i++) {
+            uint32_t child = node->first_child + i;
+            if (child >= header->node_count) {
+                break;
+            }
+            int child_distance = tree->nodes[child].distance;
+            if (child_distance < d - radius) {
+                continue;
+            }
+            if (child_distance > d + radius) {
+                break;
+            }
+
+            if (depth == stack_cap) {
+                uint32_t *grown = realloc(stack, stack_cap * 2 * sizeof(uint32_t));
+                if (grown == NULL) {
+                    complete = 0;
+                    goto out;
+                }
+                stack = grown;
+                stack_cap *= 2;
+            }
+            stack[depth++] = child;
+        }
+    }
+
+out:
+    free(stack);
+    return complete;
+}
@@ -0,0 +1,128 @@
+#ifndef CNF_TYPO_H
+#define CNF_TYPO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* Сигнатура и версия файла BK-дерева */
+#define TYPO_MAGIC "CNFTYPO\0"
+#define TYPO_VERSION 1
+
+/* Наибольшее число вариантов исправления */
+#define TYPO_MAX_SUGGESTIONS 8
+
+/* Бюджет времени на поиск исправлений по умолчанию, мс */
+#define TYPO_DEFAULT_BUDGET_MS 50
+
+/* Предвычисленные битовые маски символов образца для битпараллельного расчета */
+typedef struct {
+    uint64_t peq[256];     // Позиции каждого байта в образце
+    const char *text;      // Образец
+    size_t length;         // Длина образца в байтах
+} TypoPattern;
+
+/* Вариант исправления */
+typedef struct {
+    char name[256];        // Имя команды
+    char package[256];     // Пакет, содержащий команду ("" - команда уже в PATH)
+    int distance;          // Расстояние редактирования до введенной команды
+} TypoSuggestion;
+
+/* Лучшие варианты, упорядоченные по расстоянию, затем по имени */
+typedef struct {
+    TypoSuggestion items[TYPO_MAX_SUGGESTIONS];
+    int count;             // Количество вариантов
+    int limit;             // Сколько вариантов нужно
+    int max_distance;      // Наибольшее допустимое расстояние
+} TypoResults;
+
+/* Заголовок файла BK-дерева */
+typedef struct {
+    char magic[8];            // Сигнатура TYPO_MAGIC
+    uint32_t version;         // Версия формата
+    uint32_t node_count;      // Количество узлов
+    uint64_t strings_offset;  // Смещение таблицы строк
+    uint64_t strings_size;    // Размер таблицы строк
+    int64_t source_mtime;     // Отпечаток файлов pkglist (source_stamp индекса), по которым построено дерево
+} TypoHeader;
+
+/*
+ * Узел BK-дерева по расстоянию typo_distance, узел 0 - корень
+ * Потомки узла лежат подряд и упорядочены по расстоянию до него
+ */
+typedef struct {
+    uint32_t name;            // Смещение имени команды
+    uint32_t package;         // Смещение имени пакета
+    uint32_t first_child;     // Номер первого потомка
+    uint16_t child_count;     // Количество потомков
+    uint16_t distance;        // Расстояние до родителя
+} TypoNode;
+
+/* Отображенное в память BK-дерево */
+typedef struct {
+    void *map;
+    size_t size;
+    const TypoHeader *header;
+    const TypoNode *nodes;
+    const char *strings;
+} TypoTree;
+
+/* Готовит образец для расчета расстояний */
+void typo_pattern_init(TypoPattern *pattern, const char *text);
+
+/*
+ * Вычисляет расстояние Дамерау-Левенштейна (с ограниченными перестановками)
+ * между образцом и text; для образцов до 64 байт - битпараллельно
+ */
+int typo_distance(const TypoPattern *pattern, const char *text);
+
+/* Подбирает допустимое расстояние по длине введенной команды */
+int typo_max_distance(size_t length);
+
+/* Готовит набор лучших вариантов */
+void typo_results_init(TypoResults *results, int limit, int max_distance);
+
+/* Предлагает вариант; сохраняется, если он входит в лучшие */
+void typo_results_offer(TypoResults *results, const char *name, const char *package, int distance);
+
+/*
+ * Проверяет имя name и предлагает его как вариант
+ * Для перебора небольших наборов имен (например, исполняемых файлов PATH)
+ */
+void typo_check_name(const TypoPattern *pattern, TypoResults *results,
+                     const char *name, const char *package);
+
+/*
+ * Строит BK-дерево по именам команд из каталогов bin/sbin актуального индекса
+ * Возвращает количество узлов или -1 при ошибке
+ */
+long typo_tree_rebuild(const char *path, const char *index_path, const char *pkglist_dir);
+
+/*
+ * Строит BK-дерево по произвольному набору имен
+ * packages может быть NULL; возвращает количество узлов или -1 при ошибке
+ */
+long typo_tree_write(const char *path, const char *const *names, const char *const *packages,
+                     size_t count, int64_t source_mtime);
+
+/*
+ * Открывает BK-дерево; если source_mtime неотрицательно, дерево
+ * должно быть построено по тому же состоянию pkglist
+ * Возвращает 0 при успехе, -1 если дерево отсутствует, повреждено или устарело
+ */
+int typo_tree_open(TypoTree *tree, const char *path, int64_t source_mtime);
+
+/* Освобождает отображение дерева */
+void typo_tree_close(TypoTree *tree);
+
+/*
+ * Ищет в дереве имена не дальше results->max_distance от образца
+ * Поиск прекращается по истечении budget_ms миллисекунд
+ * Возвращает 1 если дерево просмотрено полностью, 0 если поиск прерван
+ */
+int typo_tree_search(const TypoTree *tree, const TypoPattern *pattern,
+                     TypoResults *results, double budget_ms);
+
+#endif /* CNF_TYPO_H */
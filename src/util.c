@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "util.h"
+#include "stats.h"
+
+/*
+ * Формирует путь к файлу в пользовательском каталоге кеша
+ * ($XDG_CACHE_HOME/command-not-found или ~/.cache/command-not-found)
+ * и создает этот каталог при необходимости
+ * Возвращает 0 при успехе, -1 если каталог недоступен
+ */
+int user_cache_path(const char *name, char *buf, size_t size) {
+    char dir[MAX_PATH_LEN];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg != NULL && xdg[0] == '/') {
+        if (snprintf(dir, sizeof(dir), "%s", xdg) >= (int)sizeof(dir)) {
+            return -1;
+        }
+    } else if (home != NULL && home[0] == '/') {
+        if (snprintf(dir, sizeof(dir), "%s/.cache", home) >= (int)sizeof(dir)) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    mkdir(dir, 0700);
+
+    size_t len = strlen(dir);
+    if (snprintf(dir + len, sizeof(dir) - len, "/command-not-found") >= (int)(sizeof(dir) - len)) {
+        return -1;
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    if (snprintf(buf, size, "%s/%s", dir, name) >= (int)size) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Возвращает время изменения файла в наносекундах или -1, если файла нет */
+int64_t path_mtime_ns(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/*
+ * Возвращает наибольшее время изменения каталога и файлов в нем
+ * в наносекундах или -1, если каталог недоступен
+ */
+int64_t dir_tree_mtime_ns(const char *path) {
+    int64_t max_mtime = path_mtime_ns(path);
+    if (max_mtime < 0) {
+        return -1;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return max_mtime;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        if (entry->d_name[0] == '.' || fstatat(dirfd(dir), entry->d_name, &st, 0) != 0) {
+            continue;
+        }
+        int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        if (mtime > max_mtime) {
+            max_mtime = mtime;
+        }
+    }
+
+    closedir(dir);
+    return max_mtime;
+}
+
+/* Монотонное время в наносекундах */
+int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Читает файл целиком в буфер, завершенный нулем
+ * Возвращает буфер (освобождается free) или NULL при ошибке
+ */
+char *read_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *buf = malloc(st.st_size + 1);
+    if (buf == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t len = 0;
+    while (len < (size_t)st.st_size) {
+        ssize_t got = read(fd, buf + len, st.st_size - len);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        len += got;
+    }
+    close(fd);
+    stats_count(STATS_BYTES_READ, len);
+
+    buf[len] = '\0';
+    if (size != NULL) {
+        *size = len;
+    }
+    return buf;
+}
+
+/* Записывает буфер целиком, повторяя прерванные вызовы */
+int write_all(int fd, const void *buf, size_t len) {
+    const char *ptr = buf;
+    while (len > 0) {
+        ssize_t written = write(fd, ptr, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ptr += written;
+        len -= written;
+    }
+    return 0;
+}
+
+/*
+ * Записывает данные во временный файл рядом с path и атомарно переименовывает его
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+int write_file_atomic(const char *path, const void *data, size_t size) {
+    char tmp_path[MAX_PATH_LEN];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid()) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int rc = write_all(fd, data, size);
+    if (close(fd) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(tmp_path);
+    }
+    return rc;
+}
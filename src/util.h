@@ -0,0 +1,42 @@
+#ifndef CNF_UTIL_H
+#define CNF_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Формирует путь к файлу в пользовательском каталоге кеша
+ * ($XDG_CACHE_HOME/command-not-found или ~/.cache/command-not-found)
+ * и создает этот каталог при необходимости
+ * Возвращает 0 при успехе, -1 если каталог недоступен
+ */
+int user_cache_path(const char *name, char *buf, size_t size);
+
+/* Возвращает время изменения файла в наносекундах или -1, если файла нет */
+int64_t path_mtime_ns(const char *path);
+
+/*
+ * Возвращает наибольшее время изменения каталога и файлов в нем
+ * в наносекундах или -1, если каталог недоступен
+ */
+int64_t dir_tree_mtime_ns(const char *path);
+
+/* Монотонное время в наносекундах */
+int64_t monotonic_ns(void);
+
+/*
+ * Читает файл целиком в буфер, завершенный нулем
+ * Возвращает буфер (освобождается free) или NULL при ошибке
+ */
+char *read_file(const char *path, size_t *size);
+
+/* Записывает буфер целиком, повторяя прерванные вызовы */
+int write_all(int fd, const void *buf, size_t len);
+
+/*
+ * Записывает данные во временный файл рядом с path и атомарно переименовывает его
+ * Возвращает 0 при успехе, -1 при ошибке
+ */
+int write_file_atomic(const char *path, const void *data, size_t size);
+
+#endif /* CNF_UTIL_H */
@@ -0,0 +1,48 @@
+#!/bin/sh
+# Запускает command-not-found на каталоге списков fixtures/lists со списком
+# установленных пакетов CNF_INSTALLED_LIST и проверяет оба исхода:
+# для установленного пакета нет предложения установки, для прочих есть
+# Использование: check-installed.sh <command-not-found> <каталог списков> <installed.list>
+set -u
+
+binary=$1
+lists=$2
+installed=$3
+
+cache=$(mktemp -d) || exit 1
+trap 'rm -rf "$cache"' EXIT
+
+run() {
+    env XDG_CACHE_HOME="$cache" CNF_PKGLIST_DIR="$lists" \
+        CNF_INDEX_PATH="$cache/none" CNF_TYPO_PATH="$cache/none" \
+        CNF_INSTALLED_LIST="$installed" CNF_NO_PATH_CACHE=1 \
+        "$binary" "$1" 2>&1
+}
+
+status=0
+
+out=$(run cnf-installed-tool)
+case $out in
+    *"apt-get install"*)
+        echo "cnf-installed-tool: install suggested for an installed package:"
+        echo "$out"
+        status=1 ;;
+esac
+case $out in
+    *"already installed"*) ;;
+    *)
+        echo "cnf-installed-tool: not reported as installed:"
+        echo "$out"
+        status=1 ;;
+esac
+
+out=$(run cnf-missing-tool)
+case $out in
+    *"apt-get install cnf-missing"*) ;;
+    *)
+        echo "cnf-missing-tool: no install suggestion:"
+        echo "$out"
+        status=1 ;;
+esac
+
+exit $status
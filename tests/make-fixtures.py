@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# Создает маленькие файлы pkglist для проверки встроенного разборщика
+# Файлы хранятся в дереве; сценарий нужен только для их пересоздания
+import os
+import struct
+
+HEADER_MAGIC = b'\x8e\xad\xe8\x01\x00\x00\x00\x00'
+
+RPMTAG_NAME = 1000
+RPMTAG_SUMMARY = 1004
+RPMTAG_OLDFILENAMES = 1027
+RPMTAG_DIRINDEXES = 1116
+RPMTAG_BASENAMES = 1117
+RPMTAG_DIRNAMES = 1118
+
+RPM_INT32_TYPE = 4
+RPM_STRING_TYPE = 6
+RPM_STRING_ARRAY_TYPE = 8
+RPM_I18NSTRING_TYPE = 9
+
+
+def header(tags, magic=True):
+    """Собирает заголовок RPM из списка (тег, тип, данные, количество, выравнивание)"""
+    index = []
+    data = bytearray()
+    for tag, tag_type, payload, count, align in tags:
+        while len(data) % align:
+            data.append(0)
+        index.append((tag, tag_type, len(data), count))
+        data.extend(payload)
+
+    out = bytearray(HEADER_MAGIC if magic else b'')
+    out += struct.pack('>II', len(index), len(data))
+    for entry in index:
+        out += struct.pack('>IIII', *entry)
+    return bytes(out + data)
+
+
+def string(tag, value, tag_type=RPM_STRING_TYPE):
+    return (tag, tag_type, value.encode() + b'\0', 1, 1)
+
+
+def array(tag, values):
+    return (tag, RPM_STRING_ARRAY_TYPE, b''.join(v.encode() + b'\0' for v in values), len(values), 1)
+
+
+def int32(tag, values):
+    return (tag, RPM_INT32_TYPE, b''.join(struct.pack('>I', v) for v in values), len(values), 4)
+
+
+def compressed(name, summary, dirnames, files, magic=True):
+    """Заголовок со сжатым списком файлов: files - пары (номер каталога, имя)"""
+    return header([
+        string(RPMTAG_NAME, name),
+        string(RPMTAG_SUMMARY, summary, RPM_I18NSTRING_TYPE),
+        int32(RPMTAG_DIRINDEXES, [index for index, _ in files]),
+        array(RPMTAG_BASENAMES, [basename for _, basename in files]),
+        array(RPMTAG_DIRNAMES, dirnames),
+    ], magic)
+
+
+def main():
+    out = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'fixtures')
+    os.makedirs(out, exist_ok=True)
+
+    def write(name, blob):
+        with open(os.path.join(out, name), 'wb') as f:
+            f.write(blob)
+
+    # BASENAMES/DIRNAMES/DIRINDEXES; второй заголовок без сигнатуры,
+    # файл с номером каталога вне DIRNAMES пропускается
+    write('compressed.pkglist',
+          compressed('hello', 'Greeting program', ['/usr/bin/', '/usr/share/man/man1/'],
+                     [(0, 'hello'), (1, 'hello.1'), (0, 'hi')]) +
+          compressed('tools', 'Small tools', ['/usr/sbin/'],
+                     [(0, 'tool'), (7, 'lost')], magic=False))
+
+    # Только OLDFILENAMES; путь без '/' пропускается
+    write('oldfilenames.pkglist', header([
+        string(RPMTAG_NAME, 'legacy'),
+        string(RPMTAG_SUMMARY, 'Legacy package'),
+        array(RPMTAG_OLDFILENAMES, ['/bin/legacy', '/etc/legacy.conf', 'noslash']),
+    ]))
+
+    # Целый заголовок, затем обрезанный: строки первого выводятся один раз,
+    # pkglist-query не вызывается
+    first = compressed('first', 'First package', ['/usr/bin/'], [(0, 'first')])
+    second = compressed('second', 'Second package', ['/usr/bin/'], [(0, 'second')])
+    write('truncated.pkglist', first + second[:len(second) - 10])
+
+    # Первый заголовок заявляет данные длиннее файла: формат не распознан
+    broken = bytearray(compressed('broken', 'Broken package', ['/usr/bin/'], [(0, 'broken')]))
+    struct.pack_into('>I', broken, 12, 0x00ffffff)
+    write('corrupt.pkglist', bytes(broken))
+
+    # Не заголовки RPM вовсе
+    write('foreign.pkglist', b'Package: foreign\nFilename: /usr/bin/foreign\n')
+
+    # Каталог списков для запуска command-not-found целиком: один пакет
+    # указан в installed.list, другой нет
+    os.makedirs(os.path.join(out, 'lists'), exist_ok=True)
+    write(os.path.join('lists', 'test_pkglist.classic'),
+          compressed('cnf-installed', 'Installed tool', ['/usr/bin/'], [(0, 'cnf-installed-tool')]) +
+          compressed('cnf-missing', 'Missing tool', ['/usr/bin/'], [(0, 'cnf-missing-tool')]))
+
+
+if __name__ == '__main__':
+    main()
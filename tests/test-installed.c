@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "installed.h"
+
+/*
+ * Загружает список установленных пакетов через installed_backend_list
+ * (тот же источник, что и CNF_INSTALLED_LIST) и проверяет ответы
+ * Аргументы "<пакет>=1" - пакет установлен, "<пакет>=0" - не установлен
+ * Использование: test-installed <список> <пакет>=<0|1>...
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: test-installed <list> <package>=<0|1>...\n");
+        return 1;
+    }
+
+    InstalledSet set;
+    if (installed_set_load(&set, &installed_backend_list, argv[1]) != 0) {
+        fprintf(stderr, "%s: cannot load list\n", argv[1]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 2; i < argc; i++) {
+        char *sep = strrchr(argv[i], '=');
+        if (sep == NULL || (strcmp(sep, "=0") != 0 && strcmp(sep, "=1") != 0)) {
+            fprintf(stderr, "bad argument: %s\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+        *sep = '\0';
+        int expected = sep[1] == '1';
+        if (installed_set_contains(&set, argv[i]) != expected) {
+            fprintf(stderr, "%s: expected %s\n", argv[i], expected ? "installed" : "not installed");
+            failed = 1;
+        }
+    }
+    installed_set_free(&set);
+
+    // Недоступный список дает пустой набор: ни один пакет не считается установленным
+    char missing[4096];
+    snprintf(missing, sizeof(missing), "%s.missing", argv[1]);
+    if (installed_set_load(&set, &installed_backend_list, missing) == 0 ||
+        installed_set_contains(&set, "bash")) {
+        fprintf(stderr, "%s: missing list must give an empty set\n", missing);
+        failed = 1;
+    }
+    installed_set_free(&set);
+    return failed;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkglist.h"
+
+/* Строки обхода в виде "<путь>\t<пакет>\t<описание>\n" */
+typedef struct {
+    FILE *out;
+    size_t rows;
+} RowLog;
+
+static int log_row(const PkglistRow *row, void *user_data) {
+    RowLog *log = user_data;
+    fprintf(log->out, "%.*s%s\t%s\t%s\n", (int)row->dirname_len, row->dirname, row->basename,
+            row->package, row->summary);
+    log->rows++;
+    return 0;
+}
+
+/* Читает файл целиком в строку, завершенную нулем */
+static char *read_text(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    if (out != NULL) {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+            fwrite(buf, 1, n, out);
+        }
+        fclose(out);
+    }
+    fclose(file);
+    return text;
+}
+
+/* Проверяет, что ни одна строка вывода не повторяется */
+static int has_duplicates(const char *text) {
+    const char *line = text;
+    while (*line) {
+        const char *end = strchr(line, '\n');
+        size_t len = end != NULL ? (size_t)(end - line + 1) : strlen(line);
+        for (const char *other = line + len; *other; ) {
+            const char *other_end = strchr(other, '\n');
+            size_t other_len = other_end != NULL ? (size_t)(other_end - other + 1) : strlen(other);
+            if (other_len == len && memcmp(line, other, len) == 0) {
+                fprintf(stderr, "duplicate row: %.*s", (int)len, line);
+                return 1;
+            }
+            other += other_len;
+        }
+        line += len;
+    }
+    return 0;
+}
+
+/*
+ * Обходит файл pkglist так же, как сканирование и построение индекса,
+ * и сравнивает строки (путь, пакет, описание) с ожидаемыми
+ * Первая строка ожидаемого вывода - каким способом прочитан файл: встроенный
+ * разборщик, либо (если формат не распознан) pkglist-query; во втором случае
+ * разборщик не должен успеть выдать ни одной строки, иначе они повторятся
+ * Использование: test-pkglist <pkglist> <ожидаемый вывод>
+ */
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: test-pkglist <pkglist> <expected>\n");
+        return 1;
+    }
+
+    RowLog native = { fopen("/dev/null", "w"), 0 };
+    if (native.out == NULL) {
+        return 1;
+    }
+    int native_result = pkglist_read_file(argv[1], log_row, &native);
+    fclose(native.out);
+    if (native_result < 0 && native.rows > 0) {
+        fprintf(stderr, "%s: native reader rejected the file after %zu rows\n", argv[1], native.rows);
+        return 1;
+    }
+
+    char *actual = NULL;
+    size_t actual_len = 0;
+    RowLog scan = { open_memstream(&actual, &actual_len), 0 };
+    if (scan.out == NULL) {
+        return 1;
+    }
+    fprintf(scan.out, "reader: %s\n", native_result < 0 ? "pkglist-query" : "native");
+    int scan_result = pkglist_scan_file(argv[1], log_row, &scan);
+    fclose(scan.out);
+
+    char *expected = read_text(argv[2]);
+    if (expected == NULL) {
+        fprintf(stderr, "%s: cannot read expected output\n", argv[2]);
+        free(actual);
+        return 1;
+    }
+
+    int failed = 0;
+    if (scan_result != 0) {
+        fprintf(stderr, "%s: scan returned %d\n", argv[1], scan_result);
+        failed = 1;
+    }
+    if (has_duplicates(actual)) {
+        failed = 1;
+    }
+    if (strcmp(actual, expected) != 0) {
+        fprintf(stderr, "%s: rows differ\n--- expected\n%s--- actual\n%s", argv[1], expected, actual);
+        failed = 1;
+    }
+
+    free(expected);
+    free(actual);
+    return failed;
+}